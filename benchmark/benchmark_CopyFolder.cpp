@@ -0,0 +1,100 @@
+/*
+ * Sarus
+ *
+ * Copyright (c) 2018-2023, ETH Zurich. All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+// Compares filesystem::copyFolder with the previous implementation, which
+// walked the source folder with a directory_iterator and copied the files
+// one at a time with filesystem::copyFile.
+//
+// Usage: benchmark_CopyFolder [folders] [files per folder] [file size]
+//                             [threads]
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include <boost/filesystem.hpp>
+#include <boost/format.hpp>
+
+#include "libsarus/PathRAII.hpp"
+#include "libsarus/Utility.hpp"
+
+static void copyFolderSequentially(const boost::filesystem::path &src,
+                                   const boost::filesystem::path &dst,
+                                   uid_t uid, gid_t gid) {
+    libsarus::filesystem::createFoldersIfNecessary(dst, uid, gid);
+    for (boost::filesystem::directory_iterator entry{src};
+         entry != boost::filesystem::directory_iterator{}; ++entry) {
+        if (boost::filesystem::is_directory(entry->path())) {
+            copyFolderSequentially(entry->path(),
+                                   dst / entry->path().filename(), uid, gid);
+        } else {
+            libsarus::filesystem::copyFile(
+                entry->path(), dst / entry->path().filename(), uid, gid);
+        }
+    }
+}
+
+static void createTree(const boost::filesystem::path &root,
+                       unsigned int folders, unsigned int filesPerFolder,
+                       size_t fileSize) {
+    auto content = std::string(fileSize, 'x');
+    for (unsigned int i = 0; i < folders; ++i) {
+        auto folder = root / ("folder" + std::to_string(i));
+        libsarus::filesystem::createFoldersIfNecessary(folder);
+        for (unsigned int j = 0; j < filesPerFolder; ++j) {
+            libsarus::filesystem::writeTextFile(
+                content, folder / ("file" + std::to_string(j)));
+        }
+    }
+}
+
+template <class Function>
+static void measure(const std::string &name, const Function &function) {
+    auto start = std::chrono::steady_clock::now();
+    function();
+    auto elapsed = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start);
+    std::cout << boost::format("%-36s %10.3f s") % name % elapsed.count()
+              << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    auto folders = argc > 1 ? std::stoul(argv[1]) : 100;
+    auto filesPerFolder = argc > 2 ? std::stoul(argv[2]) : 100;
+    auto fileSize = argc > 3 ? std::stoul(argv[3]) : 65536;
+    auto threads = argc > 4 ? std::stoul(argv[4])
+                            : libsarus::parallel::getDefaultNumberOfThreads();
+
+    auto workDirRAII =
+        libsarus::PathRAII{libsarus::filesystem::makeUniquePathWithRandomSuffix(
+            boost::filesystem::temp_directory_path() /
+            "sarus-benchmark-copyfolder")};
+    const auto &workDir = workDirRAII.getPath();
+    auto src = workDir / "src";
+    createTree(src, folders, filesPerFolder, fileSize);
+    std::cout << boost::format("%d folders x %d files x %d bytes in %s") %
+                     folders % filesPerFolder % fileSize % workDir
+              << std::endl;
+
+    // the sources are in the page cache after createTree, so every run
+    // measures the copy itself rather than the first read from disk
+    measure("directory_iterator + copyFile", [&]() {
+        copyFolderSequentially(src, workDir / "dst0", -1, -1);
+    });
+    measure("copyFolder, threads=1", [&]() {
+        libsarus::filesystem::copyFolder(src, workDir / "dst1", -1, -1, 1);
+    });
+    measure(str(boost::format("copyFolder, threads=%d") % threads), [&]() {
+        libsarus::filesystem::copyFolder(src, workDir / "dst2", -1, -1,
+                                         threads);
+    });
+
+    return 0;
+}
@@ -0,0 +1,103 @@
+/*
+ * Sarus
+ *
+ * Copyright (c) 2018-2023, ETH Zurich. All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+// Compares statx(2) calls executed one at a time with the same calls executed
+// through a SyscallBatch, on io_uring with different queue depths (i.e. calls
+// per submission) and on the synchronous fallback. The times include the
+// setup of the io_uring instance.
+//
+// Usage: benchmark_SyscallBatch [files] [repetitions]
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/format.hpp>
+
+#include "libsarus/PathRAII.hpp"
+#include "libsarus/SyscallBatch.hpp"
+#include "libsarus/Utility.hpp"
+
+template <class Function>
+static void measure(const std::string &name, size_t calls,
+                    unsigned long repetitions, const Function &function) {
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned long i = 0; i < repetitions; ++i) {
+        function();
+    }
+    auto elapsed = std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now() - start);
+    std::cout << boost::format("%-36s %10.3f us/call") % name %
+                     (elapsed.count() / (calls * repetitions))
+              << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    auto files = argc > 1 ? std::stoul(argv[1]) : 10000;
+    auto repetitions = argc > 2 ? std::stoul(argv[2]) : 10;
+
+    auto workDirRAII =
+        libsarus::PathRAII{libsarus::filesystem::makeUniquePathWithRandomSuffix(
+            boost::filesystem::temp_directory_path() /
+            "sarus-benchmark-syscallbatch")};
+    const auto &workDir = workDirRAII.getPath();
+    libsarus::filesystem::createFoldersIfNecessary(workDir);
+    auto names = std::vector<std::string>{};
+    for (unsigned long i = 0; i < files; ++i) {
+        names.push_back("file" + std::to_string(i));
+        libsarus::filesystem::writeTextFile("", workDir / names.back());
+    }
+    auto dirFd = libsarus::FileDescriptor{
+        open(workDir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)};
+    auto buffers = std::vector<struct statx>(files);
+    std::cout << boost::format("statx of %d files x %d repetitions in %s") %
+                     files % repetitions % workDir
+              << std::endl;
+
+    measure("statx, one at a time", files, repetitions, [&]() {
+        for (unsigned long i = 0; i < files; ++i) {
+            statx(dirFd.get(), names[i].c_str(), 0, STATX_BASIC_STATS,
+                  &buffers[i]);
+        }
+    });
+
+    auto measureBatch = [&](unsigned int queueDepth, bool useIoUring) {
+        auto isUsingIoUring = false;
+        auto name = std::string{"SyscallBatch, synchronous"};
+        if (useIoUring) {
+            name = str(boost::format("SyscallBatch, io_uring, depth=%d") %
+                       queueDepth);
+        }
+        measure(name, files, repetitions, [&]() {
+            auto batch = libsarus::SyscallBatch{queueDepth, useIoUring};
+            for (unsigned long i = 0; i < files; ++i) {
+                batch.statx(dirFd.get(), names[i], 0, STATX_BASIC_STATS,
+                            &buffers[i]);
+            }
+            batch.submit();
+            isUsingIoUring = batch.isUsingIoUring();
+        });
+        if (useIoUring && !isUsingIoUring) {
+            std::cout << "  (io_uring not available: executed synchronously)"
+                      << std::endl;
+        }
+    };
+    measureBatch(libsarus::SyscallBatch::defaultQueueDepth, false);
+    for (auto queueDepth : {1u, 8u, 32u, 128u, 512u}) {
+        measureBatch(queueDepth, true);
+    }
+
+    return 0;
+}
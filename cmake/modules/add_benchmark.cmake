@@ -0,0 +1,7 @@
+function(add_benchmark BENCHMARK_NAME TARGET_LINK_LIBS)
+    set(BENCHMARK_SRC_FILE benchmark_${BENCHMARK_NAME}.cpp)
+    set(BENCHMARK_BIN_FILE benchmark_${BENCHMARK_NAME})
+
+    add_executable(${BENCHMARK_BIN_FILE} ${BENCHMARK_SRC_FILE})
+    target_link_libraries(${BENCHMARK_BIN_FILE} ${TARGET_LINK_LIBS})
+endfunction()
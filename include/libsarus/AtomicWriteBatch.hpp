@@ -0,0 +1,78 @@
+/*
+ * Sarus
+ *
+ * Copyright (c) 2018-2023, ETH Zurich. All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+#ifndef libsarus_AtomicWriteBatch_hpp
+#define libsarus_AtomicWriteBatch_hpp
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "FileDescriptor.hpp"
+#include "PathHash.hpp"
+
+namespace libsarus {
+
+/**
+ * This class replaces the content of a group of files atomically, so that a
+ * concurrent reader (or a reader after a crash) sees either the old or the new
+ * content of each file, never a partially written one.
+ *
+ * Each added file is written to an anonymous O_TMPFILE file in the target's
+ * directory (or to a hidden temporary sibling, if the filesystem doesn't
+ * support O_TMPFILE). The commit links the temporary files into place with
+ * rename(2). A durable batch also flushes the data of each file with
+ * fdatasync(2) and, after the renames, the directories of the batch with
+ * fsync(2), once per directory.
+ *
+ * Each file is replaced atomically, the batch as a whole is not: if the commit
+ * fails, the files renamed so far keep their new content. A replaced file
+ * keeps its permissions, but it is owned by the writer. The writes not
+ * committed are discarded by the destructor of this class.
+ */
+class AtomicWriteBatch {
+  public:
+    AtomicWriteBatch(bool durable = true);
+    AtomicWriteBatch(const AtomicWriteBatch &) = delete;
+    AtomicWriteBatch &operator=(const AtomicWriteBatch &) = delete;
+    ~AtomicWriteBatch();
+
+    void add(const boost::filesystem::path &filename, std::string_view content);
+    void commit();
+    void discard();
+    size_t size() const { return pendingWrites.size(); }
+
+  private:
+    struct PendingWrite {
+        boost::filesystem::path filename;
+        int dirFd;
+        FileDescriptor fd;
+        // Name of the temporary file, empty for an O_TMPFILE file until linked
+        boost::filesystem::path temporaryName;
+    };
+
+  private:
+    int openDirectory(const boost::filesystem::path &dir);
+    void createTemporaryFile(PendingWrite &pendingWrite) const;
+    void linkTemporaryFile(PendingWrite &pendingWrite) const;
+
+  private:
+    bool durable;
+    std::unordered_map<boost::filesystem::path, FileDescriptor, PathHash>
+        directories;
+    std::vector<PendingWrite> pendingWrites;
+};
+
+}  // namespace libsarus
+
+#endif
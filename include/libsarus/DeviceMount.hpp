@@ -14,6 +14,7 @@
 #include <sys/types.h>
 
 #include "DeviceAccess.hpp"
+#include "FileInfo.hpp"
 #include "Mount.hpp"
 
 namespace libsarus {
@@ -24,6 +25,8 @@ namespace libsarus {
 class DeviceMount : public Mount {
   public:
     DeviceMount(Mount &&baseMount, const DeviceAccess &access);
+    DeviceMount(Mount &&baseMount, const DeviceAccess &access,
+                const FileInfo &sourceInfo);
 
   public:
     char getType() const { return type; };
@@ -31,6 +34,9 @@ class DeviceMount : public Mount {
     unsigned int getMinorID() const;
     const DeviceAccess &getAccess() const { return access; };
 
+  private:
+    void setDevice(const FileInfo &sourceInfo);
+
   private:
     DeviceAccess access;
     dev_t id;
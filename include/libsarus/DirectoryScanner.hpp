@@ -0,0 +1,66 @@
+/*
+ * Sarus
+ *
+ * Copyright (c) 2018-2023, ETH Zurich. All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+#ifndef libsarus_DirectoryScanner_hpp
+#define libsarus_DirectoryScanner_hpp
+
+#include <functional>
+#include <string_view>
+#include <vector>
+
+#include <sys/types.h>
+
+#include <boost/filesystem.hpp>
+
+namespace libsarus {
+
+struct DirectoryEntry {
+    // NUL-terminated name of the entry, e.g. to be passed to the *at(2) calls
+    // together with the directory's file descriptor
+    std::string_view name;
+    // DT_* type of the entry, never DT_UNKNOWN
+    unsigned char type;
+    ino_t inode;
+};
+
+/**
+ * This class lists the entries of directories with the getdents64(2) system
+ * call, reading many entries per call into a buffer which is reused across
+ * the scans. The entries are passed to the caller without allocations and,
+ * unlike with boost's directory iterators, without a stat(2) call for each of
+ * them: the entry's type is looked up with fstatat(2) only on filesystems
+ * which don't report it.
+ *
+ * The entries passed to the callback are valid only during the callback. A
+ * scanner is not thread-safe and cannot be used to scan another directory
+ * from within its own callback: recursive walks collect the subdirectories
+ * first and scan them afterwards, or use one scanner per level.
+ */
+class DirectoryScanner {
+  public:
+    static constexpr size_t defaultBufferSize = 1 << 18;
+
+  public:
+    DirectoryScanner(size_t bufferSize = defaultBufferSize);
+    DirectoryScanner(const DirectoryScanner &) = delete;
+    DirectoryScanner &operator=(const DirectoryScanner &) = delete;
+
+    void scan(const boost::filesystem::path &dir,
+              const std::function<void(const DirectoryEntry &)> &function);
+    void scan(int dirFd, const boost::filesystem::path &dir,
+              const std::function<void(const DirectoryEntry &)> &function);
+
+  private:
+    std::vector<char> buffer;
+};
+
+}  // namespace libsarus
+
+#endif
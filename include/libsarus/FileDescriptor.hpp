@@ -0,0 +1,41 @@
+/*
+ * Sarus
+ *
+ * Copyright (c) 2018-2023, ETH Zurich. All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+#ifndef libsarus_FileDescriptor_hpp
+#define libsarus_FileDescriptor_hpp
+
+namespace libsarus {
+
+/**
+ * RAII wrapper for a file descriptor, which is closed by the destructor of
+ * this class. A default-constructed object holds no file descriptor.
+ */
+class FileDescriptor {
+  public:
+    FileDescriptor() = default;
+    explicit FileDescriptor(int fd);
+    FileDescriptor(const FileDescriptor &) = delete;
+    FileDescriptor(FileDescriptor &&);
+    FileDescriptor &operator=(const FileDescriptor &) = delete;
+    FileDescriptor &operator=(FileDescriptor &&);
+    ~FileDescriptor();
+
+    int get() const { return fd; }
+    bool isValid() const { return fd >= 0; }
+    int release();
+    void reset(int newFd = -1);
+
+  private:
+    int fd = -1;
+};
+
+}  // namespace libsarus
+
+#endif
@@ -0,0 +1,57 @@
+/*
+ * Sarus
+ *
+ * Copyright (c) 2018-2023, ETH Zurich. All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+#ifndef libsarus_FileInfo_hpp
+#define libsarus_FileInfo_hpp
+
+#include <cstdint>
+#include <tuple>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <boost/filesystem.hpp>
+
+namespace libsarus {
+
+/**
+ * This class represents a snapshot of the metadata of a file, retrieved with
+ * a single statx(2) call (symlinks are followed). The 'mask' passed to the
+ * constructor selects the fields to retrieve (STATX_* flags), letting the
+ * filesystem skip the ones which are not needed. Getting a field that was not
+ * retrieved is an error.
+ *
+ * Take a snapshot when the same file needs to be inspected more than once,
+ * e.g. to check the file type and then get the device ID of a device file.
+ */
+class FileInfo {
+  public:
+    FileInfo(const boost::filesystem::path &path,
+             unsigned int mask = STATX_BASIC_STATS);
+
+    const boost::filesystem::path &getPath() const { return path; }
+    mode_t getFileType() const;
+    mode_t getMode() const;
+    std::tuple<uid_t, gid_t> getOwner() const;
+    uint64_t getSize() const;
+    dev_t getDeviceID() const;
+
+  private:
+    void checkRetrieved(unsigned int field, const char *fieldName) const;
+
+  private:
+    boost::filesystem::path path;
+    unsigned int mask;
+    struct statx stx;
+};
+
+}  // namespace libsarus
+
+#endif
@@ -0,0 +1,58 @@
+/*
+ * Sarus
+ *
+ * Copyright (c) 2018-2023, ETH Zurich. All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+#ifndef libsarus_FileView_hpp
+#define libsarus_FileView_hpp
+
+#include <string>
+#include <string_view>
+
+#include <boost/filesystem.hpp>
+#include <boost/optional.hpp>
+
+#include "MappedFile.hpp"
+
+namespace libsarus {
+
+/**
+ * This class provides read-only access to the whole content of a file,
+ * exposed as a std::string_view so that parsers can work on it without
+ * copying.
+ *
+ * Large regular files are memory-mapped. Other files are read into a buffer:
+ * with a single read(2) when the size reported by fstat(2) is reliable,
+ * otherwise (e.g. files in procfs, which report a zero size) in large chunks
+ * until the end of the file.
+ *
+ * The view is valid as long as the FileView object is alive.
+ */
+class FileView {
+  public:
+    FileView(const boost::filesystem::path &file);
+    FileView(const FileView &) = delete;
+    FileView(FileView &&) = default;
+    FileView &operator=(const FileView &) = delete;
+    FileView &operator=(FileView &&) = default;
+
+    const boost::filesystem::path &getPath() const { return path; }
+    std::string_view view() const;
+
+  private:
+    void readContent(int fd, size_t expectedSize);
+
+  private:
+    boost::filesystem::path path;
+    boost::optional<MappedFile> mappedFile;
+    std::string buffer;
+};
+
+}  // namespace libsarus
+
+#endif
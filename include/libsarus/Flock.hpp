@@ -31,8 +31,8 @@ class Logger;
  * but the class allows to change between lock types.
  * The constructor attempts to acquire access to the shared resource by
  * calling flock(2) with the given operation type. If an incompatible lock type
- * already exists on the resource, the constructor busy waits until it is able
- * to acquire the lock or a timeout is reached.
+ * already exists on the resource, the constructor busy waits, retrying every
+ * poll interval, until it is able to acquire the lock or a timeout is reached.
  * The destructor and move operations release the lock on the shared resource.
  * Since the implementation relies on flock(2), this class only creates advisory
  * locks (see the man page for further details).
@@ -40,13 +40,15 @@ class Logger;
 class Flock {
   public:
     static const milliseconds noTimeout;
+    static const milliseconds defaultPollInterval;
     enum Type { readLock, writeLock };
 
   public:
     Flock();
     Flock(const boost::filesystem::path &file, const Type type = readLock,
           const milliseconds &timeoutTime = noTimeout,
-          const milliseconds &warningTime = milliseconds{1000});
+          const milliseconds &warningTime = milliseconds{1000},
+          const milliseconds &pollInterval = defaultPollInterval);
     Flock(const Flock &) = delete;
     Flock(Flock &&);
     ~Flock();
@@ -69,6 +71,7 @@ class Flock {
     int fileFd = -1;
     milliseconds timeoutTime;
     milliseconds warningTime;
+    milliseconds pollInterval;
 };
 
 }  // namespace libsarus
@@ -0,0 +1,50 @@
+/*
+ * Sarus
+ *
+ * Copyright (c) 2018-2023, ETH Zurich. All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+#ifndef libsarus_MappedFile_hpp
+#define libsarus_MappedFile_hpp
+
+#include <cstddef>
+
+#include <boost/filesystem.hpp>
+
+namespace libsarus {
+
+/**
+ * RAII wrapper for a read-only, private memory mapping of a whole file.
+ * The mapping is released by the destructor of this class.
+ */
+class MappedFile {
+  public:
+    MappedFile(const boost::filesystem::path &file);
+    MappedFile(int fd, const boost::filesystem::path &file, size_t length);
+    MappedFile(const MappedFile &) = delete;
+    MappedFile(MappedFile &&);
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile &operator=(MappedFile &&);
+    ~MappedFile();
+
+    const boost::filesystem::path &getPath() const { return path; }
+    const unsigned char *data() const { return address; }
+    size_t size() const { return length; }
+
+  private:
+    void map(int fd, size_t length);
+    void release();
+
+  private:
+    boost::filesystem::path path;
+    const unsigned char *address = nullptr;
+    size_t length = 0;
+};
+
+}  // namespace libsarus
+
+#endif
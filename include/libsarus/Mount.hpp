@@ -34,6 +34,10 @@ class Mount {
     boost::filesystem::path getSource() const { return source; };
     boost::filesystem::path getDestination() const { return destination; };
     unsigned long getFlags() const { return mountFlags; };
+    boost::filesystem::path getRootfsDir() const { return rootfsDir; };
+    const libsarus::UserIdentity &getUserIdentity() const {
+        return userIdentity;
+    };
 
   private:
     boost::filesystem::path source;
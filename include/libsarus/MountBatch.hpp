@@ -0,0 +1,79 @@
+/*
+ * Sarus
+ *
+ * Copyright (c) 2018-2023, ETH Zurich. All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+#ifndef libsarus_MountBatch_hpp
+#define libsarus_MountBatch_hpp
+
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "Mount.hpp"
+#include "UserIdentity.hpp"
+
+namespace libsarus {
+
+/**
+ * This class performs a sequence of bind mounts into the same rootfs on
+ * behalf of the same user, with the same outcome as calling
+ * Mount::performMount for each of them in order, but with fewer identity
+ * switches and validation system calls.
+ *
+ * The mounts are performed in waves of consecutive mounts. Each wave
+ * validates all its sources and destinations under one switch to the user
+ * identity, then creates all its mount points as root, then bind mounts
+ * everything under one switch of the filesystem uid. A mount whose
+ * destination is reached through the destination of a previous mount of the
+ * wave (i.e. any path or symlink traversed to resolve it lies within that
+ * destination) starts a new wave, as it must be validated after that mount is
+ * performed. If a mount fails, the previous mounts are performed and the
+ * error reports the failed mount.
+ */
+class MountBatch {
+  public:
+    MountBatch(const boost::filesystem::path &rootfsDir,
+               const UserIdentity &userIdentity);
+
+    void add(const boost::filesystem::path &source,
+             const boost::filesystem::path &destination,
+             unsigned long flags = 0);
+    void add(const Mount &mount);
+    void performMounts() const;
+    size_t size() const { return mounts.size(); }
+
+  private:
+    struct Request {
+        boost::filesystem::path source;
+        boost::filesystem::path destination;
+        unsigned long flags;
+    };
+
+    struct ValidatedMount {
+        boost::filesystem::path sourceReal;
+        boost::filesystem::path destinationReal;
+        bool isSourceDirectory;
+    };
+
+  private:
+    size_t performWave(size_t begin) const;
+    void validateWave(size_t begin, size_t &current,
+                      std::vector<ValidatedMount> &wave) const;
+    void createMountPoints(size_t begin, size_t &current,
+                           std::vector<ValidatedMount> &wave) const;
+
+  private:
+    boost::filesystem::path rootfsDir;
+    UserIdentity userIdentity;
+    std::vector<Request> mounts;
+};
+
+}  // namespace libsarus
+
+#endif
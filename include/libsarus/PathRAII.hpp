@@ -18,10 +18,17 @@ namespace libsarus {
 
 // RAII wrapper for a path: manages the lifetime of a specified path,
 // which is automatically removed by the destructor of this class.
+// If a trash directory is specified, the destructor moves the path there and
+// removes it in the background (see filesystem::removeTreeInBackground). The
+// background removals are waited for at the exit of the process. The removal
+// submits its batches of system calls through io_uring only if requested with
+// setUseIoUring (see SyscallBatch).
 class PathRAII {
   public:
     PathRAII() = default;
     PathRAII(const boost::filesystem::path &path);
+    PathRAII(const boost::filesystem::path &path,
+             const boost::filesystem::path &trashDirectory);
     PathRAII(const PathRAII &) = delete;
     PathRAII(PathRAII &&);
     PathRAII &operator=(const PathRAII &) = delete;
@@ -29,12 +36,13 @@ class PathRAII {
     ~PathRAII();
 
     const boost::filesystem::path &getPath() const;
+    void setUseIoUring(bool useIoUring);
     void release();
 
   private:
-    void setFilesAsRemovableByOwner() const;
-
     boost::optional<boost::filesystem::path> path;
+    boost::optional<boost::filesystem::path> trashDirectory;
+    bool useIoUring = false;
 };
 
 }  // namespace libsarus
@@ -0,0 +1,76 @@
+/*
+ * Sarus
+ *
+ * Copyright (c) 2018-2023, ETH Zurich. All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+#ifndef libsarus_RootfsResolver_hpp
+#define libsarus_RootfsResolver_hpp
+
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "PathHash.hpp"
+
+namespace libsarus {
+
+/**
+ * This class resolves paths within a root filesystem, i.e. following the
+ * symlinks as if the rootfs were the root directory (see
+ * filesystem::appendPathsWithinRootfs).
+ *
+ * The resolver memoizes each resolution step: for every directory prefix
+ * (an already resolved directory plus the next path element) it caches the
+ * resolved path and the symlinks traversed to get there. Resolutions sharing
+ * the same prefixes (e.g. the libraries under /usr/lib64, reached through
+ * /lib -> /usr/lib64) perform the lstat(2) and readlink(2) calls only once.
+ *
+ * The resolver can be safely used by multiple threads concurrently. It is up
+ * to the user to invalidate the cached prefixes when the underlying tree
+ * changes, e.g. after mounting something within the rootfs.
+ */
+class RootfsResolver {
+  public:
+    RootfsResolver(const boost::filesystem::path &rootfs);
+    RootfsResolver(const RootfsResolver &) = delete;
+    RootfsResolver &operator=(const RootfsResolver &) = delete;
+
+    const boost::filesystem::path &getRootfs() const { return rootfs; }
+    boost::filesystem::path resolve(
+        const boost::filesystem::path &path,
+        std::vector<boost::filesystem::path> *traversedSymlinks = nullptr);
+    boost::filesystem::path appendPaths(
+        const boost::filesystem::path &path0,
+        const boost::filesystem::path &path1,
+        std::vector<boost::filesystem::path> *traversedSymlinks = nullptr);
+    void invalidate();
+    void invalidate(const boost::filesystem::path &prefix);
+
+  private:
+    struct ResolvedPrefix {
+        boost::filesystem::path path;
+        std::vector<boost::filesystem::path> traversedSymlinks;
+    };
+
+  private:
+    boost::filesystem::path resolvePrefix(
+        const boost::filesystem::path &prefix,
+        std::vector<boost::filesystem::path> *traversedSymlinks);
+
+  private:
+    boost::filesystem::path rootfs;
+    std::shared_mutex mutex;
+    std::unordered_map<boost::filesystem::path, ResolvedPrefix, PathHash>
+        resolvedPrefixes;
+};
+
+}  // namespace libsarus
+
+#endif
@@ -0,0 +1,107 @@
+/*
+ * Sarus
+ *
+ * Copyright (c) 2018-2023, ETH Zurich. All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+#ifndef libsarus_SharedLibIndex_hpp
+#define libsarus_SharedLibIndex_hpp
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <elf.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/optional.hpp>
+
+#include "MappedFile.hpp"
+#include "PathHash.hpp"
+
+namespace libsarus {
+
+class RootfsResolver;
+
+/**
+ * This class implements a persistent index of the shared libraries of a root
+ * filesystem. For each library, the index stores the data otherwise obtained
+ * through sharedlibs::getLinkerName, sharedlibs::resolveAbi,
+ * sharedlibs::getSoname and sharedlibs::is64bitSharedLib, together with the
+ * identity (device, inode, mtime) of the library's file.
+ *
+ * The index file is memory-mapped and looked up in place. An entry is
+ * revalidated lazily, with a single stat(2) of the library's file, when it is
+ * requested. Only the entries whose file changed are recomputed. The symlinks
+ * leading to the libraries are re-resolved only when the dynamic linker's
+ * cache of the root filesystem changed, i.e. after ldconfig updated the links.
+ *
+ * save() writes the updated index to a temporary file which then atomically
+ * replaces the previous index, so processes using the same index file
+ * concurrently always see a consistent index.
+ */
+class SharedLibIndex {
+  public:
+    struct FileStamp {
+        uint64_t device = 0;
+        uint64_t inode = 0;
+        int64_t mtimeSeconds = 0;
+        int64_t mtimeNanoseconds = 0;
+
+        bool operator==(const FileStamp &) const = default;
+    };
+
+    struct Entry {
+        boost::filesystem::path path;
+        boost::filesystem::path realPath;
+        boost::filesystem::path linkerName;
+        boost::optional<std::string> soname;
+        std::vector<std::string> abi;
+        unsigned char elfClass = ELFCLASSNONE;
+        uint16_t machine = EM_NONE;
+        FileStamp stamp;
+    };
+
+  public:
+    SharedLibIndex(const boost::filesystem::path &indexFile,
+                   const boost::filesystem::path &rootDir = "/");
+
+    Entry getEntry(const boost::filesystem::path &lib);
+    std::vector<Entry> getEntries(
+        const std::vector<boost::filesystem::path> &libs,
+        unsigned int numberOfThreads = 0);
+    std::vector<Entry> getEntriesFromDynamicLinker(
+        const boost::filesystem::path &ldconfigPath,
+        unsigned int numberOfThreads = 0);
+    bool isModified() const { return modified; }
+    void save();
+
+  private:
+    void loadIndexFile();
+    boost::optional<Entry> findMappedEntry(
+        const boost::filesystem::path &lib) const;
+    std::vector<Entry> readMappedEntries() const;
+    Entry computeEntry(const boost::filesystem::path &lib,
+                       const Entry *previous,
+                       RootfsResolver &rootfsResolver) const;
+
+  private:
+    boost::filesystem::path indexFile;
+    boost::filesystem::path rootDir;
+    boost::optional<MappedFile> mappedIndex;
+    boost::optional<FileStamp> dynamicLinkerCacheStamp;
+    bool linksMayHaveChanged = true;
+    boost::optional<std::vector<boost::filesystem::path>> dynamicLinkerLibs;
+    std::unordered_map<boost::filesystem::path, Entry, PathHash>
+        updatedEntries;
+    bool modified = false;
+};
+
+}  // namespace libsarus
+
+#endif
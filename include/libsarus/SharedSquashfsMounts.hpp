@@ -0,0 +1,96 @@
+/*
+ * Sarus
+ *
+ * Copyright (c) 2018-2023, ETH Zurich. All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+#ifndef libsarus_SharedSquashfsMounts_hpp
+#define libsarus_SharedSquashfsMounts_hpp
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <boost/filesystem.hpp>
+
+#include "libsarus/Flock.hpp"
+
+namespace libsarus {
+
+/**
+ * This class shares the loop mounts of squashfs images between the containers
+ * of a node. Each image is loop mounted once, in a subdirectory of a
+ * node-local cache directory named after the device, inode and modification
+ * time of the image, and each container bind mounts that directory. Hence,
+ * the containers using the same image share one loop device, one copy of the
+ * image in the page cache and pay the loop mount latency once.
+ *
+ * The references to each shared mount are recorded in a state file of the
+ * cache directory, protected by a Flock. A reference belongs to an owner
+ * process, identified by its pid and start time: the references of owners
+ * which terminated without releasing them (e.g. killed jobs) are dropped at
+ * the next acquisition or release. When the last reference to a mount goes
+ * away, the mount is lazily unmounted (MNT_DETACH) and the loop device is
+ * detached once the mount is no longer busy.
+ *
+ * The shared mounts are only visible in the mount namespace where they are
+ * performed (and in the namespaces created from it afterwards), hence the
+ * images should be acquired before unsharing the mount namespace of the
+ * container. The references are recorded per mount namespace, and a mount
+ * is only shared within its namespace.
+ *
+ * The cache directory must be owned by root and not writable by group or
+ * others (it is created with mode 0700), and the mount points are resolved
+ * without following symlinks.
+ */
+class SharedSquashfsMounts {
+  public:
+    SharedSquashfsMounts(const boost::filesystem::path &cacheDir);
+
+    boost::filesystem::path acquire(const boost::filesystem::path &image,
+                                    pid_t owner = getpid());
+    void release(const boost::filesystem::path &mountPoint,
+                 pid_t owner = getpid());
+    boost::filesystem::path bindMount(
+        const boost::filesystem::path &image,
+        const boost::filesystem::path &destination, unsigned long flags = 0,
+        pid_t owner = getpid());
+    boost::filesystem::path getMountPoint(
+        const boost::filesystem::path &image) const;
+    size_t getNumberOfReferences(
+        const boost::filesystem::path &mountPoint) const;
+
+  private:
+    // (mount namespace, mount point name) -> owners of the references
+    using References = std::map<std::pair<std::string, std::string>,
+                                std::vector<std::string>>;
+
+  private:
+    Flock lockReferences(Flock::Type type) const;
+    References readReferences() const;
+    void writeReferences(const References &references) const;
+    void dropStaleReferences(References &references,
+                             const std::string &mountNamespace) const;
+    bool isMounted(const boost::filesystem::path &mountPoint) const;
+    void unmount(const std::string &mountPointName,
+                 const std::string &mountNamespaceOfMount,
+                 const References &references,
+                 const std::string &mountNamespace) const;
+
+  private:
+    boost::filesystem::path cacheDir;
+    boost::filesystem::path stateFile;
+    boost::filesystem::path lockFile;
+};
+
+}  // namespace libsarus
+
+#endif
@@ -0,0 +1,129 @@
+/*
+ * Sarus
+ *
+ * Copyright (c) 2018-2023, ETH Zurich. All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+#ifndef libsarus_SyscallBatch_hpp
+#define libsarus_SyscallBatch_hpp
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "FileDescriptor.hpp"
+
+struct io_uring_sqe;
+
+namespace libsarus {
+
+/**
+ * This class executes batches of independent filesystem system calls (statx,
+ * openat, mkdirat, unlinkat, fchownat, close). The calls are queued, then
+ * submit() executes all of them and makes their results available.
+ *
+ * If requested ('useIoUring') and supported by the kernel, the calls are
+ * submitted through an io_uring instance, up to 'queueDepth' calls per
+ * io_uring_enter(2), so that thousands of small metadata operations cost few
+ * context switches and run concurrently in the kernel. The io_uring instance
+ * is not requested by default: the kernel executes the filesystem operations
+ * in worker threads, which on a single CPU made the batches slower than the
+ * synchronous calls. Otherwise (io_uring disabled by the kernel
+ * configuration or by a seccomp filter, older kernels), and for the calls
+ * without an io_uring operation (e.g. fchownat), the calls are executed
+ * synchronously. Batches smaller than 'minimumRingBatchSize' are also executed
+ * synchronously, as setting up the io_uring instance costs about as much as
+ * tens of system calls; the instance is set up by the first larger submit().
+ *
+ * The calls of a batch may execute in any order: calls depending on each
+ * other (e.g. creating a directory, then opening it) belong to different
+ * batches. The paths are copied by the batch, while the statx buffers must
+ * stay valid until submit() returns.
+ */
+class SyscallBatch {
+  public:
+    static constexpr unsigned int defaultQueueDepth = 256;
+    static constexpr size_t minimumRingBatchSize = 16;
+
+  public:
+    SyscallBatch(unsigned int queueDepth = defaultQueueDepth,
+                 bool useIoUring = false);
+    SyscallBatch(const SyscallBatch &) = delete;
+    SyscallBatch &operator=(const SyscallBatch &) = delete;
+    ~SyscallBatch();
+
+    size_t statx(int dirFd, const std::string &path, int flags,
+                 unsigned int mask, struct statx *buffer);
+    size_t openat(int dirFd, const std::string &path, int flags,
+                  mode_t mode = 0);
+    size_t mkdirat(int dirFd, const std::string &path, mode_t mode);
+    size_t unlinkat(int dirFd, const std::string &path, int flags);
+    size_t fchownat(int dirFd, const std::string &path, uid_t uid, gid_t gid,
+                    int flags);
+    size_t close(int fd);
+
+    void submit();
+    int getResult(size_t index) const { return results.at(index); }
+    size_t size() const { return calls.size(); }
+    void clear();
+    bool isUsingIoUring() const { return ring.isValid(); }
+
+  private:
+    enum class Operation { statx, openat, mkdirat, unlinkat, fchownat, close };
+
+    struct Call {
+        Operation operation;
+        int fd;
+        const char *path;
+        int flags;
+        uint64_t argument0;
+        uint64_t argument1;
+    };
+
+  private:
+    size_t enqueue(Operation operation, int fd, const std::string *path,
+                   int flags, uint64_t argument0 = 0, uint64_t argument1 = 0);
+    void setUpRing();
+    bool isSupportedByRing(Operation operation) const;
+    void prepare(io_uring_sqe &sqe, const Call &call, size_t index) const;
+    void submitToRing(const std::vector<size_t> &indices);
+    int execute(const Call &call) const;
+
+  private:
+    std::deque<std::string> paths;
+    std::vector<Call> calls;
+    std::vector<int> results;
+
+    unsigned int queueDepth;
+    bool isRingRequested;
+    FileDescriptor ring;
+    unsigned int ringEntries = 0;
+    std::vector<bool> supportedOperations;
+    void *submissionRing = nullptr;
+    size_t submissionRingSize = 0;
+    void *completionRing = nullptr;
+    size_t completionRingSize = 0;
+    io_uring_sqe *submissionEntries = nullptr;
+    size_t submissionEntriesSize = 0;
+    // offsets of the ring fields
+    unsigned int submissionTail = 0;
+    unsigned int submissionMask = 0;
+    unsigned int submissionArray = 0;
+    unsigned int completionHead = 0;
+    unsigned int completionTail = 0;
+    unsigned int completionMask = 0;
+    unsigned int completionEntries = 0;
+};
+
+}  // namespace libsarus
+
+#endif
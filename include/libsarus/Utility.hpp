@@ -17,12 +17,15 @@
  * include individual headers instead.
  */
 
+#include "utility/elf.hpp"
 #include "utility/environment.hpp"
 #include "utility/filesystem.hpp"
 #include "utility/hook.hpp"
 #include "utility/json.hpp"
+#include "utility/ldCache.hpp"
 #include "utility/logging.hpp"
 #include "utility/mount.hpp"
+#include "utility/parallel.hpp"
 #include "utility/process.hpp"
 #include "utility/sharedLibs.hpp"
 #include "utility/string.hpp"
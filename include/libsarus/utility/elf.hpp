@@ -0,0 +1,53 @@
+/*
+ * Sarus
+ *
+ * Copyright (c) 2018-2023, ETH Zurich. All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+#ifndef libsarus_utility_elf_hpp
+#define libsarus_utility_elf_hpp
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <elf.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/optional.hpp>
+
+/**
+ * Utility functions for reading ELF files
+ */
+
+namespace libsarus {
+namespace elf {
+
+struct VersionRequirement {
+    std::string file;
+    std::vector<std::string> versions;
+};
+
+struct Info {
+    unsigned char elfClass = ELFCLASSNONE;
+    uint16_t type = ET_NONE;
+    uint16_t machine = EM_NONE;
+    boost::optional<std::string> soname;
+    std::vector<std::string> needed;
+    std::vector<std::string> rpath;
+    std::vector<std::string> runpath;
+    std::vector<std::string> versionDefinitions;
+    std::vector<VersionRequirement> versionRequirements;
+};
+
+bool isElf(const boost::filesystem::path &file);
+Info readInfo(const boost::filesystem::path &file);
+
+}  // namespace elf
+}  // namespace libsarus
+
+#endif
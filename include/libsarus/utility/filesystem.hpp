@@ -11,14 +11,22 @@
 #ifndef libsarus_utility_filesystem_hpp
 #define libsarus_utility_filesystem_hpp
 
+#include <cstdint>
+#include <future>
 #include <string>
 #include <tuple>
+#include <unordered_map>
 #include <vector>
 
 #include <sys/types.h>
 
 #include <boost/filesystem.hpp>
 
+#include "libsarus/AtomicWriteBatch.hpp"
+#include "libsarus/FileDescriptor.hpp"
+#include "libsarus/FileInfo.hpp"
+#include "libsarus/PathHash.hpp"
+
 /**
  * Utility functions for filesystem manipulation and investigation
  */
@@ -26,19 +34,47 @@
 namespace libsarus {
 namespace filesystem {
 
+// Descriptors of existing folders, by path
+using OpenedFolders =
+    std::unordered_map<boost::filesystem::path, FileDescriptor, PathHash>;
+
+struct UniquePath {
+    FileDescriptor fd;
+    boost::filesystem::path path;
+};
+
+struct PathWithinRootfs {
+    // O_PATH file descriptor of the resolved path, not valid if the resolved
+    // path doesn't exist
+    FileDescriptor fd;
+    boost::filesystem::path path;
+};
+
 std::tuple<uid_t, gid_t> getOwner(const boost::filesystem::path &);
 void setOwner(const boost::filesystem::path &, uid_t, gid_t);
 void createFoldersIfNecessary(const boost::filesystem::path &, uid_t uid = -1,
                               gid_t gid = -1);
+void createFoldersIfNecessary(const std::vector<boost::filesystem::path> &,
+                              uid_t uid = -1, gid_t gid = -1,
+                              bool useIoUring = false);
+void createFoldersIfNecessary(const boost::filesystem::path &, uid_t uid,
+                              gid_t gid, OpenedFolders &openedFolders);
 void createFileIfNecessary(const boost::filesystem::path &, uid_t uid = -1,
                            gid_t gid = -1);
 void copyFile(const boost::filesystem::path &src,
               const boost::filesystem::path &dst, uid_t uid = -1,
               gid_t gid = -1);
 void removeFile(const boost::filesystem::path &path);
+void removeTree(const boost::filesystem::path &path,
+                unsigned int numberOfThreads = 0, bool useIoUring = false);
+std::future<void> removeTreeInBackground(
+    const boost::filesystem::path &path,
+    const boost::filesystem::path &trashDir,
+    unsigned int numberOfThreads = 0, bool useIoUring = false);
 void copyFolder(const boost::filesystem::path &src,
                 const boost::filesystem::path &dst, uid_t uid = -1,
-                gid_t gid = -1);
+                gid_t gid = -1, unsigned int numberOfThreads = 0,
+                bool useIoUring = false);
 void changeDirectory(const boost::filesystem::path &path);
 size_t getFileSize(const boost::filesystem::path &filename);
 int countFilesInDirectory(const boost::filesystem::path &path);
@@ -46,22 +82,46 @@ std::string readFile(const boost::filesystem::path &path);
 void writeTextFile(const std::string &text,
                    const boost::filesystem::path &filename,
                    const std::ios_base::openmode mode = std::ios_base::out);
+void writeTextFile(const std::string &text,
+                   const boost::filesystem::path &filename,
+                   AtomicWriteBatch &batch);
+void writeTextFileAtomically(const std::string &text,
+                             const boost::filesystem::path &filename,
+                             bool durable = true);
 boost::filesystem::path makeUniquePathWithRandomSuffix(
     const boost::filesystem::path &);
+UniquePath createUniqueFile(const boost::filesystem::path &path,
+                            mode_t mode = 0600);
+UniquePath createUniqueDirectory(const boost::filesystem::path &path,
+                                 mode_t mode = 0700);
+FileDescriptor createAnonymousFile(const boost::filesystem::path &dir,
+                                   mode_t mode = 0600);
 std::string makeColonSeparatedListOfPaths(
     const std::vector<boost::filesystem::path> &paths);
+boost::filesystem::path getSymlinkTarget(const boost::filesystem::path &path);
 boost::filesystem::path appendPathsWithinRootfs(
     const boost::filesystem::path &rootfs, const boost::filesystem::path &path0,
     const boost::filesystem::path &path1,
     std::vector<boost::filesystem::path> *traversedSymlinks = nullptr);
+PathWithinRootfs openWithinRootfs(const boost::filesystem::path &rootfs,
+                                  const boost::filesystem::path &path);
 boost::filesystem::path realpathWithinRootfs(
     const boost::filesystem::path &rootfs, const boost::filesystem::path &path);
+uint64_t fingerprintTree(const boost::filesystem::path &dir,
+                         bool hashContent = false,
+                         const boost::filesystem::path &manifestFile = {},
+                         unsigned int numberOfThreads = 0);
 dev_t getDeviceID(const boost::filesystem::path &path);
+dev_t getDeviceID(const FileInfo &info);
 char getDeviceType(const boost::filesystem::path &path);
+char getDeviceType(const FileInfo &info);
 
 bool isDeviceFile(const boost::filesystem::path &path);
+bool isDeviceFile(const FileInfo &info);
 bool isBlockDevice(const boost::filesystem::path &path);
+bool isBlockDevice(const FileInfo &info);
 bool isCharacterDevice(const boost::filesystem::path &path);
+bool isCharacterDevice(const FileInfo &info);
 bool isSymlink(const boost::filesystem::path &path);
 bool isLibc(const boost::filesystem::path &);
 bool isSharedLib(const boost::filesystem::path &file);
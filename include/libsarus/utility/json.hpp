@@ -17,6 +17,8 @@
 #include <rapidjson/document.h>
 #include <rapidjson/schema.h>
 
+#include "libsarus/AtomicWriteBatch.hpp"
+
 /**
  * Utility functions for JSON operations
  */
@@ -32,6 +34,8 @@ rapidjson::Document readAndValidate(const boost::filesystem::path &jsonFile,
                                     const boost::filesystem::path &schemaFile);
 void write(const rapidjson::Value &json,
            const boost::filesystem::path &filename);
+void write(const rapidjson::Value &json,
+           const boost::filesystem::path &filename, AtomicWriteBatch &batch);
 std::string serialize(const rapidjson::Value &json);
 
 }  // namespace json
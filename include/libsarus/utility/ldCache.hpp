@@ -0,0 +1,62 @@
+/*
+ * Sarus
+ *
+ * Copyright (c) 2018-2023, ETH Zurich. All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+#ifndef libsarus_utility_ldCache_hpp
+#define libsarus_utility_ldCache_hpp
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/optional.hpp>
+
+/**
+ * Utility functions for the dynamic linker's cache (ld.so.cache)
+ */
+
+namespace libsarus {
+namespace ldcache {
+
+// Values of the flags field of the cache entries, as defined by glibc
+constexpr int32_t flagTypeMask = 0x00ff;
+constexpr int32_t flagElf = 0x0001;
+constexpr int32_t flagElfLibc6 = 0x0003;
+constexpr int32_t flagArchMask = 0xff00;
+constexpr int32_t flagX8664Lib64 = 0x0300;
+constexpr int32_t flagAarch64Lib64 = 0x0a00;
+
+// Bit of the hwcap field marking entries of glibc-hwcaps subdirectories
+constexpr uint64_t hwcapExtensionFlag = uint64_t{1} << 62;
+
+struct Entry {
+    std::string soname;
+    boost::filesystem::path path;
+    int32_t flags = 0;
+    uint64_t hwcap = 0;
+    boost::optional<std::string> hwcapsSubdirectory;
+};
+
+boost::filesystem::path getCachePath(const boost::filesystem::path &rootDir);
+std::vector<Entry> read(const boost::filesystem::path &cacheFile);
+Entry makeEntry(const boost::filesystem::path &lib,
+                const boost::filesystem::path &rootDir = "/");
+std::vector<Entry> scanDirectories(
+    const std::vector<boost::filesystem::path> &directories,
+    const boost::filesystem::path &rootDir = "/");
+void write(const boost::filesystem::path &cacheFile,
+           const std::vector<Entry> &entries);
+void append(const boost::filesystem::path &cacheFile,
+            const std::vector<Entry> &entries);
+
+}  // namespace ldcache
+}  // namespace libsarus
+
+#endif
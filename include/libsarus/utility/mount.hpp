@@ -12,6 +12,8 @@
 #define libsarus_utility_mount_hpp
 
 #include <cstddef>
+#include <future>
+#include <vector>
 
 #include <sys/mount.h>
 #include <sys/stat.h>
@@ -34,8 +36,15 @@ boost::filesystem::path getValidatedMountSource(
 boost::filesystem::path getValidatedMountDestination(
     const boost::filesystem::path &destination,
     const boost::filesystem::path &rootfsDir);
+boost::filesystem::path getValidatedMountDestination(
+    const boost::filesystem::path &destination,
+    const boost::filesystem::path &rootfsDir,
+    const std::vector<dev_t> &allowedDevices);
 bool isPathOnAllowedDevice(const boost::filesystem::path &path,
                            const boost::filesystem::path &rootfsDir);
+bool isPathOnAllowedDevice(const boost::filesystem::path &path,
+                           const std::vector<dev_t> &allowedDevices);
+std::vector<dev_t> getAllowedDevices(const boost::filesystem::path &rootfsDir);
 dev_t getDevice(const boost::filesystem::path &path);
 void validatedBindMount(const boost::filesystem::path &source,
                         const boost::filesystem::path &destination,
@@ -46,6 +55,10 @@ void bindMount(const boost::filesystem::path &from,
                const boost::filesystem::path &to, unsigned long flags = 0);
 void loopMountSquashfs(const boost::filesystem::path &image,
                        const boost::filesystem::path &mountPoint);
+std::future<void> prefetchSquashfs(const boost::filesystem::path &image);
+std::future<void> prefetchSquashfsFiles(
+    const boost::filesystem::path &mountPoint,
+    const std::vector<boost::filesystem::path> &files);
 void mountOverlayfs(const boost::filesystem::path &lowerDir,
                     const boost::filesystem::path &upperDir,
                     const boost::filesystem::path &workDir,
@@ -0,0 +1,35 @@
+/*
+ * Sarus
+ *
+ * Copyright (c) 2018-2023, ETH Zurich. All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+#ifndef libsarus_utility_parallel_hpp
+#define libsarus_utility_parallel_hpp
+
+#include <cstddef>
+#include <functional>
+
+/**
+ * Utility functions for parallel execution
+ */
+
+namespace libsarus {
+namespace parallel {
+
+unsigned int getDefaultNumberOfThreads();
+unsigned int getNumberOfWorkers(size_t count, unsigned int numberOfThreads = 0);
+void forEachIndex(size_t count, const std::function<void(size_t)> &task,
+                  unsigned int numberOfThreads = 0);
+void forEachIndexInWorkers(
+    size_t count, const std::function<void(size_t, unsigned int)> &task,
+    unsigned int numberOfThreads = 0);
+
+}  // namespace parallel
+}  // namespace libsarus
+
+#endif
@@ -12,17 +12,41 @@
 #define libsarus_utility_sharedLibs_hpp
 
 #include <string>
+#include <tuple>
 #include <vector>
 
 #include <boost/filesystem.hpp>
+#include <boost/optional.hpp>
 
 /**
  * Utility functions for shared libraries
  */
 
 namespace libsarus {
+
+class RootfsResolver;
+
 namespace sharedlibs {
 
+struct Library {
+    boost::filesystem::path path;
+    std::vector<std::string> abi;
+};
+
+struct BindMountPlan {
+    struct Mount {
+        boost::filesystem::path source;
+        boost::filesystem::path destination;
+    };
+
+    // host libraries mounted over ABI-compatible container libraries
+    std::vector<Mount> replacements;
+    // host libraries without any container library with the same linker name
+    std::vector<Mount> injections;
+    // container libraries without an ABI-compatible host library
+    std::vector<boost::filesystem::path> incompatibleContainerLibs;
+};
+
 boost::filesystem::path getLinkerName(const boost::filesystem::path &path);
 std::vector<boost::filesystem::path> getListFromDynamicLinker(
     const boost::filesystem::path &ldconfigPath,
@@ -31,10 +55,32 @@ std::vector<std::string> parseAbi(const boost::filesystem::path &lib);
 std::vector<std::string> resolveAbi(
     const boost::filesystem::path &lib,
     const boost::filesystem::path &rootDir = "/");
+std::vector<std::string> resolveAbi(const boost::filesystem::path &lib,
+                                    RootfsResolver &rootfsResolver);
+std::vector<std::vector<std::string>> resolveAbiBatch(
+    const std::vector<boost::filesystem::path> &libs,
+    const boost::filesystem::path &rootDir = "/",
+    unsigned int numberOfThreads = 0);
+std::vector<boost::filesystem::path> getDependencyClosure(
+    const std::vector<boost::filesystem::path> &libs,
+    const boost::filesystem::path &rootDir = "/",
+    unsigned int numberOfThreads = 0);
+bool areAbiCompatible(const std::vector<std::string> &hostAbi,
+                      const std::vector<std::string> &containerAbi);
+BindMountPlan planBindMounts(const std::vector<Library> &hostLibs,
+                             const std::vector<Library> &containerLibs,
+                             const boost::filesystem::path &injectionDir);
+boost::filesystem::path findLibc(const boost::filesystem::path &rootDir = "/");
+std::tuple<unsigned int, unsigned int> getLibcVersion(
+    const boost::filesystem::path &libc);
+std::tuple<unsigned int, unsigned int> getGlibcVersion(
+    const boost::filesystem::path &rootDir = "/");
+boost::optional<std::tuple<unsigned int, unsigned int>>
+getMaxRequiredGlibcVersion(const boost::filesystem::path &lib);
 std::string getSoname(const boost::filesystem::path &path,
-                      const boost::filesystem::path &readelfPath);
+                      const boost::filesystem::path &readelfPath = {});
 bool is64bitSharedLib(const boost::filesystem::path &path,
-                      const boost::filesystem::path &readelfPath);
+                      const boost::filesystem::path &readelfPath = {});
 
 }  // namespace sharedlibs
 }  // namespace libsarus
@@ -0,0 +1,214 @@
+/*
+ * Sarus
+ *
+ * Copyright (c) 2018-2023, ETH Zurich. All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+#include "libsarus/AtomicWriteBatch.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/format.hpp>
+
+#include "libsarus/Error.hpp"
+#include "libsarus/utility/filesystem.hpp"
+#include "libsarus/utility/string.hpp"
+
+namespace libsarus {
+
+static boost::filesystem::path makeTemporaryName(
+    const boost::filesystem::path &filename) {
+    const size_t sizeOfRandomSuffix = 16;
+    return "." + filename.filename().string() + "." +
+           string::generateRandom(sizeOfRandomSuffix);
+}
+
+static void writeAll(int fd, std::string_view content,
+                     const boost::filesystem::path &filename) {
+    while (!content.empty()) {
+        auto bytesWritten = write(fd, content.data(), content.size());
+        if (bytesWritten < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytesWritten < 0) {
+            auto message = boost::format("Failed to write %s: %s") % filename %
+                           strerror(errno);
+            SARUS_THROW_ERROR(message.str());
+        }
+        content.remove_prefix(bytesWritten);
+    }
+}
+
+AtomicWriteBatch::AtomicWriteBatch(bool durable) : durable{durable} {}
+
+AtomicWriteBatch::~AtomicWriteBatch() { discard(); }
+
+/**
+ * Writes 'content' to a temporary file which replaces 'filename' at the
+ * commit. The parent directories of 'filename' are created if necessary.
+ */
+void AtomicWriteBatch::add(const boost::filesystem::path &filename,
+                           std::string_view content) {
+    auto pendingWrite = PendingWrite{
+        filename, openDirectory(filename.parent_path()), FileDescriptor{}, {}};
+    try {
+        createTemporaryFile(pendingWrite);
+        writeAll(pendingWrite.fd.get(), content, filename);
+        if (durable && fdatasync(pendingWrite.fd.get()) != 0) {
+            auto message = boost::format("Failed to sync %s: %s") % filename %
+                           strerror(errno);
+            SARUS_THROW_ERROR(message.str());
+        }
+    } catch (const std::exception &e) {
+        if (!pendingWrite.temporaryName.empty()) {
+            unlinkat(pendingWrite.dirFd, pendingWrite.temporaryName.c_str(), 0);
+        }
+        auto message =
+            boost::format("Failed to write text file %s atomically") % filename;
+        SARUS_RETHROW_ERROR(e, message.str());
+    }
+    pendingWrites.push_back(std::move(pendingWrite));
+}
+
+/**
+ * Moves the files written so far into place.
+ */
+void AtomicWriteBatch::commit() {
+    auto committed = pendingWrites.begin();
+    try {
+        for (; committed != pendingWrites.end(); ++committed) {
+            if (committed->temporaryName.empty()) {
+                linkTemporaryFile(*committed);
+            }
+            auto name = committed->filename.filename();
+            if (renameat(committed->dirFd, committed->temporaryName.c_str(),
+                         committed->dirFd, name.c_str()) != 0) {
+                auto message =
+                    boost::format("Failed to rename %s to %s: %s") %
+                    (committed->filename.parent_path() /
+                     committed->temporaryName) %
+                    committed->filename % strerror(errno);
+                SARUS_THROW_ERROR(message.str());
+            }
+        }
+    } catch (...) {
+        pendingWrites.erase(pendingWrites.begin(), committed);
+        throw;
+    }
+    pendingWrites.clear();
+
+    // the renames are persisted by syncing their directories
+    if (durable) {
+        for (const auto &directory : directories) {
+            if (fsync(directory.second.get()) != 0) {
+                auto message =
+                    boost::format("Failed to sync directory %s: %s") %
+                    directory.first % strerror(errno);
+                SARUS_THROW_ERROR(message.str());
+            }
+        }
+    }
+    directories.clear();
+}
+
+/**
+ * Drops the files written and not yet committed.
+ */
+void AtomicWriteBatch::discard() {
+    for (const auto &pendingWrite : pendingWrites) {
+        if (!pendingWrite.temporaryName.empty()) {
+            unlinkat(pendingWrite.dirFd, pendingWrite.temporaryName.c_str(), 0);
+        }
+    }
+    pendingWrites.clear();
+    directories.clear();
+}
+
+int AtomicWriteBatch::openDirectory(const boost::filesystem::path &dir) {
+    auto it = directories.find(dir);
+    if (it != directories.cend()) {
+        return it->second.get();
+    }
+
+    if (!dir.empty()) {
+        filesystem::createFoldersIfNecessary(dir);
+    }
+    auto path = dir.empty() ? boost::filesystem::path{"."} : dir;
+    auto fd = FileDescriptor{
+        open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)};
+    if (!fd.isValid()) {
+        auto message = boost::format("Failed to open directory %s: %s") % path %
+                       strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
+    return directories.emplace(dir, std::move(fd)).first->second.get();
+}
+
+void AtomicWriteBatch::createTemporaryFile(PendingWrite &pendingWrite) const {
+    pendingWrite.fd.reset(openat(pendingWrite.dirFd, ".",
+                                 O_TMPFILE | O_WRONLY | O_CLOEXEC, 0666));
+
+    // fall back to a named sibling on filesystems without O_TMPFILE support
+    if (!pendingWrite.fd.isValid() &&
+        (errno == EOPNOTSUPP || errno == EISDIR || errno == EINVAL)) {
+        do {
+            pendingWrite.temporaryName =
+                makeTemporaryName(pendingWrite.filename);
+            pendingWrite.fd.reset(
+                openat(pendingWrite.dirFd, pendingWrite.temporaryName.c_str(),
+                       O_CREAT | O_EXCL | O_WRONLY | O_CLOEXEC, 0666));
+        } while (!pendingWrite.fd.isValid() && errno == EEXIST);
+        if (!pendingWrite.fd.isValid()) {
+            pendingWrite.temporaryName.clear();
+        }
+    }
+
+    if (!pendingWrite.fd.isValid()) {
+        auto message = boost::format("Failed to create temporary file for %s: "
+                                     "%s") %
+                       pendingWrite.filename % strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
+
+    // the replacement keeps the permissions of the file it replaces
+    struct stat sb;
+    auto name = pendingWrite.filename.filename();
+    if (fstatat(pendingWrite.dirFd, name.c_str(), &sb, 0) == 0 &&
+        fchmod(pendingWrite.fd.get(), sb.st_mode & 07777) != 0) {
+        auto message = boost::format("Failed to set permissions for %s: %s") %
+                       pendingWrite.filename % strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
+}
+
+// Gives a temporary name to an O_TMPFILE file, so that it can be renamed.
+// Linking through /proc/self/fd doesn't require the CAP_DAC_READ_SEARCH
+// capability, as linkat(2) with AT_EMPTY_PATH does.
+void AtomicWriteBatch::linkTemporaryFile(PendingWrite &pendingWrite) const {
+    auto procPath = "/proc/self/fd/" + std::to_string(pendingWrite.fd.get());
+    while (true) {
+        auto temporaryName = makeTemporaryName(pendingWrite.filename);
+        if (linkat(AT_FDCWD, procPath.c_str(), pendingWrite.dirFd,
+                   temporaryName.c_str(), AT_SYMLINK_FOLLOW) == 0) {
+            pendingWrite.temporaryName = temporaryName;
+            return;
+        }
+        if (errno != EEXIST) {
+            auto message = boost::format("Failed to link temporary file for "
+                                         "%s: %s") %
+                           pendingWrite.filename % strerror(errno);
+            SARUS_THROW_ERROR(message.str());
+        }
+    }
+}
+
+}  // namespace libsarus
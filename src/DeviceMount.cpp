@@ -19,6 +19,21 @@ namespace libsarus {
 
 DeviceMount::DeviceMount(Mount &&baseMount, const DeviceAccess &access)
     : Mount{std::move(baseMount)}, access{access} {
+    setDevice(FileInfo{getSource(), STATX_TYPE});
+}
+
+/**
+ * Constructs the device mount from a snapshot of the source's metadata taken
+ * by the caller, e.g. while looking for device files, saving a stat of the
+ * source
+ */
+DeviceMount::DeviceMount(Mount &&baseMount, const DeviceAccess &access,
+                         const FileInfo &sourceInfo)
+    : Mount{std::move(baseMount)}, access{access} {
+    setDevice(sourceInfo);
+}
+
+void DeviceMount::setDevice(const FileInfo &sourceInfo) {
     logMessage(
         boost::format("Constructing device mount object: source = %s; "
                       "destination = %s; mount flags = %d; access = %s") %
@@ -26,14 +41,14 @@ DeviceMount::DeviceMount(Mount &&baseMount, const DeviceAccess &access)
             access.string(),
         LogLevel::DEBUG);
 
-    if (!libsarus::filesystem::isDeviceFile(getSource())) {
+    if (!libsarus::filesystem::isDeviceFile(sourceInfo)) {
         auto message =
             boost::format("Source path %s is not a device file") % getSource();
         SARUS_THROW_ERROR(message.str());
     }
 
-    id = libsarus::filesystem::getDeviceID(getSource());
-    type = libsarus::filesystem::getDeviceType(getSource());
+    id = libsarus::filesystem::getDeviceID(sourceInfo);
+    type = libsarus::filesystem::getDeviceType(sourceInfo);
 }
 
 unsigned int DeviceMount::getMajorID() const { return major(id); }
@@ -0,0 +1,115 @@
+/*
+ * Sarus
+ *
+ * Copyright (c) 2018-2023, ETH Zurich. All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+#include "libsarus/DirectoryScanner.hpp"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <boost/format.hpp>
+
+#include "libsarus/Error.hpp"
+#include "libsarus/FileDescriptor.hpp"
+
+namespace libsarus {
+
+namespace {
+
+// Record returned by the getdents64(2) system call
+struct LinuxDirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+}  // namespace
+
+DirectoryScanner::DirectoryScanner(size_t bufferSize) : buffer(bufferSize) {}
+
+/**
+ * Calls 'function' for each entry of the directory 'dir', except "." and "..".
+ */
+void DirectoryScanner::scan(
+    const boost::filesystem::path &dir,
+    const std::function<void(const DirectoryEntry &)> &function) {
+    auto fd =
+        FileDescriptor{open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)};
+    if (!fd.isValid()) {
+        auto message = boost::format("Failed to open directory %s: %s") % dir %
+                       strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
+    scan(fd.get(), dir, function);
+}
+
+/**
+ * Calls 'function' for each entry of the directory opened as 'dirFd', except
+ * "." and "..". The path 'dir' is only used in the error messages.
+ */
+void DirectoryScanner::scan(
+    int dirFd, const boost::filesystem::path &dir,
+    const std::function<void(const DirectoryEntry &)> &function) {
+    // restart from the first entry, in case the directory was already scanned
+    if (lseek(dirFd, 0, SEEK_SET) != 0) {
+        auto message = boost::format("Failed to rewind directory %s: %s") %
+                       dir % strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
+
+    while (true) {
+        auto size =
+            syscall(SYS_getdents64, dirFd, buffer.data(), buffer.size());
+        if (size < 0) {
+            auto message = boost::format("Failed to read directory %s: %s") %
+                           dir % strerror(errno);
+            SARUS_THROW_ERROR(message.str());
+        }
+        if (size == 0) {
+            return;
+        }
+        for (long offset = 0; offset < size;) {
+            const auto *record =
+                reinterpret_cast<const LinuxDirent64 *>(&buffer[offset]);
+            offset += record->d_reclen;
+            if (strcmp(record->d_name, ".") == 0 ||
+                strcmp(record->d_name, "..") == 0) {
+                continue;
+            }
+
+            auto entry =
+                DirectoryEntry{record->d_name, record->d_type, record->d_ino};
+            if (entry.type == DT_UNKNOWN) {
+                struct stat st;
+                if (fstatat(dirFd, record->d_name, &st, AT_SYMLINK_NOFOLLOW) !=
+                    0) {
+                    if (errno == ENOENT) {
+                        continue;  // removed while scanning
+                    }
+                    auto message = boost::format("Failed to stat %s: %s") %
+                                   (dir / record->d_name) % strerror(errno);
+                    SARUS_THROW_ERROR(message.str());
+                }
+                entry.type = IFTODT(st.st_mode);
+            }
+            function(entry);
+        }
+    }
+}
+
+}  // namespace libsarus
@@ -0,0 +1,41 @@
+/*
+ * Sarus
+ *
+ * Copyright (c) 2018-2023, ETH Zurich. All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+#include "libsarus/FileDescriptor.hpp"
+
+#include <unistd.h>
+
+namespace libsarus {
+
+FileDescriptor::FileDescriptor(int fd) : fd{fd} {}
+
+FileDescriptor::FileDescriptor(FileDescriptor &&rhs) : fd{rhs.release()} {}
+
+FileDescriptor &FileDescriptor::operator=(FileDescriptor &&rhs) {
+    reset(rhs.release());
+    return *this;
+}
+
+FileDescriptor::~FileDescriptor() { reset(); }
+
+int FileDescriptor::release() {
+    auto released = fd;
+    fd = -1;
+    return released;
+}
+
+void FileDescriptor::reset(int newFd) {
+    if (fd >= 0 && fd != newFd) {
+        close(fd);
+    }
+    fd = newFd;
+}
+
+}  // namespace libsarus
@@ -0,0 +1,120 @@
+/*
+ * Sarus
+ *
+ * Copyright (c) 2018-2023, ETH Zurich. All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+#include "libsarus/FileInfo.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/sysmacros.h>
+
+#include <boost/format.hpp>
+
+#include "libsarus/Error.hpp"
+
+namespace libsarus {
+
+// Set when the kernel turns out not to support statx(2), i.e. Linux < 4.11
+static std::atomic<bool> isStatxUnsupported{false};
+
+// Fills 'stx' from stat(2), for kernels without statx(2)
+static int statxWithStat(const boost::filesystem::path &path,
+                         struct statx &stx) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return -1;
+    }
+    stx = {};
+    stx.stx_mask = STATX_BASIC_STATS;
+    stx.stx_mode = st.st_mode;
+    stx.stx_uid = st.st_uid;
+    stx.stx_gid = st.st_gid;
+    stx.stx_size = st.st_size;
+    stx.stx_ino = st.st_ino;
+    stx.stx_nlink = st.st_nlink;
+    stx.stx_rdev_major = major(st.st_rdev);
+    stx.stx_rdev_minor = minor(st.st_rdev);
+    stx.stx_dev_major = major(st.st_dev);
+    stx.stx_dev_minor = minor(st.st_dev);
+    return 0;
+}
+
+FileInfo::FileInfo(const boost::filesystem::path &path, unsigned int mask)
+    : path{path}, mask{mask} {
+    int result = -1;
+    if (!isStatxUnsupported) {
+        result = statx(AT_FDCWD, path.c_str(), AT_STATX_SYNC_AS_STAT, mask,
+                       &stx);
+        if (result != 0 && errno == ENOSYS) {
+            isStatxUnsupported = true;
+        }
+    }
+    if (isStatxUnsupported) {
+        result = statxWithStat(path, stx);
+    }
+
+    if (result != 0) {
+        auto message =
+            boost::format(
+                "Failed to retrieve information about file %s. Stat failed: "
+                "%s") %
+            path % strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
+}
+
+/**
+ * Returns the file type bits of the mode (S_IFMT), which can be retrieved
+ * without the permissions
+ */
+mode_t FileInfo::getFileType() const {
+    checkRetrieved(STATX_TYPE, "file type");
+    return stx.stx_mode & S_IFMT;
+}
+
+mode_t FileInfo::getMode() const {
+    checkRetrieved(STATX_TYPE | STATX_MODE, "mode");
+    return stx.stx_mode;
+}
+
+std::tuple<uid_t, gid_t> FileInfo::getOwner() const {
+    checkRetrieved(STATX_UID | STATX_GID, "owner");
+    return std::tuple<uid_t, gid_t>{stx.stx_uid, stx.stx_gid};
+}
+
+uint64_t FileInfo::getSize() const {
+    checkRetrieved(STATX_SIZE, "size");
+    return stx.stx_size;
+}
+
+/**
+ * Returns the ID of the device represented by the file, which is meaningful
+ * only for device files
+ */
+dev_t FileInfo::getDeviceID() const {
+    checkRetrieved(STATX_TYPE, "device ID");
+    return makedev(stx.stx_rdev_major, stx.stx_rdev_minor);
+}
+
+void FileInfo::checkRetrieved(unsigned int field, const char *fieldName) const {
+    // the kernel may return more fields than requested, but relying on them
+    // would make the callers depend on the filesystem
+    if ((mask & stx.stx_mask & field) != field) {
+        auto message = boost::format(
+                           "Failed to get %s of file %s: the information was "
+                           "not retrieved") %
+                       fieldName % path;
+        SARUS_THROW_ERROR(message.str());
+    }
+}
+
+}  // namespace libsarus
@@ -0,0 +1,97 @@
+/*
+ * Sarus
+ *
+ * Copyright (c) 2018-2023, ETH Zurich. All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+#include "libsarus/FileView.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/format.hpp>
+
+#include "libsarus/Error.hpp"
+#include "libsarus/FileDescriptor.hpp"
+
+namespace libsarus {
+
+// Below this size, a read(2) into a buffer is cheaper than setting up and
+// tearing down a memory mapping
+static constexpr size_t minimumSizeToMap = 1 << 16;
+
+// Growth step of the buffer for files whose size is unknown
+static constexpr size_t readChunkSize = 1 << 16;
+
+FileView::FileView(const boost::filesystem::path &file) : path{file} {
+    auto fd = FileDescriptor{open(file.c_str(), O_RDONLY | O_CLOEXEC)};
+    if (!fd.isValid()) {
+        auto message =
+            boost::format("Failed to open %s: %s") % file % strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
+
+    struct stat sb;
+    if (fstat(fd.get(), &sb) != 0) {
+        auto message =
+            boost::format("Failed to stat %s: %s") % file % strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
+
+    // Files of pseudo-filesystems (procfs, sysfs) report a size which doesn't
+    // match their content, so only a regular file's size is used as a hint
+    auto expectedSize = S_ISREG(sb.st_mode) ? size_t(sb.st_size) : 0;
+    if (expectedSize >= minimumSizeToMap) {
+        try {
+            mappedFile.emplace(fd.get(), file, expectedSize);
+            return;
+        } catch (const Error &) {
+            // e.g. the filesystem doesn't support mmap(2): read the file
+        }
+    }
+    readContent(fd.get(), expectedSize);
+}
+
+std::string_view FileView::view() const {
+    if (mappedFile) {
+        return {reinterpret_cast<const char *>(mappedFile->data()),
+                mappedFile->size()};
+    }
+    return buffer;
+}
+
+void FileView::readContent(int fd, size_t expectedSize) {
+    size_t used = 0;
+    while (true) {
+        if (used == buffer.size()) {
+            buffer.resize(used + (used < expectedSize ? expectedSize - used
+                                                      : readChunkSize));
+        }
+        auto bytesRead = read(fd, &buffer[used], buffer.size() - used);
+        if (bytesRead < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytesRead < 0) {
+            auto message =
+                boost::format("Failed to read %s: %s") % path % strerror(errno);
+            SARUS_THROW_ERROR(message.str());
+        }
+        used += bytesRead;
+        // A regular file is complete once its size was read, which saves the
+        // read(2) returning the end of file
+        if (bytesRead == 0 || (expectedSize > 0 && used == expectedSize)) {
+            break;
+        }
+    }
+    buffer.resize(used);
+}
+
+}  // namespace libsarus
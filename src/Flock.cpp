@@ -27,20 +27,24 @@ namespace libsarus {
 
 const milliseconds Flock::noTimeout =
     milliseconds{std::numeric_limits<unsigned long long>::max()};
+const milliseconds Flock::defaultPollInterval = milliseconds{100};
 
 Flock::Flock()
     : logger{&libsarus::Logger::getInstance()},
       lockType{Type::readLock},
       timeoutTime{milliseconds{noTimeout}},
-      warningTime{milliseconds{1000}} {}
+      warningTime{milliseconds{1000}},
+      pollInterval{defaultPollInterval} {}
 
 Flock::Flock(const boost::filesystem::path &file, const Type type,
-             const milliseconds &timeoutMs, const milliseconds &warningMs)
+             const milliseconds &timeoutMs, const milliseconds &warningMs,
+             const milliseconds &pollIntervalMs)
     : logger{&libsarus::Logger::getInstance()},
       lockfile{file},
       lockType{type},
       timeoutTime{timeoutMs},
-      warningTime{warningMs} {
+      warningTime{warningMs},
+      pollInterval{pollIntervalMs} {
     auto message = boost::format("Initializing lock on file %s") % file;
     logger->log(message.str(), loggerSubsystemName, libsarus::LogLevel::DEBUG);
     timedLockAcquisition();
@@ -54,7 +58,8 @@ Flock::Flock(Flock &&rhs)
       lockType{std::move(rhs.lockType)},
       fileFd{std::move(rhs.fileFd)},
       timeoutTime{std::move(rhs.timeoutTime)},
-      warningTime{std::move(rhs.warningTime)} {
+      warningTime{std::move(rhs.warningTime)},
+      pollInterval{std::move(rhs.pollInterval)} {
     auto message =
         boost::format("move constructing lock for %s") % *rhs.lockfile;
     logger->log(message, loggerSubsystemName, libsarus::LogLevel::DEBUG);
@@ -73,6 +78,7 @@ Flock &Flock::operator=(Flock &&rhs) {
     fileFd = std::move(rhs.fileFd);
     timeoutTime = std::move(rhs.timeoutTime);
     warningTime = std::move(rhs.warningTime);
+    pollInterval = std::move(rhs.pollInterval);
     logger->log("successfully move assigned lock", loggerSubsystemName,
                 libsarus::LogLevel::DEBUG);
     return *this;
@@ -95,7 +101,6 @@ void Flock::convertToType(const Type type) {
 
 void Flock::timedLockAcquisition() {
     milliseconds elapsedTime{0};
-    milliseconds backoffTime{100};
     while (!acquireLockAtomically()) {
         if (timeoutTime != milliseconds{noTimeout} &&
             elapsedTime >= timeoutTime) {
@@ -105,8 +110,8 @@ void Flock::timedLockAcquisition() {
                            *lockfile % timeoutTime.count();
             SARUS_THROW_ERROR(message.str());
         }
-        std::this_thread::sleep_for(backoffTime);
-        elapsedTime += backoffTime;
+        std::this_thread::sleep_for(pollInterval);
+        elapsedTime += pollInterval;
         if (elapsedTime.count() % warningTime.count() == 0) {
             auto message =
                 boost::format(
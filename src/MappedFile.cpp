@@ -0,0 +1,95 @@
+/*
+ * Sarus
+ *
+ * Copyright (c) 2018-2023, ETH Zurich. All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+#include "libsarus/MappedFile.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/format.hpp>
+
+#include "libsarus/Error.hpp"
+#include "libsarus/FileDescriptor.hpp"
+
+namespace libsarus {
+
+MappedFile::MappedFile(const boost::filesystem::path &file) : path{file} {
+    auto fd = FileDescriptor{open(file.c_str(), O_RDONLY | O_CLOEXEC)};
+    if (!fd.isValid()) {
+        auto message =
+            boost::format("Failed to open %s: %s") % file % strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
+
+    struct stat sb;
+    if (fstat(fd.get(), &sb) != 0) {
+        auto message =
+            boost::format("Failed to stat %s: %s") % file % strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
+
+    map(fd.get(), sb.st_size);
+}
+
+/**
+ * Maps the first 'length' bytes of the file already opened as 'fd', which
+ * remains owned by the caller
+ */
+MappedFile::MappedFile(int fd, const boost::filesystem::path &file,
+                       size_t length)
+    : path{file} {
+    map(fd, length);
+}
+
+MappedFile::MappedFile(MappedFile &&rhs)
+    : path{std::move(rhs.path)}, address{rhs.address}, length{rhs.length} {
+    rhs.address = nullptr;
+    rhs.length = 0;
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&rhs) {
+    release();
+    path = std::move(rhs.path);
+    address = rhs.address;
+    length = rhs.length;
+    rhs.address = nullptr;
+    rhs.length = 0;
+    return *this;
+}
+
+MappedFile::~MappedFile() { release(); }
+
+void MappedFile::map(int fd, size_t length) {
+    // mmap(2) doesn't accept zero-length mappings: an empty file is simply
+    // represented by a null data pointer
+    if (length == 0) {
+        return;
+    }
+    auto *p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+        auto message =
+            boost::format("Failed to mmap %s: %s") % path % strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
+    address = static_cast<const unsigned char *>(p);
+    this->length = length;
+}
+
+void MappedFile::release() {
+    if (address) {
+        munmap(const_cast<unsigned char *>(address), length);
+        address = nullptr;
+        length = 0;
+    }
+}
+
+}  // namespace libsarus
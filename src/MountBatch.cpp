@@ -0,0 +1,241 @@
+/*
+ * Sarus
+ *
+ * Copyright (c) 2018-2023, ETH Zurich. All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+#include "libsarus/MountBatch.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+#include <boost/format.hpp>
+
+#include "libsarus/Error.hpp"
+#include "libsarus/RootfsResolver.hpp"
+#include "libsarus/utility/filesystem.hpp"
+#include "libsarus/utility/logging.hpp"
+#include "libsarus/utility/mount.hpp"
+#include "libsarus/utility/process.hpp"
+
+namespace libsarus {
+
+// Returns whether 'path' is 'dir' or is within it. Both paths are resolved,
+// hence they can be compared as strings.
+static bool isSameOrWithin(const boost::filesystem::path &path,
+                           const boost::filesystem::path &dir) {
+    const auto &p = path.native();
+    const auto &d = dir.native();
+    return p.compare(0, d.size(), d) == 0 &&
+           (p.size() == d.size() || p[d.size()] == '/' || d == "/");
+}
+
+// Returns the paths traversed to resolve the destination within the rootfs,
+// as paths of the host: the lexically normalized destination, the resolution
+// of each of its prefixes and the symlinks traversed meanwhile.
+static std::vector<boost::filesystem::path> getTraversedPaths(
+    RootfsResolver &resolver, const boost::filesystem::path &destination) {
+    const auto &rootfs = resolver.getRootfs();
+    auto traversedSymlinks = std::vector<boost::filesystem::path>{};
+    auto traversedPaths = std::vector<boost::filesystem::path>{
+        rootfs / destination.lexically_normal()};
+
+    auto prefix = boost::filesystem::path{};
+    for (const auto &element : destination) {
+        prefix /= element;
+        if (prefix == "/") {
+            continue;
+        }
+        traversedPaths.push_back(
+            rootfs / resolver.resolve(prefix, &traversedSymlinks));
+    }
+    for (const auto &symlink : traversedSymlinks) {
+        traversedPaths.push_back(rootfs / symlink);
+    }
+    return traversedPaths;
+}
+
+MountBatch::MountBatch(const boost::filesystem::path &rootfsDir,
+                       const UserIdentity &userIdentity)
+    : rootfsDir{rootfsDir}, userIdentity{userIdentity} {}
+
+void MountBatch::add(const boost::filesystem::path &source,
+                     const boost::filesystem::path &destination,
+                     unsigned long flags) {
+    mounts.push_back(Request{source, destination, flags});
+}
+
+/**
+ * Adds a mount, which must refer to the rootfs and user of the batch
+ */
+void MountBatch::add(const Mount &mount) {
+    if (mount.getRootfsDir() != rootfsDir ||
+        mount.getUserIdentity().uid != userIdentity.uid ||
+        mount.getUserIdentity().gid != userIdentity.gid) {
+        auto message = boost::format("Failed to add bind mount %s -> %s to "
+                                     "batch: the mount refers to a different "
+                                     "rootfs or user") %
+                       mount.getSource() % mount.getDestination();
+        SARUS_THROW_ERROR(message.str());
+    }
+    add(mount.getSource(), mount.getDestination(), mount.getFlags());
+}
+
+/**
+ * Performs the mounts in the order they were added. Throws at the first
+ * mount which fails, after performing the previous ones.
+ */
+void MountBatch::performMounts() const {
+    for (size_t begin = 0; begin < mounts.size();) {
+        try {
+            begin = performWave(begin);
+        } catch (Error &e) {
+            logMessage(e.getErrorTrace().back().errorMessage.c_str(),
+                       LogLevel::GENERAL, std::cerr);
+            SARUS_RETHROW_ERROR(
+                e, std::string("Failed to perform custom bind mount"),
+                LogLevel::INFO);
+        }
+    }
+}
+
+// Performs the wave of mounts starting at index 'begin' and returns the index
+// of the first mount of the next wave
+size_t MountBatch::performWave(size_t begin) const {
+    auto rootIdentity = UserIdentity{};
+    auto wave = std::vector<ValidatedMount>{};
+    auto current = begin;
+
+    try {
+        // switch to user identity to make sure user has access to the mount
+        // sources
+        process::switchIdentity(userIdentity);
+        validateWave(begin, current, wave);
+        process::switchIdentity(rootIdentity);
+
+        createMountPoints(begin, current, wave);
+
+        // switch to user filesystem identity to make sure we can access paths
+        // as root even on root_squashed filesystems
+        process::setFilesystemUid(userIdentity);
+        for (size_t i = 0; i < wave.size(); ++i) {
+            current = begin + i;
+            const auto &request = mounts[current];
+            logMessage(boost::format("Performing bind mount: source = %s; "
+                                     "target = %s; mount flags = %d") %
+                           request.source.string() %
+                           request.destination.string() % request.flags,
+                       LogLevel::DEBUG);
+            mount::bindMount(wave[i].sourceReal, wave[i].destinationReal,
+                             request.flags);
+        }
+        process::setFilesystemUid(rootIdentity);
+    } catch (Error &e) {
+        // Restore root identity in case the exception happened while having a
+        // non-privileged id. By setting the euid, the fsuid will also be set
+        // accordingly.
+        process::switchIdentity(rootIdentity);
+        const auto &request = mounts[current];
+        auto message =
+            boost::format("Failed to bind mount %s on container's %s: %s") %
+            request.source.string() % request.destination.string() % e.what();
+        SARUS_RETHROW_ERROR(e, message.str());
+    }
+
+    logMessage(boost::format("Successfully performed %d bind mounts") %
+                   wave.size(),
+               LogLevel::DEBUG);
+    return begin + wave.size();
+}
+
+// Validates the mounts from index 'begin' on, until the end of the wave. A
+// mount which fails validation ends the wave, unless it is the first one: the
+// next wave reports the error after the mounts of this wave are performed.
+void MountBatch::validateWave(size_t begin, size_t &current,
+                              std::vector<ValidatedMount> &wave) const {
+    // no mounts are performed until the end of the validation, hence the
+    // allowed devices don't change
+    auto allowedDevices = mount::getAllowedDevices(rootfsDir);
+    auto resolver = RootfsResolver{rootfsDir};
+
+    for (current = begin; current < mounts.size(); ++current) {
+        const auto &request = mounts[current];
+        auto validated = ValidatedMount{};
+        auto traversedPaths = std::vector<boost::filesystem::path>{};
+        try {
+            validated.sourceReal =
+                mount::getValidatedMountSource(request.source);
+            validated.destinationReal = mount::getValidatedMountDestination(
+                request.destination, rootfsDir, allowedDevices);
+            // see mount::validatedBindMount: the predicate is evaluated as the
+            // user to work on root_squashed filesystems
+            validated.isSourceDirectory =
+                boost::filesystem::is_directory(validated.sourceReal);
+            traversedPaths = getTraversedPaths(resolver, request.destination);
+        } catch (const Error &) {
+            if (wave.empty()) {
+                throw;
+            }
+            return;
+        }
+
+        // the destination depends on a previous mount if any path traversed
+        // to resolve it is within that mount, e.g. a symlink which the mount
+        // covers, even though the final destination is elsewhere
+        auto isDependentOnWave = std::any_of(
+            wave.cbegin(), wave.cend(), [&](const ValidatedMount &m) {
+                return isSameOrWithin(validated.destinationReal,
+                                      m.destinationReal) ||
+                       isSameOrWithin(validated.sourceReal,
+                                      m.destinationReal) ||
+                       std::any_of(traversedPaths.cbegin(),
+                                   traversedPaths.cend(),
+                                   [&m](const boost::filesystem::path &p) {
+                                       return isSameOrWithin(
+                                           p, m.destinationReal);
+                                   });
+            });
+        if (isDependentOnWave) {
+            return;
+        }
+        wave.push_back(std::move(validated));
+    }
+}
+
+// Creates the mount points of the wave as root, owned by the container user
+// as in mount::validatedBindMount. A mount point which cannot be created ends
+// the wave, unless it is the first one.
+void MountBatch::createMountPoints(size_t begin, size_t &current,
+                                   std::vector<ValidatedMount> &wave) const {
+    // no mounts are performed meanwhile, hence the opened folders stay valid
+    auto openedFolders = filesystem::OpenedFolders{};
+    auto uid = userIdentity.uid;
+    auto gid = userIdentity.gid;
+
+    for (size_t i = 0; i < wave.size(); ++i) {
+        current = begin + i;
+        const auto &destination = wave[i].destinationReal;
+        try {
+            if (wave[i].isSourceDirectory) {
+                filesystem::createFoldersIfNecessary(destination, uid, gid,
+                                                     openedFolders);
+            } else {
+                filesystem::createFoldersIfNecessary(
+                    destination.parent_path(), uid, gid, openedFolders);
+                filesystem::createFileIfNecessary(destination, uid, gid);
+            }
+        } catch (const Error &) {
+            if (i == 0) {
+                throw;
+            }
+            wave.resize(i);
+            return;
+        }
+    }
+}
+
+}  // namespace libsarus
@@ -10,11 +10,57 @@
 
 #include "libsarus/PathRAII.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <vector>
+
 #include "libsarus/Error.hpp"
-#include "libsarus/Utility.hpp"
+#include "libsarus/Logger.hpp"
+#include "libsarus/utility/filesystem.hpp"
 
 namespace libsarus {
 
+// Owns the removals started in the background by the destructors of PathRAII
+// objects, which are waited for at exit
+class BackgroundRemovals {
+  public:
+    BackgroundRemovals() {
+        // the removals log their failures: construct the logger first, so that
+        // it is destroyed after the removals completed
+        Logger::getInstance();
+    }
+
+    ~BackgroundRemovals() {
+        for (auto &removal : removals) {
+            removal.wait();
+        }
+    }
+
+    void add(std::future<void> removal) {
+        auto lock = std::lock_guard<std::mutex>{mutex};
+        // forget the removals which already completed
+        removals.erase(std::remove_if(removals.begin(), removals.end(),
+                                      [](const std::future<void> &removal) {
+                                          return removal.wait_for(
+                                                     std::chrono::seconds{0}) ==
+                                                 std::future_status::ready;
+                                      }),
+                       removals.end());
+        removals.push_back(std::move(removal));
+    }
+
+  private:
+    std::mutex mutex;
+    std::vector<std::future<void>> removals;
+};
+
+static BackgroundRemovals &getBackgroundRemovals() {
+    static BackgroundRemovals removals;
+    return removals;
+}
+
 PathRAII::PathRAII(const boost::filesystem::path &path) : path{path} {
     try {
         this->path = path;
@@ -24,24 +70,38 @@ PathRAII::PathRAII(const boost::filesystem::path &path) : path{path} {
     }
 }
 
-PathRAII::PathRAII(PathRAII &&rhs) : path{std::move(rhs.path)} {
+PathRAII::PathRAII(const boost::filesystem::path &path,
+                   const boost::filesystem::path &trashDirectory)
+    : PathRAII{path} {
+    this->trashDirectory = trashDirectory;
+}
+
+PathRAII::PathRAII(PathRAII &&rhs)
+    : path{std::move(rhs.path)},
+      trashDirectory{std::move(rhs.trashDirectory)},
+      useIoUring{rhs.useIoUring} {
     rhs.release();
 }
 
 PathRAII &PathRAII::operator=(PathRAII &&rhs) {
     path = std::move(rhs.path);
+    trashDirectory = std::move(rhs.trashDirectory);
+    useIoUring = rhs.useIoUring;
     rhs.release();
     return *this;
 }
 
 PathRAII::~PathRAII() {
-    if (path && boost::filesystem::exists(*path)) {
-        // Ensure the path contents can be removed by enforcing owner write and
-        // exec permissions. This is needed when using PathRAII for unpacked OCI
-        // image files, because some images (e.g. Fedora) contain files without
-        // owner write or search perms
-        setFilesAsRemovableByOwner();
-        boost::filesystem::remove_all(*path);
+    if (!path) {
+        return;
+    }
+    // removeTree also removes the files without owner write or search
+    // permissions, which are found in unpacked OCI images (e.g. Fedora)
+    if (trashDirectory) {
+        getBackgroundRemovals().add(filesystem::removeTreeInBackground(
+            *path, *trashDirectory, 0, useIoUring));
+    } else {
+        filesystem::removeTree(*path, 0, useIoUring);
     }
 }
 
@@ -49,26 +109,10 @@ const boost::filesystem::path &PathRAII::getPath() const {
     return path.value();
 }
 
-void PathRAII::release() { path.reset(); }
-
-void PathRAII::setFilesAsRemovableByOwner() const {
-    auto requiredPermissions = boost::filesystem::perms::owner_write |
-                               boost::filesystem::perms::owner_exe;
-    boost::filesystem::permissions(
-        *path, boost::filesystem::perms::add_perms | requiredPermissions);
-
-    if (boost::filesystem::is_regular_file(*path)) {
-        return;
-    }
-
-    for (const auto &entry :
-         boost::filesystem::recursive_directory_iterator(*path)) {
-        if (!libsarus::filesystem::isSymlink(entry.path())) {
-            boost::filesystem::permissions(
-                entry.path(),
-                boost::filesystem::perms::add_perms | requiredPermissions);
-        }
-    }
+void PathRAII::setUseIoUring(bool useIoUring) {
+    this->useIoUring = useIoUring;
 }
 
+void PathRAII::release() { path.reset(); }
+
 }  // namespace libsarus
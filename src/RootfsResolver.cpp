@@ -0,0 +1,161 @@
+/*
+ * Sarus
+ *
+ * Copyright (c) 2018-2023, ETH Zurich. All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+#include "libsarus/RootfsResolver.hpp"
+
+#include <algorithm>
+#include <mutex>
+
+#include "libsarus/utility/filesystem.hpp"
+
+namespace libsarus {
+
+RootfsResolver::RootfsResolver(const boost::filesystem::path &rootfs)
+    : rootfs{rootfs} {}
+
+/**
+ * Resolves the given path within the rootfs. See appendPaths.
+ */
+boost::filesystem::path RootfsResolver::resolve(
+    const boost::filesystem::path &path,
+    std::vector<boost::filesystem::path> *traversedSymlinks) {
+    return appendPaths("/", path, traversedSymlinks);
+}
+
+/**
+ * Appends path1 to path0 resolving symlinks within the rootfs. path0 is
+ * expected to be already resolved.
+ *
+ * At the end of the function execution, the optional output parameter
+ * 'traversedSymlinks' contains the various symlinks that were traversed during
+ * the path resolution process.
+ */
+boost::filesystem::path RootfsResolver::appendPaths(
+    const boost::filesystem::path &path0, const boost::filesystem::path &path1,
+    std::vector<boost::filesystem::path> *traversedSymlinks) {
+    auto current = path0;
+
+    for (const auto &element : path1) {
+        if (element == "/") {
+            continue;
+        } else if (element == ".") {
+            continue;
+        } else if (element == "..") {
+            if (current > "/") {
+                current = current.remove_trailing_separator().parent_path();
+            }
+            continue;
+        }
+
+        current = resolvePrefix(current / element, traversedSymlinks);
+    }
+
+    return current;
+}
+
+/**
+ * Returns the resolved path of the given prefix, i.e. an already resolved
+ * directory plus one path element, and appends to 'traversedSymlinks' the
+ * symlinks traversed to resolve it.
+ */
+boost::filesystem::path RootfsResolver::resolvePrefix(
+    const boost::filesystem::path &prefix,
+    std::vector<boost::filesystem::path> *traversedSymlinks) {
+    {
+        auto lock = std::shared_lock<std::shared_mutex>{mutex};
+        auto it = resolvedPrefixes.find(prefix);
+        if (it != resolvedPrefixes.cend()) {
+            if (traversedSymlinks) {
+                traversedSymlinks->insert(traversedSymlinks->end(),
+                                          it->second.traversedSymlinks.cbegin(),
+                                          it->second.traversedSymlinks.cend());
+            }
+            return it->second.path;
+        }
+    }
+
+    // Resolve without holding the lock, as the resolution of a symlink's
+    // target recurses into this function. Concurrent resolutions of the same
+    // prefix produce the same result, so the first one to be stored wins.
+    auto resolved = ResolvedPrefix{};
+    if (filesystem::isSymlink(rootfs / prefix)) {
+        auto target = filesystem::getSymlinkTarget(rootfs / prefix);
+        resolved.traversedSymlinks.push_back(prefix);
+        if (target.is_absolute()) {
+            resolved.path =
+                appendPaths("/", target, &resolved.traversedSymlinks);
+        } else {
+            resolved.path = appendPaths(prefix.parent_path(), target,
+                                        &resolved.traversedSymlinks);
+        }
+    } else {
+        resolved.path = prefix;
+    }
+
+    if (traversedSymlinks) {
+        traversedSymlinks->insert(traversedSymlinks->end(),
+                                  resolved.traversedSymlinks.cbegin(),
+                                  resolved.traversedSymlinks.cend());
+    }
+    auto path = resolved.path;
+
+    auto lock = std::unique_lock<std::shared_mutex>{mutex};
+    resolvedPrefixes.emplace(prefix, std::move(resolved));
+    return path;
+}
+
+/**
+ * Drops all the cached resolutions.
+ */
+void RootfsResolver::invalidate() {
+    auto lock = std::unique_lock<std::shared_mutex>{mutex};
+    resolvedPrefixes.clear();
+}
+
+static bool isWithin(const boost::filesystem::path &path,
+                     const boost::filesystem::path &prefix) {
+    auto pathIt = path.begin();
+    for (const auto &element : prefix) {
+        if (element == ".") {
+            continue;  // trailing separator
+        }
+        if (pathIt == path.end() || *pathIt != element) {
+            return false;
+        }
+        ++pathIt;
+    }
+    return true;
+}
+
+/**
+ * Drops the cached resolutions that depend on the subtree at the given path
+ * within the rootfs, e.g. after a mount on that path. These are the prefixes
+ * within the subtree, the prefixes which resolve into the subtree and the
+ * prefixes which traverse a symlink within the subtree.
+ */
+void RootfsResolver::invalidate(const boost::filesystem::path &prefix) {
+    auto lock = std::unique_lock<std::shared_mutex>{mutex};
+    for (auto it = resolvedPrefixes.begin(); it != resolvedPrefixes.end();) {
+        const auto &symlinks = it->second.traversedSymlinks;
+        auto dependsOnSubtree =
+            isWithin(it->first, prefix) || isWithin(it->second.path, prefix) ||
+            std::any_of(symlinks.cbegin(), symlinks.cend(),
+                        [&prefix](const boost::filesystem::path &symlink) {
+                            return isWithin(symlink, prefix);
+                        });
+        if (dependsOnSubtree) {
+            it = resolvedPrefixes.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+}  // namespace libsarus
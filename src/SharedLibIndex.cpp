@@ -0,0 +1,532 @@
+/*
+ * Sarus
+ *
+ * Copyright (c) 2018-2023, ETH Zurich. All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+#include "libsarus/SharedLibIndex.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include <sys/stat.h>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/format.hpp>
+
+#include "libsarus/Error.hpp"
+#include "libsarus/RootfsResolver.hpp"
+#include "libsarus/utility/elf.hpp"
+#include "libsarus/utility/filesystem.hpp"
+#include "libsarus/utility/ldCache.hpp"
+#include "libsarus/utility/logging.hpp"
+#include "libsarus/utility/parallel.hpp"
+#include "libsarus/utility/sharedLibs.hpp"
+
+namespace libsarus {
+
+namespace {
+
+// On-disk layout of the index (native byte order, the index is node-local):
+//
+//   Header
+//   EntryRecord[entryCount]                sorted by library path
+//   uint32_t[dynamicLinkerLibCount]        indices into the entry records
+//   char[stringsSize]                      NUL-terminated strings
+//
+// Strings are referenced by their offset within the strings area.
+
+constexpr char magic[] = "sarusidx";
+constexpr uint32_t version = 1;
+constexpr uint32_t noString = 0xffffffff;
+
+constexpr uint32_t flagHasDynamicLinkerCacheStamp = 0x1;
+constexpr uint32_t flagHasDynamicLinkerLibs = 0x2;
+
+struct Header {
+    char magic[sizeof(::libsarus::magic) - 1];
+    uint32_t version;
+    uint32_t flags;
+    uint32_t entryCount;
+    uint32_t dynamicLinkerLibCount;
+    uint32_t rootDir;
+    uint32_t stringsSize;
+    SharedLibIndex::FileStamp dynamicLinkerCacheStamp;
+};
+
+struct EntryRecord {
+    uint32_t path;
+    uint32_t realPath;
+    uint32_t linkerName;
+    uint32_t soname;
+    uint32_t abi;
+    uint16_t machine;
+    uint8_t elfClass;
+    uint8_t padding;
+    SharedLibIndex::FileStamp stamp;
+};
+
+static_assert(sizeof(SharedLibIndex::FileStamp) == 32,
+              "unexpected shared library index layout");
+static_assert(sizeof(Header) == 64, "unexpected shared library index layout");
+static_assert(sizeof(EntryRecord) == 56,
+              "unexpected shared library index layout");
+
+class IndexReader {
+  public:
+    IndexReader(const MappedFile &file) : file{file} {
+        auto header = read<Header>(0);
+        entryCount = header.entryCount;
+        dynamicLinkerLibCount = header.dynamicLinkerLibCount;
+        stringsSize = header.stringsSize;
+    }
+
+    template <class T>
+    T read(uint64_t offset) const {
+        if (offset > file.size() || sizeof(T) > file.size() - offset) {
+            throwMalformed("offset out of bounds");
+        }
+        T value;
+        std::memcpy(&value, file.data() + offset, sizeof(T));
+        return value;
+    }
+
+    uint64_t getEntriesOffset() const { return sizeof(Header); }
+
+    uint64_t getDynamicLinkerLibsOffset() const {
+        return getEntriesOffset() + entryCount * sizeof(EntryRecord);
+    }
+
+    uint64_t getStringsOffset() const {
+        return getDynamicLinkerLibsOffset() +
+               dynamicLinkerLibCount * sizeof(uint32_t);
+    }
+
+    // The strings area is checked to be NUL-terminated when the index is
+    // loaded, hence any offset within it identifies a valid C string
+    const char *getString(uint32_t offset) const {
+        if (offset >= stringsSize) {
+            throwMalformed("string offset out of bounds");
+        }
+        return reinterpret_cast<const char *>(file.data() +
+                                              getStringsOffset() + offset);
+    }
+
+    EntryRecord getEntryRecord(uint64_t index) const {
+        return read<EntryRecord>(getEntriesOffset() +
+                                 index * sizeof(EntryRecord));
+    }
+
+    uint64_t getEntryCount() const { return entryCount; }
+
+    [[noreturn]] void throwMalformed(const std::string &reason) const {
+        auto message =
+            boost::format("Failed to read shared library index %s: %s") %
+            file.getPath() % reason;
+        SARUS_THROW_ERROR(message.str());
+    }
+
+  private:
+    const MappedFile &file;
+    uint64_t entryCount;
+    uint64_t dynamicLinkerLibCount;
+    uint64_t stringsSize;
+};
+
+}  // namespace
+
+static boost::optional<SharedLibIndex::FileStamp> getFileStamp(
+    const boost::filesystem::path &path) {
+    struct stat sb;
+    if (stat(path.c_str(), &sb) != 0) {
+        return {};
+    }
+    auto stamp = SharedLibIndex::FileStamp{};
+    stamp.device = sb.st_dev;
+    stamp.inode = sb.st_ino;
+    stamp.mtimeSeconds = sb.st_mtim.tv_sec;
+    stamp.mtimeNanoseconds = sb.st_mtim.tv_nsec;
+    return stamp;
+}
+
+static SharedLibIndex::Entry convertRecordToEntry(const IndexReader &reader,
+                                                  const EntryRecord &record) {
+    auto entry = SharedLibIndex::Entry{};
+    entry.path = reader.getString(record.path);
+    entry.realPath = reader.getString(record.realPath);
+    entry.linkerName = reader.getString(record.linkerName);
+    if (record.soname != noString) {
+        entry.soname = std::string{reader.getString(record.soname)};
+    }
+    if (record.abi != noString) {
+        auto abi = std::string{reader.getString(record.abi)};
+        boost::split(entry.abi, abi, boost::is_any_of("."));
+    }
+    entry.elfClass = record.elfClass;
+    entry.machine = record.machine;
+    entry.stamp = record.stamp;
+    return entry;
+}
+
+SharedLibIndex::SharedLibIndex(const boost::filesystem::path &indexFile,
+                               const boost::filesystem::path &rootDir)
+    : indexFile{indexFile}, rootDir{rootDir} {
+    dynamicLinkerCacheStamp = getFileStamp(ldcache::getCachePath(rootDir));
+    loadIndexFile();
+}
+
+void SharedLibIndex::loadIndexFile() {
+    if (!boost::filesystem::exists(indexFile)) {
+        return;
+    }
+
+    try {
+        auto file = MappedFile{indexFile};
+        auto reader = IndexReader{file};
+        auto header = reader.read<Header>(0);
+
+        if (std::memcmp(header.magic, magic, sizeof(header.magic)) != 0) {
+            reader.throwMalformed("invalid magic");
+        }
+        if (header.version != version) {
+            reader.throwMalformed(
+                (boost::format("unsupported version %d") % header.version)
+                    .str());
+        }
+        if (reader.getStringsOffset() + header.stringsSize != file.size()) {
+            reader.throwMalformed("unexpected file size");
+        }
+        if (header.stringsSize == 0 || file.data()[file.size() - 1] != '\0') {
+            reader.throwMalformed("unterminated strings area");
+        }
+        if (reader.getString(header.rootDir) != rootDir.string()) {
+            reader.throwMalformed(
+                (boost::format("index was built for root directory %s") %
+                 reader.getString(header.rootDir))
+                    .str());
+        }
+
+        // The symlinks leading to the libraries are assumed to be unchanged
+        // as long as the dynamic linker's cache is, since ldconfig rewrites
+        // the cache whenever it updates the links
+        linksMayHaveChanged =
+            !dynamicLinkerCacheStamp ||
+            !(header.flags & flagHasDynamicLinkerCacheStamp) ||
+            !(header.dynamicLinkerCacheStamp == *dynamicLinkerCacheStamp);
+
+        if (!linksMayHaveChanged &&
+            (header.flags & flagHasDynamicLinkerLibs)) {
+            auto libs = std::vector<boost::filesystem::path>{};
+            libs.reserve(header.dynamicLinkerLibCount);
+            for (uint64_t i = 0; i < header.dynamicLinkerLibCount; ++i) {
+                auto index = reader.read<uint32_t>(
+                    reader.getDynamicLinkerLibsOffset() + i * sizeof(uint32_t));
+                if (index >= header.entryCount) {
+                    reader.throwMalformed("entry index out of bounds");
+                }
+                libs.push_back(
+                    reader.getString(reader.getEntryRecord(index).path));
+            }
+            dynamicLinkerLibs = std::move(libs);
+        }
+
+        mappedIndex.emplace(std::move(file));
+    } catch (const Error &e) {
+        auto message =
+            boost::format("Ignoring shared library index %s: %s") % indexFile %
+            e.what();
+        logMessage(message.str(), LogLevel::DEBUG);
+        linksMayHaveChanged = true;
+        dynamicLinkerLibs.reset();
+    }
+}
+
+SharedLibIndex::Entry SharedLibIndex::getEntry(
+    const boost::filesystem::path &lib) {
+    return getEntries({lib}, 1).front();
+}
+
+/**
+ * Returns the index entries of the given libraries, in the same order as the
+ * input. Stale and missing entries are (re)computed in parallel by up to
+ * 'numberOfThreads' threads (0 means one per available CPU).
+ */
+std::vector<SharedLibIndex::Entry> SharedLibIndex::getEntries(
+    const std::vector<boost::filesystem::path> &libs,
+    unsigned int numberOfThreads) {
+    auto entries = std::vector<Entry>(libs.size());
+    auto previousEntries = std::vector<boost::optional<Entry>>(libs.size());
+    auto entriesToCompute = std::vector<size_t>{};
+
+    for (size_t i = 0; i < libs.size(); ++i) {
+        auto previous = boost::optional<Entry>{};
+        auto isResolvedInThisSession = false;
+
+        auto it = updatedEntries.find(libs[i]);
+        if (it != updatedEntries.cend()) {
+            previous = it->second;
+            isResolvedInThisSession = true;
+        } else {
+            previous = findMappedEntry(libs[i]);
+        }
+
+        if (previous && (isResolvedInThisSession || !linksMayHaveChanged) &&
+            getFileStamp(rootDir / previous->realPath) == previous->stamp) {
+            entries[i] = std::move(*previous);
+        } else {
+            previousEntries[i] = std::move(previous);
+            entriesToCompute.push_back(i);
+        }
+    }
+
+    if (entriesToCompute.empty()) {
+        return entries;
+    }
+
+    auto message =
+        boost::format("Updating %d entries of shared library index %s") %
+        entriesToCompute.size() % indexFile;
+    logMessage(message.str(), LogLevel::DEBUG);
+
+    auto rootfsResolver = RootfsResolver{rootDir};
+    parallel::forEachIndex(
+        entriesToCompute.size(),
+        [&](size_t j) {
+            auto i = entriesToCompute[j];
+            const auto *previous =
+                previousEntries[i] ? &*previousEntries[i] : nullptr;
+            entries[i] = computeEntry(libs[i], previous, rootfsResolver);
+        },
+        numberOfThreads);
+
+    for (auto i : entriesToCompute) {
+        updatedEntries[libs[i]] = entries[i];
+    }
+    modified = true;
+
+    return entries;
+}
+
+/**
+ * Returns the index entries of the libraries listed in the dynamic linker's
+ * cache of the root directory (see sharedlibs::getListFromDynamicLinker).
+ * As long as the dynamic linker's cache is unchanged, the list of libraries is
+ * taken from the index as well.
+ */
+std::vector<SharedLibIndex::Entry> SharedLibIndex::getEntriesFromDynamicLinker(
+    const boost::filesystem::path &ldconfigPath,
+    unsigned int numberOfThreads) {
+    if (!dynamicLinkerLibs) {
+        dynamicLinkerLibs =
+            sharedlibs::getListFromDynamicLinker(ldconfigPath, rootDir);
+        modified = true;
+    }
+    return getEntries(*dynamicLinkerLibs, numberOfThreads);
+}
+
+/**
+ * Writes the index file, if any entry was updated. When the symlinks of the
+ * root directory may have changed, only the entries resolved by this object
+ * are written, which also drops the entries of libraries no longer in use.
+ */
+void SharedLibIndex::save() {
+    if (!modified) {
+        return;
+    }
+
+    auto entries = std::vector<Entry>{};
+    if (!linksMayHaveChanged) {
+        for (auto &entry : readMappedEntries()) {
+            if (updatedEntries.find(entry.path) == updatedEntries.cend()) {
+                entries.push_back(std::move(entry));
+            }
+        }
+    }
+    for (const auto &updatedEntry : updatedEntries) {
+        entries.push_back(updatedEntry.second);
+    }
+    std::sort(entries.begin(), entries.end(),
+              [](const Entry &lhs, const Entry &rhs) {
+                  return lhs.path.string() < rhs.path.string();
+              });
+
+    auto strings = std::string{};
+    auto stringOffsets = std::unordered_map<std::string, uint32_t>{};
+    auto addString = [&](const std::string &s) {
+        auto it = stringOffsets.find(s);
+        if (it != stringOffsets.cend()) {
+            return it->second;
+        }
+        auto offset = static_cast<uint32_t>(strings.size());
+        strings.append(s);
+        strings.push_back('\0');
+        stringOffsets.emplace(s, offset);
+        return offset;
+    };
+
+    auto header = Header{};
+    std::memcpy(header.magic, magic, sizeof(header.magic));
+    header.version = version;
+    header.rootDir = addString(rootDir.string());
+    header.entryCount = entries.size();
+
+    auto records = std::vector<EntryRecord>{};
+    records.reserve(entries.size());
+    for (const auto &entry : entries) {
+        auto record = EntryRecord{};
+        record.path = addString(entry.path.string());
+        record.realPath = addString(entry.realPath.string());
+        record.linkerName = addString(entry.linkerName.string());
+        record.soname = entry.soname ? addString(*entry.soname) : noString;
+        record.abi = entry.abi.empty()
+                         ? noString
+                         : addString(boost::algorithm::join(entry.abi, "."));
+        record.machine = entry.machine;
+        record.elfClass = entry.elfClass;
+        record.stamp = entry.stamp;
+        records.push_back(record);
+    }
+
+    auto dynamicLinkerLibIndices = std::vector<uint32_t>{};
+    if (dynamicLinkerCacheStamp) {
+        header.flags |= flagHasDynamicLinkerCacheStamp;
+        header.dynamicLinkerCacheStamp = *dynamicLinkerCacheStamp;
+    }
+    if (dynamicLinkerCacheStamp && dynamicLinkerLibs) {
+        auto isComplete = true;
+        for (const auto &lib : *dynamicLinkerLibs) {
+            auto it = std::lower_bound(
+                entries.cbegin(), entries.cend(), lib.string(),
+                [](const Entry &entry, const std::string &path) {
+                    return entry.path.string() < path;
+                });
+            if (it == entries.cend() || it->path != lib) {
+                isComplete = false;
+                break;
+            }
+            dynamicLinkerLibIndices.push_back(it - entries.cbegin());
+        }
+        if (isComplete) {
+            header.flags |= flagHasDynamicLinkerLibs;
+        } else {
+            dynamicLinkerLibIndices.clear();
+        }
+    }
+    header.dynamicLinkerLibCount = dynamicLinkerLibIndices.size();
+    header.stringsSize = strings.size();
+
+    // Write to a temporary file first, so that the index file is replaced
+    // atomically
+    auto temporaryFile = boost::filesystem::path{};
+    try {
+        filesystem::createFoldersIfNecessary(indexFile.parent_path());
+        temporaryFile = filesystem::createUniqueFile(indexFile, 0666).path;
+        auto ofs = std::ofstream{temporaryFile.string(), std::ios::binary};
+        ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        ofs.write(reinterpret_cast<const char *>(records.data()),
+                  records.size() * sizeof(EntryRecord));
+        ofs.write(
+            reinterpret_cast<const char *>(dynamicLinkerLibIndices.data()),
+            dynamicLinkerLibIndices.size() * sizeof(uint32_t));
+        ofs.write(strings.data(), strings.size());
+        ofs.close();
+        if (!ofs) {
+            auto message =
+                boost::format("Failed to write %s") % temporaryFile;
+            SARUS_THROW_ERROR(message.str());
+        }
+        boost::filesystem::rename(temporaryFile, indexFile);
+    } catch (const std::exception &e) {
+        boost::system::error_code ec;
+        boost::filesystem::remove(temporaryFile, ec);
+        auto message =
+            boost::format("Failed to save shared library index %s") %
+            indexFile;
+        SARUS_RETHROW_ERROR(e, message.str());
+    }
+
+    modified = false;
+}
+
+boost::optional<SharedLibIndex::Entry> SharedLibIndex::findMappedEntry(
+    const boost::filesystem::path &lib) const {
+    if (!mappedIndex) {
+        return {};
+    }
+
+    auto reader = IndexReader{*mappedIndex};
+    const auto &key = lib.string();
+
+    // binary search on the entry records, which are sorted by path
+    uint64_t begin = 0, end = reader.getEntryCount();
+    while (begin < end) {
+        auto middle = begin + (end - begin) / 2;
+        auto record = reader.getEntryRecord(middle);
+        auto comparison =
+            std::strcmp(reader.getString(record.path), key.c_str());
+        if (comparison == 0) {
+            return convertRecordToEntry(reader, record);
+        } else if (comparison < 0) {
+            begin = middle + 1;
+        } else {
+            end = middle;
+        }
+    }
+    return {};
+}
+
+std::vector<SharedLibIndex::Entry> SharedLibIndex::readMappedEntries() const {
+    auto entries = std::vector<Entry>{};
+    if (!mappedIndex) {
+        return entries;
+    }
+    auto reader = IndexReader{*mappedIndex};
+    entries.reserve(reader.getEntryCount());
+    for (uint64_t i = 0; i < reader.getEntryCount(); ++i) {
+        entries.push_back(
+            convertRecordToEntry(reader, reader.getEntryRecord(i)));
+    }
+    return entries;
+}
+
+SharedLibIndex::Entry SharedLibIndex::computeEntry(
+    const boost::filesystem::path &lib, const Entry *previous,
+    RootfsResolver &rootfsResolver) const {
+    auto entry = Entry{};
+    entry.path = lib;
+    entry.linkerName = sharedlibs::getLinkerName(lib);
+    entry.abi = sharedlibs::resolveAbi(lib, rootfsResolver);
+    entry.realPath = rootfsResolver.resolve(lib);
+
+    auto stamp = getFileStamp(rootDir / entry.realPath);
+    if (!stamp) {
+        auto message =
+            boost::format("Failed to index shared library %s: stat of %s "
+                          "failed: %s") %
+            lib % (rootDir / entry.realPath) % strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
+    entry.stamp = *stamp;
+
+    // the library's file is unchanged, only the links may have changed
+    if (previous && previous->realPath == entry.realPath &&
+        previous->stamp == entry.stamp) {
+        entry.soname = previous->soname;
+        entry.elfClass = previous->elfClass;
+        entry.machine = previous->machine;
+        return entry;
+    }
+
+    auto info = elf::readInfo(rootDir / entry.realPath);
+    entry.soname = std::move(info.soname);
+    entry.elfClass = info.elfClass;
+    entry.machine = info.machine;
+    return entry;
+}
+
+}  // namespace libsarus
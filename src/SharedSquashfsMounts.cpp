@@ -0,0 +1,399 @@
+/*
+ * Sarus
+ *
+ * Copyright (c) 2018-2023, ETH Zurich. All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+#include "libsarus/SharedSquashfsMounts.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+
+#include <boost/format.hpp>
+#include <boost/optional.hpp>
+
+#include "libsarus/Error.hpp"
+#include "libsarus/FileDescriptor.hpp"
+#include "libsarus/Flock.hpp"
+#include "libsarus/utility/filesystem.hpp"
+#include "libsarus/utility/logging.hpp"
+#include "libsarus/utility/mount.hpp"
+
+namespace libsarus {
+
+// The state file is locked briefly by every acquisition and release, which
+// may happen at once for all the containers of a job: retry more often than
+// Flock does by default
+static const auto lockPollInterval = milliseconds{10};
+
+// Returns "<pid>:<start time>" for a running process, which identifies the
+// process also after its pid is reused, or none if the process doesn't exist
+static boost::optional<std::string> getOwnerIdentifier(pid_t pid) {
+    auto statFile = boost::filesystem::path{"/proc"} / std::to_string(pid) /
+                    "stat";
+    auto stat = filesystem::readFile(statFile);  // empty if no such process
+
+    // the command name in the second field may contain spaces and brackets,
+    // the start time is the 20th field after it (see proc(5))
+    auto position = stat.rfind(')');
+    if (position == std::string::npos) {
+        return boost::none;
+    }
+    auto fields = std::istringstream{stat.substr(position + 1)};
+    auto field = std::string{};
+    for (int i = 0; i < 20 && fields >> field; ++i) {
+    }
+    if (!fields) {
+        return boost::none;
+    }
+    return std::to_string(pid) + ":" + field;
+}
+
+// Returns whether the owner identified by 'identifier' terminated
+static bool isOwnerTerminated(const std::string &identifier) {
+    auto pid = pid_t{};
+    try {
+        pid = std::stoi(identifier.substr(0, identifier.find(':')));
+    } catch (const std::exception &) {
+        return true;  // garbled identifier
+    }
+    auto current = getOwnerIdentifier(pid);
+    return !current || *current != identifier;
+}
+
+// Returns the identifier of the mount namespace of the calling process, i.e.
+// the inode of /proc/self/ns/mnt
+static std::string getMountNamespace() {
+    struct stat sb;
+    if (stat("/proc/self/ns/mnt", &sb) != 0) {
+        auto message = boost::format("Failed to stat /proc/self/ns/mnt: %s") %
+                       strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
+    return std::to_string(sb.st_ino);
+}
+
+// Opens the mount point without following symlinks, so that a mount cannot be
+// redirected outside of the cache directory
+static FileDescriptor openMountPoint(
+    const boost::filesystem::path &mountPoint) {
+    auto flags = O_PATH | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC;
+    auto fd = FileDescriptor{open(mountPoint.c_str(), flags)};
+    if (!fd.isValid()) {
+        auto message = boost::format("Failed to open mount point %s: %s") %
+                       mountPoint % strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
+    return fd;
+}
+
+static boost::filesystem::path getProcPath(const FileDescriptor &fd) {
+    return boost::filesystem::path{"/proc/self/fd"} / std::to_string(fd.get());
+}
+
+// Creates the cache directory, if needed, and checks that only root can
+// modify it, as root mounts the images on its subdirectories
+static void createCacheDirectory(const boost::filesystem::path &cacheDir) {
+    filesystem::createFoldersIfNecessary(cacheDir.parent_path());
+    if (mkdir(cacheDir.c_str(), S_IRWXU) != 0 && errno != EEXIST) {
+        auto message =
+            boost::format("Failed to create cache directory %s: %s") %
+            cacheDir % strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
+
+    struct stat sb;
+    if (lstat(cacheDir.c_str(), &sb) != 0) {
+        auto message = boost::format("Failed to stat cache directory %s: %s") %
+                       cacheDir % strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
+    if (!S_ISDIR(sb.st_mode) || sb.st_uid != 0 ||
+        (sb.st_mode & (S_IWGRP | S_IWOTH)) != 0) {
+        auto message = boost::format("Refusing to use %s as cache directory of "
+                                     "shared squashfs mounts: it must be a "
+                                     "directory owned by root and not "
+                                     "writable by group or others") %
+                       cacheDir;
+        SARUS_THROW_ERROR(message.str());
+    }
+}
+
+SharedSquashfsMounts::SharedSquashfsMounts(
+    const boost::filesystem::path &cacheDir)
+    : cacheDir{cacheDir},
+      stateFile{cacheDir / "references"},
+      lockFile{cacheDir / "references.lock"} {
+    createCacheDirectory(cacheDir);
+    filesystem::createFileIfNecessary(lockFile);
+}
+
+/**
+ * Returns the shared mount point of the image, loop mounting the image if it
+ * isn't mounted yet, and adds a reference of the owner process to it.
+ */
+boost::filesystem::path SharedSquashfsMounts::acquire(
+    const boost::filesystem::path &image, pid_t owner) {
+    auto mountPoint = getMountPoint(image);
+    auto ownerIdentifier = getOwnerIdentifier(owner);
+    if (!ownerIdentifier) {
+        auto message = boost::format("Failed to acquire shared mount of %s: "
+                                     "owner process %d doesn't exist") %
+                       image % owner;
+        SARUS_THROW_ERROR(message.str());
+    }
+
+    auto lock = lockReferences(Flock::Type::writeLock);
+    auto mountNamespace = getMountNamespace();
+    auto references = readReferences();
+    dropStaleReferences(references, mountNamespace);
+
+    if (!isMounted(mountPoint)) {
+        logMessage(boost::format("Loop mounting %s on shared mount point %s") %
+                       image % mountPoint,
+                   LogLevel::DEBUG);
+        try {
+            if (mkdir(mountPoint.c_str(), S_IRWXU) != 0 && errno != EEXIST) {
+                auto message =
+                    boost::format("Failed to create mount point %s: %s") %
+                    mountPoint % strerror(errno);
+                SARUS_THROW_ERROR(message.str());
+            }
+            mount::loopMountSquashfs(image,
+                                     getProcPath(openMountPoint(mountPoint)));
+        } catch (Error &e) {
+            unmount(mountPoint.filename().string(), mountNamespace,
+                    references, mountNamespace);
+            writeReferences(references);
+            auto message =
+                boost::format("Failed to acquire shared mount of %s") % image;
+            SARUS_RETHROW_ERROR(e, message.str());
+        }
+    } else {
+        logMessage(boost::format("Reusing shared mount point %s of %s") %
+                       mountPoint % image,
+                   LogLevel::DEBUG);
+    }
+
+    references[{mountNamespace, mountPoint.filename().string()}].push_back(
+        *ownerIdentifier);
+    writeReferences(references);
+    return mountPoint;
+}
+
+/**
+ * Removes a reference of the owner process to the shared mount point. The
+ * mount point is lazily unmounted when its last reference is removed.
+ */
+void SharedSquashfsMounts::release(const boost::filesystem::path &mountPoint,
+                                   pid_t owner) {
+    auto lock = lockReferences(Flock::Type::writeLock);
+    auto mountNamespace = getMountNamespace();
+    auto references = readReferences();
+
+    auto key = References::key_type{mountNamespace,
+                                    mountPoint.filename().string()};
+    auto ownerIdentifier = getOwnerIdentifier(owner);
+    auto it = references.find(key);
+    auto isReferenced =
+        ownerIdentifier && it != references.end() &&
+        std::find(it->second.cbegin(), it->second.cend(), *ownerIdentifier) !=
+            it->second.cend();
+    if (isReferenced) {
+        auto &owners = it->second;
+        owners.erase(std::find(owners.begin(), owners.end(), *ownerIdentifier));
+        if (owners.empty()) {
+            references.erase(it);
+            unmount(key.second, key.first, references, mountNamespace);
+        }
+    }
+    dropStaleReferences(references, mountNamespace);
+    writeReferences(references);
+
+    if (!isReferenced) {
+        auto message = boost::format("Failed to release shared mount point %s:"
+                                     " process %d holds no reference to it") %
+                       mountPoint % owner;
+        SARUS_THROW_ERROR(message.str());
+    }
+}
+
+/**
+ * Bind mounts the shared mount of the image on the destination, acquiring a
+ * reference to it, and returns the shared mount point, which is later passed
+ * to release.
+ */
+boost::filesystem::path SharedSquashfsMounts::bindMount(
+    const boost::filesystem::path &image,
+    const boost::filesystem::path &destination, unsigned long flags,
+    pid_t owner) {
+    auto mountPoint = acquire(image, owner);
+    try {
+        mount::bindMount(getProcPath(openMountPoint(mountPoint)), destination,
+                         flags);
+    } catch (Error &e) {
+        release(mountPoint, owner);
+        auto message = boost::format("Failed to bind mount shared mount of %s "
+                                     "on %s") %
+                       image % destination;
+        SARUS_RETHROW_ERROR(e, message.str());
+    }
+    return mountPoint;
+}
+
+/**
+ * Returns the shared mount point of the image. Modifying or replacing the
+ * image changes its mount point, so that containers started afterwards don't
+ * see the stale content.
+ */
+boost::filesystem::path SharedSquashfsMounts::getMountPoint(
+    const boost::filesystem::path &image) const {
+    struct stat sb;
+    if (stat(image.c_str(), &sb) != 0) {
+        auto message =
+            boost::format("Failed to stat %s: %s") % image % strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
+    auto key = boost::format("%x-%x-%d.%09d") % sb.st_dev % sb.st_ino %
+               sb.st_mtim.tv_sec % sb.st_mtim.tv_nsec;
+    return cacheDir / key.str();
+}
+
+size_t SharedSquashfsMounts::getNumberOfReferences(
+    const boost::filesystem::path &mountPoint) const {
+    auto lock = lockReferences(Flock::Type::readLock);
+    auto references = readReferences();
+    auto it = references.find(
+        {getMountNamespace(), mountPoint.filename().string()});
+    return it != references.cend() ? it->second.size() : 0;
+}
+
+Flock SharedSquashfsMounts::lockReferences(Flock::Type type) const {
+    return Flock{lockFile, type, Flock::noTimeout, milliseconds{1000},
+                 lockPollInterval};
+}
+
+// Reads the state file, which has a line per shared mount: the mount namespace
+// of the mount, the name of the mount point and the identifiers of the owners
+// of its references
+SharedSquashfsMounts::References SharedSquashfsMounts::readReferences() const {
+    auto references = References{};
+    if (!boost::filesystem::exists(stateFile)) {
+        return references;
+    }
+    auto lines = std::istringstream{filesystem::readFile(stateFile)};
+    auto line = std::string{};
+    while (std::getline(lines, line)) {
+        auto fields = std::istringstream{line};
+        auto key = References::key_type{};
+        auto owner = std::string{};
+        if (!(fields >> key.first >> key.second)) {
+            continue;
+        }
+        auto &owners = references[key];
+        while (fields >> owner) {
+            owners.push_back(owner);
+        }
+    }
+    return references;
+}
+
+void SharedSquashfsMounts::writeReferences(
+    const References &references) const {
+    auto state = std::string{};
+    for (const auto &entry : references) {
+        state += entry.first.first + " " + entry.first.second;
+        for (const auto &owner : entry.second) {
+            state += " " + owner;
+        }
+        state += "\n";
+    }
+    // not durable: the mounts don't survive a reboot either
+    filesystem::writeTextFileAtomically(state, stateFile, false);
+}
+
+// Drops the references of terminated owners, unmounting the mounts left
+// without references, and forgets the mounts of the current mount namespace
+// which are no longer mounted (e.g. after a reboot). The mounts of other
+// namespaces are not visible here, hence they are only dropped with their
+// owners.
+void SharedSquashfsMounts::dropStaleReferences(
+    References &references, const std::string &mountNamespace) const {
+    for (auto it = references.begin(); it != references.end();) {
+        auto &owners = it->second;
+        owners.erase(
+            std::remove_if(owners.begin(), owners.end(), isOwnerTerminated),
+            owners.end());
+
+        auto key = it->first;
+        auto mountPoint = cacheDir / key.second;
+        if (owners.empty() ||
+            (key.first == mountNamespace && !isMounted(mountPoint))) {
+            logMessage(boost::format("Dropping stale references to shared "
+                                     "mount point %s") %
+                           mountPoint,
+                       LogLevel::DEBUG);
+            it = references.erase(it);
+            unmount(key.second, key.first, references, mountNamespace);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool SharedSquashfsMounts::isMounted(
+    const boost::filesystem::path &mountPoint) const {
+    struct stat mountPointStat, cacheDirStat;
+    if (lstat(mountPoint.c_str(), &mountPointStat) != 0 ||
+        lstat(cacheDir.c_str(), &cacheDirStat) != 0) {
+        return false;
+    }
+    return mountPointStat.st_dev != cacheDirStat.st_dev;
+}
+
+// Detaches the mount from the mount point, if the mount was performed in the
+// current mount namespace, and removes the mount point unless the mounts of
+// other namespaces still use it (removing it would detach them). The
+// filesystem is unmounted, and the loop device detached, once the mount is no
+// longer busy.
+void SharedSquashfsMounts::unmount(const std::string &mountPointName,
+                                   const std::string &mountNamespaceOfMount,
+                                   const References &references,
+                                   const std::string &mountNamespace) const {
+    auto mountPoint = cacheDir / mountPointName;
+    if (mountNamespaceOfMount == mountNamespace && isMounted(mountPoint)) {
+        logMessage(boost::format("Lazily unmounting shared mount point %s") %
+                       mountPoint,
+                   LogLevel::DEBUG);
+        if (umount2(mountPoint.c_str(), MNT_DETACH | UMOUNT_NOFOLLOW) != 0) {
+            auto message = boost::format("Failed to unmount %s: %s") %
+                           mountPoint % strerror(errno);
+            SARUS_THROW_ERROR(message.str());
+        }
+    }
+    auto isUsed = std::any_of(
+        references.cbegin(), references.cend(),
+        [&](const References::value_type &entry) {
+            return entry.first.second == mountPointName;
+        });
+    if (isUsed) {
+        return;
+    }
+    if (rmdir(mountPoint.c_str()) != 0 && errno != ENOENT) {
+        logMessage(boost::format("Failed to remove shared mount point %s: %s") %
+                       mountPoint % strerror(errno),
+                   LogLevel::WARN);
+    }
+}
+
+}  // namespace libsarus
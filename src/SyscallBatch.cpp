@@ -0,0 +1,310 @@
+/*
+ * Sarus
+ *
+ * Copyright (c) 2018-2023, ETH Zurich. All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+#include "libsarus/SyscallBatch.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <boost/format.hpp>
+
+#include "libsarus/Error.hpp"
+#include "libsarus/utility/logging.hpp"
+
+namespace libsarus {
+
+SyscallBatch::SyscallBatch(unsigned int queueDepth, bool useIoUring)
+    : queueDepth{queueDepth}, isRingRequested{useIoUring} {}
+
+SyscallBatch::~SyscallBatch() {
+    if (submissionEntries) {
+        munmap(submissionEntries, submissionEntriesSize);
+    }
+    if (completionRing && completionRing != submissionRing) {
+        munmap(completionRing, completionRingSize);
+    }
+    if (submissionRing) {
+        munmap(submissionRing, submissionRingSize);
+    }
+}
+
+size_t SyscallBatch::statx(int dirFd, const std::string &path, int flags,
+                           unsigned int mask, struct statx *buffer) {
+    return enqueue(Operation::statx, dirFd, &path, flags, mask,
+                   reinterpret_cast<uint64_t>(buffer));
+}
+
+size_t SyscallBatch::openat(int dirFd, const std::string &path, int flags,
+                            mode_t mode) {
+    return enqueue(Operation::openat, dirFd, &path, flags, mode);
+}
+
+size_t SyscallBatch::mkdirat(int dirFd, const std::string &path, mode_t mode) {
+    return enqueue(Operation::mkdirat, dirFd, &path, 0, mode);
+}
+
+size_t SyscallBatch::unlinkat(int dirFd, const std::string &path, int flags) {
+    return enqueue(Operation::unlinkat, dirFd, &path, flags);
+}
+
+size_t SyscallBatch::fchownat(int dirFd, const std::string &path, uid_t uid,
+                              gid_t gid, int flags) {
+    return enqueue(Operation::fchownat, dirFd, &path, flags, uid, gid);
+}
+
+size_t SyscallBatch::close(int fd) {
+    return enqueue(Operation::close, fd, nullptr, 0);
+}
+
+/**
+ * Executes the queued calls. Afterwards, getResult returns the result of each
+ * call as returned by the system call, or -errno if the call failed.
+ */
+void SyscallBatch::submit() {
+    results.assign(calls.size(), 0);
+    if (isRingRequested && calls.size() >= minimumRingBatchSize) {
+        isRingRequested = false;  // set up at most once
+        setUpRing();
+    }
+
+    auto ringCalls = std::vector<size_t>{};
+    for (size_t i = 0; i < calls.size(); ++i) {
+        if (isUsingIoUring() && isSupportedByRing(calls[i].operation)) {
+            ringCalls.push_back(i);
+        } else {
+            results[i] = execute(calls[i]);
+        }
+    }
+
+    for (size_t begin = 0; begin < ringCalls.size(); begin += ringEntries) {
+        auto end = std::min<size_t>(begin + ringEntries, ringCalls.size());
+        submitToRing({ringCalls.cbegin() + begin, ringCalls.cbegin() + end});
+    }
+}
+
+/**
+ * Drops the queued calls and their results.
+ */
+void SyscallBatch::clear() {
+    paths.clear();
+    calls.clear();
+    results.clear();
+}
+
+size_t SyscallBatch::enqueue(Operation operation, int fd,
+                             const std::string *path, int flags,
+                             uint64_t argument0, uint64_t argument1) {
+    const char *pathCopy = nullptr;
+    if (path) {
+        paths.push_back(*path);
+        pathCopy = paths.back().c_str();
+    }
+    calls.push_back(Call{operation, fd, pathCopy, flags, argument0, argument1});
+    return calls.size() - 1;
+}
+
+void SyscallBatch::setUpRing() {
+    auto params = io_uring_params{};
+    auto fd = syscall(__NR_io_uring_setup, queueDepth, &params);
+    if (fd < 0) {
+        logMessage(boost::format("io_uring is not available (%s): executing "
+                                 "system calls synchronously") %
+                       strerror(errno),
+                   LogLevel::DEBUG);
+        return;
+    }
+    auto ringFd = FileDescriptor{static_cast<int>(fd)};
+
+    // the operations were added in different kernel versions
+    auto probe = std::vector<char>(sizeof(io_uring_probe) +
+                                   256 * sizeof(io_uring_probe_op));
+    auto *probeHeader = reinterpret_cast<io_uring_probe *>(probe.data());
+    if (syscall(__NR_io_uring_register, ringFd.get(), IORING_REGISTER_PROBE,
+                probeHeader, 256) != 0) {
+        logMessage(boost::format("Failed to probe io_uring operations (%s): "
+                                 "executing system calls synchronously") %
+                       strerror(errno),
+                   LogLevel::DEBUG);
+        return;
+    }
+    auto isSupported = [probeHeader](unsigned int opcode) {
+        return opcode <= probeHeader->last_op &&
+               (probeHeader->ops[opcode].flags & IO_URING_OP_SUPPORTED);
+    };
+    supportedOperations = {
+        isSupported(IORING_OP_STATX),    isSupported(IORING_OP_OPENAT),
+        isSupported(IORING_OP_MKDIRAT),  isSupported(IORING_OP_UNLINKAT),
+        false /* fchownat */,            isSupported(IORING_OP_CLOSE)};
+
+    submissionRingSize =
+        params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    completionRingSize =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    auto isSingleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (isSingleMmap) {
+        submissionRingSize = completionRingSize =
+            std::max(submissionRingSize, completionRingSize);
+    }
+    submissionEntriesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+    auto map = [&ringFd](size_t size, off_t offset) -> void * {
+        auto *p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ringFd.get(), offset);
+        return p == MAP_FAILED ? nullptr : p;
+    };
+    submissionRing = map(submissionRingSize, IORING_OFF_SQ_RING);
+    completionRing = isSingleMmap ? submissionRing
+                                  : map(completionRingSize, IORING_OFF_CQ_RING);
+    submissionEntries = static_cast<io_uring_sqe *>(
+        map(submissionEntriesSize, IORING_OFF_SQES));
+    if (!submissionRing || !completionRing || !submissionEntries) {
+        logMessage(boost::format("Failed to map io_uring (%s): executing "
+                                 "system calls synchronously") %
+                       strerror(errno),
+                   LogLevel::DEBUG);
+        return;  // the destructor unmaps the rings mapped so far
+    }
+
+    ringEntries = params.sq_entries;
+    submissionTail = params.sq_off.tail;
+    submissionMask = params.sq_off.ring_mask;
+    submissionArray = params.sq_off.array;
+    completionHead = params.cq_off.head;
+    completionTail = params.cq_off.tail;
+    completionMask = params.cq_off.ring_mask;
+    completionEntries = params.cq_off.cqes;
+    ring = std::move(ringFd);
+}
+
+bool SyscallBatch::isSupportedByRing(Operation operation) const {
+    return supportedOperations[static_cast<size_t>(operation)];
+}
+
+void SyscallBatch::prepare(io_uring_sqe &sqe, const Call &call,
+                           size_t index) const {
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.fd = call.fd;
+    sqe.addr = reinterpret_cast<uint64_t>(call.path);
+    sqe.user_data = index;
+    switch (call.operation) {
+    case Operation::statx:
+        sqe.opcode = IORING_OP_STATX;
+        sqe.len = call.argument0;
+        sqe.off = call.argument1;
+        sqe.statx_flags = call.flags;
+        break;
+    case Operation::openat:
+        sqe.opcode = IORING_OP_OPENAT;
+        sqe.len = call.argument0;
+        sqe.open_flags = call.flags;
+        break;
+    case Operation::mkdirat:
+        sqe.opcode = IORING_OP_MKDIRAT;
+        sqe.len = call.argument0;
+        break;
+    case Operation::unlinkat:
+        sqe.opcode = IORING_OP_UNLINKAT;
+        sqe.unlink_flags = call.flags;
+        break;
+    case Operation::close:
+        sqe.opcode = IORING_OP_CLOSE;
+        break;
+    case Operation::fchownat:
+        assert(false);  // not supported by io_uring
+        break;
+    }
+}
+
+// Submits the calls with the given indices, at most as many as the entries
+// of the submission queue, and waits for their completion
+void SyscallBatch::submitToRing(const std::vector<size_t> &indices) {
+    auto *sq = static_cast<char *>(submissionRing);
+    auto *cq = static_cast<char *>(completionRing);
+    auto *sqTail = reinterpret_cast<unsigned int *>(sq + submissionTail);
+    auto sqMask = *reinterpret_cast<unsigned int *>(sq + submissionMask);
+    auto *sqArray = reinterpret_cast<unsigned int *>(sq + submissionArray);
+    auto *cqHead = reinterpret_cast<unsigned int *>(cq + completionHead);
+    auto *cqTail = reinterpret_cast<unsigned int *>(cq + completionTail);
+    auto cqMask = *reinterpret_cast<unsigned int *>(cq + completionMask);
+    auto *cqes = reinterpret_cast<io_uring_cqe *>(cq + completionEntries);
+
+    auto tail = *sqTail;
+    for (auto index : indices) {
+        auto slot = tail & sqMask;
+        prepare(submissionEntries[slot], calls[index], index);
+        sqArray[slot] = slot;
+        ++tail;
+    }
+    __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+
+    size_t submitted = 0;
+    size_t completed = 0;
+    while (completed < indices.size()) {
+        auto result = syscall(__NR_io_uring_enter, ring.get(),
+                              indices.size() - submitted,
+                              indices.size() - completed,
+                              IORING_ENTER_GETEVENTS, nullptr, 0);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result < 0) {
+            auto message = boost::format("Failed to submit system calls to "
+                                         "io_uring: %s") %
+                           strerror(errno);
+            SARUS_THROW_ERROR(message.str());
+        }
+        submitted += result;
+
+        auto head = *cqHead;
+        auto cqTailValue = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        for (; head != cqTailValue; ++head) {
+            const auto &cqe = cqes[head & cqMask];
+            results[cqe.user_data] = cqe.res;
+            ++completed;
+        }
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+    }
+}
+
+int SyscallBatch::execute(const Call &call) const {
+    auto result = 0;
+    switch (call.operation) {
+    case Operation::statx:
+        result = ::statx(call.fd, call.path, call.flags, call.argument0,
+                         reinterpret_cast<struct statx *>(call.argument1));
+        break;
+    case Operation::openat:
+        result = ::openat(call.fd, call.path, call.flags, call.argument0);
+        break;
+    case Operation::mkdirat:
+        result = ::mkdirat(call.fd, call.path, call.argument0);
+        break;
+    case Operation::unlinkat:
+        result = ::unlinkat(call.fd, call.path, call.flags);
+        break;
+    case Operation::fchownat:
+        result = ::fchownat(call.fd, call.path, call.argument0, call.argument1,
+                            call.flags);
+        break;
+    case Operation::close:
+        result = ::close(call.fd);
+        break;
+    }
+    return result < 0 ? -errno : result;
+}
+
+}  // namespace libsarus
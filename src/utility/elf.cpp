@@ -0,0 +1,367 @@
+/*
+ * Sarus
+ *
+ * Copyright (c) 2018-2023, ETH Zurich. All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+#include "libsarus/utility/elf.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/endian/conversion.hpp>
+#include <boost/format.hpp>
+
+#include "libsarus/Error.hpp"
+#include "libsarus/MappedFile.hpp"
+
+/**
+ * Utility functions for reading ELF files
+ *
+ * The reader maps the file in memory and only looks at the ELF header, the
+ * program headers and the dynamic segment (plus the structures referenced by
+ * it), i.e. the same data the dynamic linker uses. Section headers are not
+ * needed, so stripped libraries are handled as well.
+ */
+
+namespace libsarus {
+namespace elf {
+
+namespace {
+
+struct Elf32Types {
+    using Ehdr = Elf32_Ehdr;
+    using Phdr = Elf32_Phdr;
+    using Dyn = Elf32_Dyn;
+};
+
+struct Elf64Types {
+    using Ehdr = Elf64_Ehdr;
+    using Phdr = Elf64_Phdr;
+    using Dyn = Elf64_Dyn;
+};
+
+// Bounds-checked accessor to the mapped file which takes care of converting
+// from the file's byte order to the host's byte order
+class Reader {
+  public:
+    Reader(const MappedFile &file, const boost::filesystem::path &path,
+           bool swapBytes)
+        : file{file}, path{path}, swapBytes{swapBytes} {}
+
+    template <class T>
+    T get(T value) const {
+        return swapBytes ? boost::endian::endian_reverse(value) : value;
+    }
+
+    template <class T>
+    T read(uint64_t offset) const {
+        check(offset, sizeof(T));
+        T value;
+        std::memcpy(&value, file.data() + offset, sizeof(T));
+        return value;
+    }
+
+    std::string readString(uint64_t offset, uint64_t limit) const {
+        limit = std::min<uint64_t>(limit, file.size());
+        if (offset >= limit) {
+            throwMalformed("string table offset out of bounds");
+        }
+        const auto *begin =
+            reinterpret_cast<const char *>(file.data() + offset);
+        const auto *end =
+            static_cast<const char *>(std::memchr(begin, '\0', limit - offset));
+        if (end == nullptr) {
+            throwMalformed("unterminated string");
+        }
+        return std::string(begin, end);
+    }
+
+    void check(uint64_t offset, uint64_t size) const {
+        if (offset > file.size() || size > file.size() - offset) {
+            throwMalformed("offset out of bounds");
+        }
+    }
+
+    [[noreturn]] void throwMalformed(const std::string &reason) const {
+        auto message =
+            boost::format("Failed to parse ELF file %s: %s") % path % reason;
+        SARUS_THROW_ERROR(message.str());
+    }
+
+  private:
+    const MappedFile &file;
+    const boost::filesystem::path &path;
+    bool swapBytes;
+};
+
+struct LoadSegment {
+    uint64_t vaddr;
+    uint64_t offset;
+    uint64_t filesz;
+};
+
+}  // namespace
+
+static uint64_t convertVirtualAddressToFileOffset(
+    const Reader &reader, const std::vector<LoadSegment> &segments,
+    uint64_t address) {
+    for (const auto &segment : segments) {
+        if (address >= segment.vaddr &&
+            address < segment.vaddr + segment.filesz) {
+            return address - segment.vaddr + segment.offset;
+        }
+    }
+    reader.throwMalformed(
+        (boost::format("address 0x%x not within a loadable segment") % address)
+            .str());
+}
+
+static std::vector<std::string> splitSearchPath(const std::string &value) {
+    auto paths = std::vector<std::string>{};
+    boost::split(paths, value, boost::is_any_of(":"));
+    paths.erase(std::remove(paths.begin(), paths.end(), std::string{}),
+                paths.end());
+    return paths;
+}
+
+static std::vector<VersionRequirement> readVersionRequirements(
+    const Reader &reader, uint64_t offset, uint64_t count,
+    uint64_t stringTableOffset, uint64_t stringTableLimit) {
+    auto requirements = std::vector<VersionRequirement>{};
+
+    // Elf32_Verneed/Elf32_Vernaux have the same layout as their 64-bit
+    // counterparts
+    for (uint64_t i = 0; i < count; ++i) {
+        auto verneed = reader.read<Elf64_Verneed>(offset);
+        auto requirement = VersionRequirement{};
+        requirement.file =
+            reader.readString(stringTableOffset + reader.get(verneed.vn_file),
+                              stringTableLimit);
+
+        auto auxOffset = offset + reader.get(verneed.vn_aux);
+        for (uint16_t j = 0; j < reader.get(verneed.vn_cnt); ++j) {
+            auto vernaux = reader.read<Elf64_Vernaux>(auxOffset);
+            requirement.versions.push_back(reader.readString(
+                stringTableOffset + reader.get(vernaux.vna_name),
+                stringTableLimit));
+            if (vernaux.vna_next == 0) {
+                break;
+            }
+            auxOffset += reader.get(vernaux.vna_next);
+        }
+
+        requirements.push_back(std::move(requirement));
+        if (verneed.vn_next == 0) {
+            break;
+        }
+        offset += reader.get(verneed.vn_next);
+    }
+
+    return requirements;
+}
+
+static std::vector<std::string> readVersionDefinitions(
+    const Reader &reader, uint64_t offset, uint64_t count,
+    uint64_t stringTableOffset, uint64_t stringTableLimit) {
+    auto definitions = std::vector<std::string>{};
+
+    // Elf32_Verdef/Elf32_Verdaux have the same layout as their 64-bit
+    // counterparts
+    for (uint64_t i = 0; i < count; ++i) {
+        auto verdef = reader.read<Elf64_Verdef>(offset);
+
+        // the base definition is the name of the file itself (i.e. the
+        // SONAME), the first auxiliary entry of the others is the version
+        if (!(reader.get(verdef.vd_flags) & VER_FLG_BASE) &&
+            reader.get(verdef.vd_cnt) > 0) {
+            auto verdaux =
+                reader.read<Elf64_Verdaux>(offset + reader.get(verdef.vd_aux));
+            definitions.push_back(reader.readString(
+                stringTableOffset + reader.get(verdaux.vda_name),
+                stringTableLimit));
+        }
+
+        if (verdef.vd_next == 0) {
+            break;
+        }
+        offset += reader.get(verdef.vd_next);
+    }
+
+    return definitions;
+}
+
+template <class Types>
+static Info parseInfo(const Reader &reader, unsigned char elfClass) {
+    auto info = Info{};
+    info.elfClass = elfClass;
+
+    auto ehdr = reader.read<typename Types::Ehdr>(0);
+    info.type = reader.get(ehdr.e_type);
+    info.machine = reader.get(ehdr.e_machine);
+
+    uint64_t phoff = reader.get(ehdr.e_phoff);
+    uint64_t phnum = reader.get(ehdr.e_phnum);
+    uint64_t phentsize = reader.get(ehdr.e_phentsize);
+    if (phnum > 0 && phentsize < sizeof(typename Types::Phdr)) {
+        reader.throwMalformed("invalid program header size");
+    }
+
+    auto loadSegments = std::vector<LoadSegment>{};
+    bool hasDynamicSegment = false;
+    uint64_t dynOffset = 0, dynSize = 0;
+    for (uint64_t i = 0; i < phnum; ++i) {
+        auto phdr = reader.read<typename Types::Phdr>(phoff + i * phentsize);
+        auto type = reader.get(phdr.p_type);
+        if (type == PT_LOAD) {
+            loadSegments.push_back(LoadSegment{reader.get(phdr.p_vaddr),
+                                               reader.get(phdr.p_offset),
+                                               reader.get(phdr.p_filesz)});
+        } else if (type == PT_DYNAMIC) {
+            hasDynamicSegment = true;
+            dynOffset = reader.get(phdr.p_offset);
+            dynSize = reader.get(phdr.p_filesz);
+        }
+    }
+
+    // e.g. statically linked executables
+    if (!hasDynamicSegment) {
+        return info;
+    }
+
+    uint64_t strtab = 0, strsz = 0, verneed = 0, verneednum = 0;
+    uint64_t verdef = 0, verdefnum = 0;
+    auto soname = boost::optional<uint64_t>{};
+    auto needed = std::vector<uint64_t>{};
+    auto rpath = boost::optional<uint64_t>{};
+    auto runpath = boost::optional<uint64_t>{};
+
+    reader.check(dynOffset, dynSize);
+    for (uint64_t offset = dynOffset;
+         offset + sizeof(typename Types::Dyn) <= dynOffset + dynSize;
+         offset += sizeof(typename Types::Dyn)) {
+        auto dyn = reader.read<typename Types::Dyn>(offset);
+        int64_t tag = reader.get(dyn.d_tag);
+        uint64_t value = reader.get(dyn.d_un.d_val);
+        if (tag == DT_NULL) {
+            break;
+        }
+        switch (tag) {
+            case DT_STRTAB: strtab = value; break;
+            case DT_STRSZ: strsz = value; break;
+            case DT_SONAME: soname = value; break;
+            case DT_NEEDED: needed.push_back(value); break;
+            case DT_RPATH: rpath = value; break;
+            case DT_RUNPATH: runpath = value; break;
+            case DT_VERNEED: verneed = value; break;
+            case DT_VERNEEDNUM: verneednum = value; break;
+            case DT_VERDEF: verdef = value; break;
+            case DT_VERDEFNUM: verdefnum = value; break;
+        }
+    }
+
+    if (strtab == 0) {
+        return info;
+    }
+    auto strtabOffset =
+        convertVirtualAddressToFileOffset(reader, loadSegments, strtab);
+    auto strtabLimit = strtabOffset + strsz;
+
+    if (soname) {
+        info.soname = reader.readString(strtabOffset + *soname, strtabLimit);
+    }
+    for (auto value : needed) {
+        info.needed.push_back(
+            reader.readString(strtabOffset + value, strtabLimit));
+    }
+    if (rpath) {
+        info.rpath = splitSearchPath(
+            reader.readString(strtabOffset + *rpath, strtabLimit));
+    }
+    if (runpath) {
+        info.runpath = splitSearchPath(
+            reader.readString(strtabOffset + *runpath, strtabLimit));
+    }
+    if (verdef != 0) {
+        info.versionDefinitions = readVersionDefinitions(
+            reader,
+            convertVirtualAddressToFileOffset(reader, loadSegments, verdef),
+            verdefnum, strtabOffset, strtabLimit);
+    }
+    if (verneed != 0) {
+        info.versionRequirements = readVersionRequirements(
+            reader,
+            convertVirtualAddressToFileOffset(reader, loadSegments, verneed),
+            verneednum, strtabOffset, strtabLimit);
+    }
+
+    return info;
+}
+
+static bool hasElfMagic(const unsigned char *data, size_t size) {
+    return size >= EI_NIDENT && std::memcmp(data, ELFMAG, SELFMAG) == 0;
+}
+
+bool isElf(const boost::filesystem::path &file) {
+    auto fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    unsigned char ident[EI_NIDENT];
+    auto count = ::read(fd, ident, sizeof(ident));
+    close(fd);
+    return count > 0 && hasElfMagic(ident, count);
+}
+
+/**
+ * Reads in one pass the ELF metadata that is relevant for shared libraries
+ * handling, i.e. class, machine, SONAME, DT_NEEDED entries, RPATH/RUNPATH,
+ * the symbol version definitions (.gnu.version_d) and the symbol version
+ * requirements (.gnu.version_r).
+ */
+Info readInfo(const boost::filesystem::path &file) {
+    auto mappedFile = MappedFile{file};
+
+    if (!hasElfMagic(mappedFile.data(), mappedFile.size())) {
+        auto message =
+            boost::format("Failed to parse ELF file %s: not an ELF file") %
+            file;
+        SARUS_THROW_ERROR(message.str());
+    }
+
+    auto elfClass = mappedFile.data()[EI_CLASS];
+    auto elfData = mappedFile.data()[EI_DATA];
+    if (elfData != ELFDATA2LSB && elfData != ELFDATA2MSB) {
+        auto message = boost::format(
+                           "Failed to parse ELF file %s: invalid data "
+                           "encoding") %
+                       file;
+        SARUS_THROW_ERROR(message.str());
+    }
+
+    auto hostData = boost::endian::order::native == boost::endian::order::little
+                        ? ELFDATA2LSB
+                        : ELFDATA2MSB;
+    auto reader = Reader{mappedFile, file, elfData != hostData};
+
+    if (elfClass == ELFCLASS64) {
+        return parseInfo<Elf64Types>(reader, elfClass);
+    } else if (elfClass == ELFCLASS32) {
+        return parseInfo<Elf32Types>(reader, elfClass);
+    }
+
+    auto message =
+        boost::format("Failed to parse ELF file %s: invalid ELF class") % file;
+    SARUS_THROW_ERROR(message.str());
+}
+
+}  // namespace elf
+}  // namespace libsarus
@@ -10,16 +10,40 @@
 
 #include "libsarus/utility/filesystem.hpp"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <cinttypes>
+#include <cstring>
+#include <deque>
 #include <fstream>
+#include <functional>
+#include <future>
 
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#if __has_include(<linux/openat2.h>)
+#include <linux/openat2.h>
+#endif
 
 #include <boost/algorithm/string.hpp>
 #include <boost/format.hpp>
+#include <boost/optional.hpp>
 #include <boost/regex.hpp>
 
+#include "libsarus/DirectoryScanner.hpp"
 #include "libsarus/Error.hpp"
+#include "libsarus/FileView.hpp"
+#include "libsarus/RootfsResolver.hpp"
+#include "libsarus/SyscallBatch.hpp"
 #include "libsarus/utility/logging.hpp"
+#include "libsarus/utility/parallel.hpp"
 #include "libsarus/utility/string.hpp"
 
 /**
@@ -73,42 +97,147 @@ void setOwner(const boost::filesystem::path &path, uid_t uid, gid_t gid) {
     }
 }
 
+static FileDescriptor openAt(int dirFd, const boost::filesystem::path &path,
+                             int flags, const boost::filesystem::path &root,
+                             mode_t mode = 0) {
+    auto fd = FileDescriptor{openat(dirFd, path.c_str(), flags, mode)};
+    if (!fd.isValid()) {
+        auto message = boost::format("Failed to open %s: %s") %
+                       (root / path) % strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
+    return fd;
+}
+
+static void setOwnerAt(int dirFd, const boost::filesystem::path &path,
+                       uid_t uid, gid_t gid,
+                       const boost::filesystem::path &root) {
+    if (uid == static_cast<uid_t>(-1) || gid == static_cast<uid_t>(-1)) {
+        assert(uid == static_cast<uid_t>(-1) && gid == static_cast<gid_t>(-1));
+        return;
+    }
+    // an empty path refers to 'dirFd' itself
+    auto flags = path.empty() ? AT_EMPTY_PATH : AT_SYMLINK_NOFOLLOW;
+    if (fchownat(dirFd, path.c_str(), uid, gid, flags) != 0) {
+        auto message =
+            boost::format("Failed to change ownership of path %s: %s") %
+            (root / path) % strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
+}
+
+// Throws if one of the calls in 'batch', each on the entry 'names[i]' of the
+// directory 'dir', failed
+static void checkBatchResults(const SyscallBatch &batch,
+                              const std::vector<std::string> &names,
+                              const std::string &action,
+                              const boost::filesystem::path &dir) {
+    for (size_t i = 0; i < names.size(); ++i) {
+        auto result = batch.getResult(i);
+        if (result < 0) {
+            auto message = boost::format("Failed to %s %s: %s") % action %
+                           (dir / names[i]) % strerror(-result);
+            SARUS_THROW_ERROR(message.str());
+        }
+    }
+}
+
+// Returns the descriptor of the folder 'path', creating the folder and its
+// missing ancestors. The descriptors of the folders opened along the way are
+// kept in 'openedFolders', so that other folders with the same ancestors are
+// created without walking their paths again.
+static int openOrCreateFolder(const boost::filesystem::path &path, uid_t uid,
+                              gid_t gid, OpenedFolders &openedFolders) {
+    auto it = openedFolders.find(path);
+    if (it != openedFolders.cend()) {
+        return it->second.get();
+    }
+
+    auto flags = O_PATH | O_DIRECTORY | O_CLOEXEC;
+    auto fd = FileDescriptor{open(path.empty() ? "." : path.c_str(), flags)};
+    if (!fd.isValid()) {
+        if (errno != ENOENT || path.empty()) {
+            auto message = boost::format("Failed to create directory %s: %s") %
+                           path % strerror(errno);
+            SARUS_THROW_ERROR(message.str());
+        }
+
+        auto parent = path.parent_path();
+        auto parentFd = openOrCreateFolder(parent, uid, gid, openedFolders);
+        auto name = path.filename();
+        if (mkdirat(parentFd, name.c_str(), 0777) == 0) {
+            logMessage(boost::format{"Created directory %s"} % path,
+                       LogLevel::DEBUG);
+            setOwnerAt(parentFd, name, uid, gid, parent);
+        } else if (errno != EEXIST) {
+            auto message = boost::format("Failed to create directory %s: %s") %
+                           path % strerror(errno);
+            SARUS_THROW_ERROR(message.str());
+        }
+
+        // EEXIST means that another process concurrently created the same
+        // directory, or that the path is not a directory: opening it tells
+        fd.reset(openat(parentFd, name.c_str(), flags));
+        if (!fd.isValid()) {
+            auto message = boost::format("Failed to create directory %s: %s") %
+                           path % strerror(errno);
+            SARUS_THROW_ERROR(message.str());
+        }
+    }
+    return openedFolders.emplace(path, std::move(fd)).first->second.get();
+}
+
+/**
+ * Creates the folder 'path' and its missing ancestors, which are owned by
+ * 'uid' and 'gid' (if specified). The deepest existing ancestor is opened
+ * once, then the missing folders are created with mkdirat(2) relative to the
+ * descriptor of their parent.
+ */
 void createFoldersIfNecessary(const boost::filesystem::path &path, uid_t uid,
                               gid_t gid) {
-    auto currentPath = boost::filesystem::path("");
+    auto openedFolders = OpenedFolders{};
+    createFoldersIfNecessary(path, uid, gid, openedFolders);
+}
 
-    if (!boost::filesystem::exists(path)) {
-        logMessage(boost::format{"Creating directory %s"} % path,
-                   LogLevel::DEBUG);
+/**
+ * Creates multiple folders as the overload above. The folders are first
+ * probed with one batch of statx(2) calls, so that the folders which already
+ * exist cost no further system calls. The common ancestors of the missing
+ * folders are opened or created only once. The batch is submitted through
+ * io_uring only if 'useIoUring' is set (see SyscallBatch).
+ */
+void createFoldersIfNecessary(const std::vector<boost::filesystem::path> &paths,
+                              uid_t uid, gid_t gid, bool useIoUring) {
+    auto batch = SyscallBatch{SyscallBatch::defaultQueueDepth, useIoUring};
+    auto buffers = std::vector<struct statx>(paths.size());
+    for (size_t i = 0; i < paths.size(); ++i) {
+        batch.statx(AT_FDCWD, paths[i].string(), 0, STATX_TYPE, &buffers[i]);
     }
+    batch.submit();
 
-    for (const auto &element : path) {
-        currentPath /= element;
-        if (!boost::filesystem::exists(currentPath)) {
-            bool created = false;
-            try {
-                created = boost::filesystem::create_directory(currentPath);
-            } catch (const std::exception &e) {
-                auto message = boost::format("Failed to create directory %s") %
-                               currentPath;
-                SARUS_RETHROW_ERROR(e, message.str());
-            }
-            if (!created) {
-                // the creation might have failed because another process
-                // concurrently created the same directory. So check whether the
-                // directory was indeed created by another process.
-                if (!boost::filesystem::is_directory(currentPath)) {
-                    auto message =
-                        boost::format("Failed to create directory %s") %
-                        currentPath;
-                    SARUS_THROW_ERROR(message.str());
-                }
-            }
-            setOwner(currentPath, uid, gid);
+    auto openedFolders = OpenedFolders{};
+    for (size_t i = 0; i < paths.size(); ++i) {
+        if (batch.getResult(i) == 0 && S_ISDIR(buffers[i].stx_mode)) {
+            continue;
         }
+        createFoldersIfNecessary(paths[i], uid, gid, openedFolders);
     }
 }
 
+/**
+ * Creates a folder as the overloads above, reusing and extending the
+ * descriptors in 'openedFolders' across calls. The descriptors refer to the
+ * folders as they were when opened: the cache must not outlive changes of the
+ * tree such as mounts on top of the cached folders.
+ */
+void createFoldersIfNecessary(const boost::filesystem::path &path, uid_t uid,
+                              gid_t gid, OpenedFolders &openedFolders) {
+    if (path.empty()) {
+        return;
+    }
+    openOrCreateFolder(path, uid, gid, openedFolders);
+}
+
 void createFileIfNecessary(const boost::filesystem::path &path, uid_t uid,
                            gid_t gid) {
     // NOTE: Broken symlinks will NOT be recognized as existing and hence will
@@ -146,8 +275,176 @@ void removeFile(const boost::filesystem::path &path) {
     }
 }
 
+// Creates the subfolders of 'dstDirFd' and collects the files to copy,
+// following the symlinks in the source folder as copyFile does
+static void createFoldersToCopy(
+    DirectoryScanner &scanner, SyscallBatch &batch, int srcDirFd, int dstDirFd,
+    const boost::filesystem::path &relativeDir,
+    const boost::filesystem::path &src, const boost::filesystem::path &dst,
+    uid_t uid, gid_t gid, std::vector<boost::filesystem::path> &files) {
+    auto subdirs = std::vector<std::string>{};
+    scanner.scan(srcDirFd, src / relativeDir, [&](const DirectoryEntry &entry) {
+        auto type = entry.type;
+        if (type == DT_LNK) {
+            struct stat st;
+            if (fstatat(srcDirFd, entry.name.data(), &st, 0) != 0) {
+                auto message = boost::format("Failed to stat %s: %s") %
+                               (src / relativeDir / entry.name.data()) %
+                               strerror(errno);
+                SARUS_THROW_ERROR(message.str());
+            }
+            type = IFTODT(st.st_mode);
+        }
+
+        if (type == DT_REG) {
+            files.push_back(relativeDir / entry.name.data());
+        } else if (type == DT_DIR) {
+            subdirs.emplace_back(entry.name);
+        } else {
+            auto message = boost::format(
+                               "Failed to copy %s: not a regular file or "
+                               "directory") %
+                           (src / relativeDir / entry.name.data());
+            SARUS_THROW_ERROR(message.str());
+        }
+    });
+
+    // the subfolders are created in batches and walked after the scan, which
+    // reuses the scanner
+    batch.clear();
+    for (const auto &name : subdirs) {
+        batch.mkdirat(dstDirFd, name, 0777);
+    }
+    batch.submit();
+    checkBatchResults(batch, subdirs, "create directory", dst / relativeDir);
+    if (uid != static_cast<uid_t>(-1) || gid != static_cast<gid_t>(-1)) {
+        batch.clear();
+        for (const auto &name : subdirs) {
+            batch.fchownat(dstDirFd, name, uid, gid, AT_SYMLINK_NOFOLLOW);
+        }
+        batch.submit();
+        checkBatchResults(batch, subdirs, "change ownership of path",
+                          dst / relativeDir);
+    }
+
+    for (const auto &name : subdirs) {
+        auto relativePath = relativeDir / name;
+        auto srcSubdirFd = openAt(srcDirFd, name,
+                                  O_RDONLY | O_DIRECTORY | O_CLOEXEC,
+                                  src / relativeDir);
+        auto dstSubdirFd = openAt(dstDirFd, name,
+                                  O_PATH | O_DIRECTORY | O_CLOEXEC,
+                                  dst / relativeDir);
+        createFoldersToCopy(scanner, batch, srcSubdirFd.get(),
+                            dstSubdirFd.get(), relativePath, src, dst, uid, gid,
+                            files);
+    }
+}
+
+// Copies the data of a file, through a reflink if the filesystem supports
+// it, otherwise with copy_file_range(2) (which lets the kernel avoid copying
+// the data to user space) or, as a last resort, with read(2)/write(2).
+static void copyFileData(int srcFd, int dstFd, size_t size,
+                         const boost::filesystem::path &src) {
+    if (size > 0 && ioctl(dstFd, FICLONE, srcFd) == 0) {
+        return;
+    }
+
+    size_t copied = 0;
+    while (copied < size) {
+        auto result =
+            copy_file_range(srcFd, nullptr, dstFd, nullptr, size - copied, 0);
+        if (result < 0) {
+            if (copied == 0 && (errno == EXDEV || errno == EINVAL ||
+                                errno == ENOSYS || errno == EOPNOTSUPP)) {
+                break;  // not supported for these files
+            }
+            auto message = boost::format("Failed to copy data of %s: %s") %
+                           src % strerror(errno);
+            SARUS_THROW_ERROR(message.str());
+        }
+        if (result == 0) {
+            return;  // the file shrank
+        }
+        copied += result;
+    }
+    if (copied == size && size > 0) {
+        return;
+    }
+
+    // Files reporting a zero size (e.g. in procfs) may still have data
+    char buffer[131072];
+    while (true) {
+        auto bytesRead = read(srcFd, buffer, sizeof(buffer));
+        if (bytesRead < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytesRead < 0) {
+            auto message = boost::format("Failed to read %s: %s") % src %
+                           strerror(errno);
+            SARUS_THROW_ERROR(message.str());
+        }
+        if (bytesRead == 0) {
+            return;
+        }
+        for (ssize_t written = 0; written < bytesRead;) {
+            auto result = write(dstFd, buffer + written, bytesRead - written);
+            if (result < 0 && errno != EINTR) {
+                auto message =
+                    boost::format("Failed to write copy of %s: %s") % src %
+                    strerror(errno);
+                SARUS_THROW_ERROR(message.str());
+            }
+            written += std::max<ssize_t>(result, 0);
+        }
+    }
+}
+
+static void copyFileAt(int srcRootFd, int dstRootFd,
+                       const boost::filesystem::path &relativePath,
+                       const boost::filesystem::path &src,
+                       const boost::filesystem::path &dst, uid_t uid,
+                       gid_t gid) {
+    auto srcFd = openAt(srcRootFd, relativePath, O_RDONLY | O_CLOEXEC, src);
+    struct stat st;
+    if (fstat(srcFd.get(), &st) != 0) {
+        auto message = boost::format("Failed to stat %s: %s") %
+                       (src / relativePath) % strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
+
+    auto mode = st.st_mode & 07777;
+    // as with copyFile, a copy handed over to another owner is not set-user-ID
+    // nor set-group-ID
+    if (uid != static_cast<uid_t>(-1)) {
+        mode &= ~(S_ISUID | S_ISGID);
+    }
+    auto dstFd = openAt(dstRootFd, relativePath,
+                        O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, dst, mode);
+    copyFileData(srcFd.get(), dstFd.get(), st.st_size, src / relativePath);
+    setOwnerAt(dstFd.get(), "", uid, gid, dst / relativePath);
+    // the permissions are set last, as they are affected by the umask
+    if (fchmod(dstFd.get(), mode) != 0) {
+        auto message = boost::format("Failed to set permissions of %s: %s") %
+                       (dst / relativePath) % strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
+}
+
+/**
+ * Copies the content of the 'src' folder into the new folder 'dst', following
+ * the symlinks found in 'src'. The copied files keep their permissions and
+ * are owned by 'uid' and 'gid' (if specified), as with copyFile.
+ *
+ * The source folder is walked with a DirectoryScanner and the subfolders are
+ * created first. Then the files are copied by up to 'numberOfThreads' threads
+ * (0 means one per available CPU), with reflinks or copy_file_range(2) where
+ * the filesystems support them. The batches of system calls of the walk are
+ * submitted through io_uring only if 'useIoUring' is set.
+ */
 void copyFolder(const boost::filesystem::path &src,
-                const boost::filesystem::path &dst, uid_t uid, gid_t gid) {
+                const boost::filesystem::path &dst, uid_t uid, gid_t gid,
+                unsigned int numberOfThreads, bool useIoUring) {
     if (!boost::filesystem::exists(src) ||
         !boost::filesystem::is_directory(src)) {
         auto message =
@@ -165,17 +462,329 @@ void copyFolder(const boost::filesystem::path &src,
         SARUS_THROW_ERROR(message.str());
     }
 
+    logMessage(boost::format{"Copying folder %s -> %s"} % src % dst,
+               LogLevel::DEBUG);
     filesystem::createFoldersIfNecessary(dst, uid, gid);
 
-    // for each file/folder in the directory
-    for (boost::filesystem::directory_iterator entry{src};
-         entry != boost::filesystem::directory_iterator{}; ++entry) {
-        if (boost::filesystem::is_directory(entry->path())) {
-            copyFolder(entry->path(), dst / entry->path().filename(), uid, gid);
-        } else {
-            copyFile(entry->path(), dst / entry->path().filename(), uid, gid);
+    auto srcFd = openAt(AT_FDCWD, src, O_RDONLY | O_DIRECTORY | O_CLOEXEC, "");
+    auto dstFd = openAt(AT_FDCWD, dst, O_PATH | O_DIRECTORY | O_CLOEXEC, "");
+    auto files = std::vector<boost::filesystem::path>{};
+    auto scanner = DirectoryScanner{};
+    auto batch = SyscallBatch{SyscallBatch::defaultQueueDepth, useIoUring};
+    createFoldersToCopy(scanner, batch, srcFd.get(), dstFd.get(), "", src, dst,
+                        uid, gid, files);
+
+    parallel::forEachIndex(
+        files.size(),
+        [&](size_t i) {
+            copyFileAt(srcFd.get(), dstFd.get(), files[i], src, dst, uid, gid);
+        },
+        numberOfThreads);
+}
+
+// Gives the owner full permissions on the directory 'dirFd', if it belongs to
+// the tree being removed, and on its entry 'name', if not empty, so that their
+// entries can be listed and removed. The parent of the tree is never changed.
+static void makeRemovableByOwner(int dirFd, bool isDirInTree, const char *name,
+                                 const boost::filesystem::path &path) {
+    if ((isDirInTree && fchmod(dirFd, S_IRWXU) != 0) ||
+        (*name != '\0' &&
+         fchmodat(dirFd, name, S_IRWXU, 0) != 0 && errno != ENOENT)) {
+        auto message = boost::format("Failed to set permissions of %s: %s") %
+                       path % strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
+}
+
+// Opens the directory 'name' within 'dirFd' to remove its entries. Returns an
+// invalid descriptor if the directory doesn't exist.
+static FileDescriptor openDirectoryToRemove(
+    int dirFd, bool isDirInTree, const char *name,
+    const boost::filesystem::path &path) {
+    auto flags = O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC;
+    auto fd = FileDescriptor{openat(dirFd, name, flags)};
+    if (!fd.isValid() && errno == EACCES) {
+        makeRemovableByOwner(dirFd, isDirInTree, name, path);
+        fd.reset(openat(dirFd, name, flags));
+    }
+    if (!fd.isValid() && errno != ENOENT) {
+        auto message = boost::format("Failed to open directory %s: %s") %
+                       path % strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
+    return fd;
+}
+
+static void unlinkToRemove(int dirFd, bool isDirInTree, const char *name,
+                           int flags, const boost::filesystem::path &path) {
+    auto result = unlinkat(dirFd, name, flags);
+    if (result != 0 && errno == EACCES && isDirInTree) {
+        makeRemovableByOwner(dirFd, isDirInTree, "", path.parent_path());
+        result = unlinkat(dirFd, name, flags);
+    }
+    if (result != 0 && errno != ENOENT) {
+        auto message =
+            boost::format("Failed to remove %s: %s") % path % strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
+}
+
+// Submits the batch of unlinkat(2) calls on the entries 'names' of the
+// directory 'dirFd'. The entries which cannot be removed because of the
+// permissions of the directory are removed again by unlinkToRemove.
+static void unlinkBatchToRemove(SyscallBatch &batch, int dirFd,
+                                std::vector<std::string> &names,
+                                const boost::filesystem::path &dir) {
+    batch.submit();
+    for (size_t i = 0; i < names.size(); ++i) {
+        auto result = batch.getResult(i);
+        if (result == -EACCES) {
+            unlinkToRemove(dirFd, true, names[i].c_str(), 0, dir / names[i]);
+        } else if (result != 0 && result != -ENOENT) {
+            auto message = boost::format("Failed to remove %s: %s") %
+                           (dir / names[i]) % strerror(-result);
+            SARUS_THROW_ERROR(message.str());
+        }
+    }
+    batch.clear();
+    names.clear();
+}
+
+// Removes the files in the directory 'dirFd' and returns the names of its
+// subdirectories, which are left to the caller
+static std::vector<std::string> removeFilesAt(
+    DirectoryScanner &scanner, SyscallBatch &batch, int dirFd,
+    const boost::filesystem::path &dir) {
+    auto subdirs = std::vector<std::string>{};
+    auto files = std::vector<std::string>{};
+    batch.clear();
+    scanner.scan(dirFd, dir, [&](const DirectoryEntry &entry) {
+        if (entry.type == DT_DIR) {
+            subdirs.emplace_back(entry.name);
+            return;
+        }
+        files.emplace_back(entry.name);
+        batch.unlinkat(dirFd, files.back(), 0);
+        if (files.size() == SyscallBatch::defaultQueueDepth) {
+            unlinkBatchToRemove(batch, dirFd, files, dir);
+        }
+    });
+    unlinkBatchToRemove(batch, dirFd, files, dir);
+    return subdirs;
+}
+
+static void removeDirectoryAt(DirectoryScanner &scanner, SyscallBatch &batch,
+                              int parentFd, const std::string &name,
+                              const boost::filesystem::path &dir) {
+    auto fd = openDirectoryToRemove(parentFd, true, name.c_str(), dir);
+    if (!fd.isValid()) {
+        return;
+    }
+    for (const auto &subdir : removeFilesAt(scanner, batch, fd.get(), dir)) {
+        removeDirectoryAt(scanner, batch, fd.get(), subdir, dir / subdir);
+    }
+    fd.reset();
+    unlinkToRemove(parentFd, true, name.c_str(), AT_REMOVEDIR, dir);
+}
+
+// A directory of the tree being removed, with the descriptor of its parent
+struct DirectoryToRemove {
+    int parentFd;
+    std::string name;
+    boost::filesystem::path path;
+};
+
+// A directory whose files were removed before its subdirectories were handed
+// out to the workers. It is removed after them.
+struct ExpandedDirectory {
+    DirectoryToRemove directory;
+    FileDescriptor fd;
+    std::vector<std::string> subdirs;
+};
+
+/**
+ * Removes 'path' and, if it is a directory, all its content, as
+ * boost::filesystem::remove_all does. Nothing happens if 'path' doesn't exist.
+ *
+ * The tree is walked once, relative to the file descriptors of its
+ * directories. Directories without owner permissions to list or remove their
+ * entries (e.g. in some unpacked container images) get them on the fly, when
+ * an operation fails with EACCES. The files of each directory are unlinked in
+ * batches (see SyscallBatch), through io_uring only if 'useIoUring' is set.
+ *
+ * The subtrees are removed by up to 'numberOfThreads' threads (0 means one per
+ * available CPU). The tree is split level by level until there are at least
+ * as many subtrees as threads, so that a tree with a single large
+ * subdirectory (e.g. the rootfs of a bundle) is removed in parallel too.
+ */
+void removeTree(const boost::filesystem::path &path,
+                unsigned int numberOfThreads, bool useIoUring) {
+    auto parent = path.has_parent_path() ? path.parent_path()
+                                         : boost::filesystem::path{"."};
+    auto name = path.filename().string();
+    auto parentFd = FileDescriptor{
+        open(parent.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)};
+    if (!parentFd.isValid() && errno == ENOENT) {
+        return;
+    }
+    if (!parentFd.isValid()) {
+        auto message = boost::format("Failed to open directory %s: %s") %
+                       parent % strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
+
+    struct stat st;
+    if (fstatat(parentFd.get(), name.c_str(), &st, AT_SYMLINK_NOFOLLOW) != 0) {
+        if (errno == ENOENT) {
+            return;
+        }
+        auto message =
+            boost::format("Failed to stat %s: %s") % path % strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        unlinkToRemove(parentFd.get(), false, name.c_str(), 0, path);
+        return;
+    }
+
+    auto fd =
+        openDirectoryToRemove(parentFd.get(), false, name.c_str(), path);
+    if (!fd.isValid()) {
+        return;
+    }
+
+    // each worker reuses its scanner and batch for all its directories
+    auto workerScanners = std::deque<DirectoryScanner>{};
+    auto workerBatches = std::deque<SyscallBatch>{};
+    auto addWorkers = [&](size_t count) {
+        auto numberOfWorkers =
+            parallel::getNumberOfWorkers(count, numberOfThreads);
+        while (workerScanners.size() < std::max(numberOfWorkers, 1u)) {
+            workerScanners.emplace_back();
+            workerBatches.emplace_back(SyscallBatch::defaultQueueDepth,
+                                       useIoUring);
+        }
+    };
+    addWorkers(1);
+
+    auto subtrees = std::vector<DirectoryToRemove>{};
+    for (auto &subdir :
+         removeFilesAt(workerScanners[0], workerBatches[0], fd.get(), path)) {
+        subtrees.push_back({fd.get(), subdir, path / subdir});
+    }
+
+    // split the tree until there are enough subtrees for all the workers:
+    // the files of each level are removed and its subdirectories become the
+    // subtrees, while the directories of the level are left for the end
+    auto minimumNumberOfSubtrees = numberOfThreads != 0
+                                       ? numberOfThreads
+                                       : parallel::getDefaultNumberOfThreads();
+    auto expandedLevels = std::vector<std::vector<ExpandedDirectory>>{};
+    while (!subtrees.empty() && subtrees.size() < minimumNumberOfSubtrees) {
+        addWorkers(subtrees.size());
+        auto level = std::vector<ExpandedDirectory>(subtrees.size());
+        parallel::forEachIndexInWorkers(
+            subtrees.size(),
+            [&](size_t i, unsigned int worker) {
+                auto &expanded = level[i];
+                expanded.directory = std::move(subtrees[i]);
+                const auto &dir = expanded.directory;
+                expanded.fd = openDirectoryToRemove(
+                    dir.parentFd, true, dir.name.c_str(), dir.path);
+                if (expanded.fd.isValid()) {
+                    expanded.subdirs = removeFilesAt(
+                        workerScanners[worker], workerBatches[worker],
+                        expanded.fd.get(), dir.path);
+                }
+            },
+            numberOfThreads);
+
+        subtrees.clear();
+        for (const auto &expanded : level) {
+            for (const auto &subdir : expanded.subdirs) {
+                subtrees.push_back({expanded.fd.get(), subdir,
+                                    expanded.directory.path / subdir});
+            }
+        }
+        expandedLevels.push_back(std::move(level));
+    }
+
+    addWorkers(subtrees.size());
+    parallel::forEachIndexInWorkers(
+        subtrees.size(),
+        [&](size_t i, unsigned int worker) {
+            const auto &dir = subtrees[i];
+            removeDirectoryAt(workerScanners[worker], workerBatches[worker],
+                              dir.parentFd, dir.name, dir.path);
+        },
+        numberOfThreads);
+
+    // remove the directories of the split levels, the deepest first
+    for (auto level = expandedLevels.rbegin(); level != expandedLevels.rend();
+         ++level) {
+        for (auto &expanded : *level) {
+            if (!expanded.fd.isValid()) {
+                continue;
+            }
+            expanded.fd.reset();
+            const auto &dir = expanded.directory;
+            unlinkToRemove(dir.parentFd, true, dir.name.c_str(), AT_REMOVEDIR,
+                           dir.path);
         }
     }
+    fd.reset();
+    unlinkToRemove(parentFd.get(), false, name.c_str(), AT_REMOVEDIR, path);
+}
+
+/**
+ * Moves 'path' into the directory 'trashDir', which must be on the same
+ * filesystem, and removes it with removeTree in a background thread. The
+ * returned future reports the outcome of the removal, which is also logged if
+ * it fails, and owns the thread: destroying the future waits for the removal.
+ * If 'path' cannot be moved, it is removed before returning.
+ *
+ * Removals interrupted by the exit of the process leave their tree in the
+ * trash directory.
+ */
+std::future<void> removeTreeInBackground(
+    const boost::filesystem::path &path,
+    const boost::filesystem::path &trashDir, unsigned int numberOfThreads,
+    bool useIoUring) {
+    auto trashPath = boost::filesystem::path{};
+    try {
+        createFoldersIfNecessary(trashDir);
+        // the path is moved into a new directory, so that nothing else can
+        // be replaced by the rename
+        trashPath = createUniqueDirectory(trashDir / path.filename()).path;
+        if (rename(path.c_str(), (trashPath / "tree").c_str()) != 0) {
+            auto message = boost::format("Failed to move %s to %s: %s") %
+                           path % trashPath % strerror(errno);
+            rmdir(trashPath.c_str());
+            SARUS_THROW_ERROR(message.str());
+        }
+    } catch (const std::exception &e) {
+        logMessage(boost::format("%s. Removing %s in the foreground.") %
+                       e.what() % path,
+                   LogLevel::DEBUG);
+        auto promise = std::promise<void>{};
+        removeTree(path, numberOfThreads, useIoUring);
+        promise.set_value();
+        return promise.get_future();
+    }
+
+    // the thread is joined by the destructor of the last copy of the future
+    return std::async(
+        std::launch::async, [trashPath, numberOfThreads, useIoUring]() {
+            try {
+                removeTree(trashPath, numberOfThreads, useIoUring);
+            } catch (const std::exception &e) {
+                logMessage(boost::format("Failed to remove %s in the "
+                                         "background: %s") %
+                               trashPath % e.what(),
+                           LogLevel::WARN);
+                throw;
+            }
+        });
 }
 
 void changeDirectory(const boost::filesystem::path &path) {
@@ -195,8 +804,9 @@ void changeDirectory(const boost::filesystem::path &path) {
 }
 
 int countFilesInDirectory(const boost::filesystem::path &path) {
-    if (!boost::filesystem::exists(path) ||
-        !boost::filesystem::is_directory(path)) {
+    auto fd =
+        FileDescriptor{open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)};
+    if (!fd.isValid()) {
         auto message = boost::format(
                            "Failed to count files in %s: path is not an "
                            "existing directory.") %
@@ -204,20 +814,24 @@ int countFilesInDirectory(const boost::filesystem::path &path) {
         SARUS_THROW_ERROR(message.str());
     }
 
-    auto path_iterator = boost::filesystem::directory_iterator(path);
-
-    // The directory_iterator() ctor without arguments always creates the "end"
-    // iterator
-    auto numberOfFiles = static_cast<int>(
-        std::distance(path_iterator, boost::filesystem::directory_iterator()));
+    auto numberOfFiles = 0;
+    auto scanner = DirectoryScanner{};
+    scanner.scan(fd.get(), path,
+                 [&numberOfFiles](const DirectoryEntry &) { ++numberOfFiles; });
     return numberOfFiles;
 }
 
+/**
+ * Returns a copy of the content of a file, or an empty string if the file
+ * cannot be read (e.g. it doesn't exist). Use a FileView to parse the content
+ * in place instead, or to get an error for unreadable files.
+ */
 std::string readFile(const boost::filesystem::path &path) {
-    std::ifstream ifs(path.string());
-    auto s = std::string(std::istreambuf_iterator<char>(ifs),
-                         std::istreambuf_iterator<char>());
-    return s;
+    try {
+        return std::string{FileView{path}.view()};
+    } catch (const Error &) {
+        return {};
+    }
 }
 
 void writeTextFile(const std::string &text,
@@ -238,6 +852,27 @@ void writeTextFile(const std::string &text,
     }
 }
 
+/**
+ * Adds the writing of a text file to a batch of atomic writes, which replaces
+ * the file once committed.
+ */
+void writeTextFile(const std::string &text,
+                   const boost::filesystem::path &filename,
+                   AtomicWriteBatch &batch) {
+    batch.add(filename, text);
+}
+
+/**
+ * Replaces the content of a text file atomically. See AtomicWriteBatch.
+ */
+void writeTextFileAtomically(const std::string &text,
+                             const boost::filesystem::path &filename,
+                             bool durable) {
+    auto batch = AtomicWriteBatch{durable};
+    batch.add(filename, text);
+    batch.commit();
+}
+
 /**
  * Generates a random suffix and append it to the given path. If the generated
  * random path exists, tries again with another suffix until the operation
@@ -247,6 +882,10 @@ void writeTextFile(const std::string &text,
  * it fails (throws exception) when the locale configuration is invalid. More
  * specifically, we experienced the problem when LC_CTYPE was set to UTF-8 and
  * the locale UTF-8 was not installed.
+ *
+ * Note: the returned path might be created by someone else before the caller
+ * uses it. Use createUniqueFile or createUniqueDirectory to get a unique path
+ * atomically.
  */
 boost::filesystem::path makeUniquePathWithRandomSuffix(
     const boost::filesystem::path &path) {
@@ -261,6 +900,91 @@ boost::filesystem::path makeUniquePathWithRandomSuffix(
     return uniquePath;
 }
 
+static boost::filesystem::path makePathWithRandomSuffix(
+    const boost::filesystem::path &path) {
+    const size_t sizeOfRandomSuffix = 16;
+    return path.string() + "-" + string::generateRandom(sizeOfRandomSuffix);
+}
+
+/**
+ * Creates a new file named as the given path plus a random suffix (see
+ * makeUniquePathWithRandomSuffix), atomically with O_EXCL, and returns it
+ * opened for reading and writing.
+ */
+UniquePath createUniqueFile(const boost::filesystem::path &path, mode_t mode) {
+    while (true) {
+        auto uniquePath = makePathWithRandomSuffix(path);
+        auto fd = FileDescriptor{open(uniquePath.c_str(),
+                                      O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC,
+                                      mode)};
+        if (fd.isValid()) {
+            return UniquePath{std::move(fd), std::move(uniquePath)};
+        }
+        if (errno != EEXIST) {
+            auto message =
+                boost::format("Failed to create unique file %s: %s") %
+                uniquePath % strerror(errno);
+            SARUS_THROW_ERROR(message.str());
+        }
+    }
+}
+
+/**
+ * Creates a new directory named as the given path plus a random suffix (see
+ * makeUniquePathWithRandomSuffix), atomically as mkdtemp(3) does, and returns
+ * it opened as an O_PATH descriptor.
+ */
+UniquePath createUniqueDirectory(const boost::filesystem::path &path,
+                                 mode_t mode) {
+    while (true) {
+        auto uniquePath = makePathWithRandomSuffix(path);
+        if (mkdir(uniquePath.c_str(), mode) == 0) {
+            auto fd = FileDescriptor{
+                open(uniquePath.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC)};
+            if (!fd.isValid()) {
+                auto message =
+                    boost::format("Failed to open directory %s: %s") %
+                    uniquePath % strerror(errno);
+                SARUS_THROW_ERROR(message.str());
+            }
+            return UniquePath{std::move(fd), std::move(uniquePath)};
+        }
+        if (errno != EEXIST) {
+            auto message =
+                boost::format("Failed to create unique directory %s: %s") %
+                uniquePath % strerror(errno);
+            SARUS_THROW_ERROR(message.str());
+        }
+    }
+}
+
+/**
+ * Creates an unnamed file in the directory 'dir', which is removed once its
+ * descriptor is closed. Uses O_TMPFILE or, on filesystems without support for
+ * it, a unique file which is unlinked right away.
+ */
+FileDescriptor createAnonymousFile(const boost::filesystem::path &dir,
+                                   mode_t mode) {
+    auto fd = FileDescriptor{
+        open(dir.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, mode)};
+    if (fd.isValid()) {
+        return fd;
+    }
+    if (errno != EOPNOTSUPP && errno != EISDIR && errno != EINVAL) {
+        auto message = boost::format("Failed to create file in %s: %s") % dir %
+                       strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
+
+    auto file = createUniqueFile(dir / ".anonymous", mode);
+    if (unlink(file.path.c_str()) != 0) {
+        auto message = boost::format("Failed to unlink %s: %s") % file.path %
+                       strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
+    return std::move(file.fd);
+}
+
 std::string makeColonSeparatedListOfPaths(
     const std::vector<boost::filesystem::path> &paths) {
     auto s = std::string{};
@@ -276,10 +1000,15 @@ std::string makeColonSeparatedListOfPaths(
     return s;
 }
 
-static boost::filesystem::path getSymlinkTarget(
-    const boost::filesystem::path &path) {
+boost::filesystem::path getSymlinkTarget(const boost::filesystem::path &path) {
     char buffer[PATH_MAX];
     auto count = readlink(path.string().c_str(), buffer, PATH_MAX);
+    if (count < 0) {
+        auto message =
+            boost::format("Failed to read target of symlink %s: %s") % path %
+            strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
     assert(count < PATH_MAX);  // PATH_MAX is supposed to be large enough for
                                // any path + NULL terminating char
     buffer[count] = '\0';
@@ -306,6 +1035,9 @@ static boost::filesystem::path getSymlinkTarget(
    'traversedSymlinks' contains the various symlinks that were traversed during
    the path resolution process.
 
+    The resolution doesn't cache anything across calls: use a RootfsResolver
+   to share the lookups among multiple resolutions within the same rootfs.
+
     NOTE: (from lee) This function was exported via a header file because while
     its operation falls in the "path" category (Path.hpp), the function itself
     was also used by the "shared library" category (SharedLibs.hpp).
@@ -314,35 +1046,104 @@ boost::filesystem::path appendPathsWithinRootfs(
     const boost::filesystem::path &rootfs, const boost::filesystem::path &path0,
     const boost::filesystem::path &path1,
     std::vector<boost::filesystem::path> *traversedSymlinks) {
-    auto current = path0;
+    return RootfsResolver{rootfs}.appendPaths(path0, path1, traversedSymlinks);
+}
 
-    for (const auto &element : path1) {
-        if (element == "/") {
-            continue;
-        } else if (element == ".") {
-            continue;
-        } else if (element == "..") {
-            if (current > "/") {
-                current = current.remove_trailing_separator().parent_path();
-            }
-        } else if (isSymlink(rootfs / current / element)) {
-            if (traversedSymlinks) {
-                traversedSymlinks->push_back(current / element);
-            }
-            auto target = getSymlinkTarget(rootfs / current / element);
-            if (target.is_absolute()) {
-                current = appendPathsWithinRootfs(rootfs, "/", target,
-                                                  traversedSymlinks);
-            } else {
-                current = appendPathsWithinRootfs(rootfs, current, target,
-                                                  traversedSymlinks);
-            }
-        } else {
-            current /= element;
+static boost::filesystem::path getPathOfFileDescriptor(int fd) {
+    return getSymlinkTarget(boost::filesystem::path{"/proc/self/fd"} /
+                            std::to_string(fd));
+}
+
+// Set when the kernel turns out not to support openat2(2), i.e. Linux < 5.6
+static std::atomic<bool> isOpenat2Unsupported{false};
+
+static boost::optional<PathWithinRootfs> openWithinRootfsWithOpenat2(
+    const boost::filesystem::path &rootfs,
+    const boost::filesystem::path &path) {
+#if defined(SYS_openat2) && defined(RESOLVE_IN_ROOT)
+    if (isOpenat2Unsupported) {
+        return {};
+    }
+
+    auto rootfsFd =
+        FileDescriptor{open(rootfs.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC)};
+    if (!rootfsFd.isValid()) {
+        return {};
+    }
+
+    struct open_how how = {};
+    how.flags = O_PATH | O_CLOEXEC;
+    how.resolve = RESOLVE_IN_ROOT | RESOLVE_NO_MAGICLINKS;
+    auto relativePath = path.relative_path();
+    if (relativePath.empty()) {
+        relativePath = ".";
+    }
+
+    // With RESOLVE_IN_ROOT, the kernel returns EAGAIN if a concurrent rename
+    // or mount could have let the resolution escape the root
+    int fd;
+    int attempts = 0;
+    do {
+        fd = syscall(SYS_openat2, rootfsFd.get(), relativePath.c_str(), &how,
+                     sizeof(how));
+    } while (fd < 0 && (errno == EAGAIN || errno == EINTR) && ++attempts < 8);
+
+    if (fd < 0) {
+        if (errno == ENOSYS) {
+            isOpenat2Unsupported = true;
+        }
+        // e.g. ENOENT: the userspace resolution also handles paths which
+        // don't exist (yet)
+        return {};
+    }
+    auto resolvedFd = FileDescriptor{fd};
+
+    // Convert the kernel's view of the resolved file into a path within the
+    // rootfs, e.g. /rootfs/etc/file -> /etc/file
+    try {
+        auto rootfsReal = getPathOfFileDescriptor(rootfsFd.get()).string();
+        auto resolvedReal = getPathOfFileDescriptor(resolvedFd.get()).string();
+        if (rootfsReal == "/") {
+            rootfsReal.clear();
+        }
+        if (resolvedReal == rootfsReal) {
+            return PathWithinRootfs{std::move(resolvedFd), "/"};
+        }
+        if (!boost::starts_with(resolvedReal, rootfsReal + "/")) {
+            return {};
         }
+        return PathWithinRootfs{std::move(resolvedFd),
+                                resolvedReal.substr(rootfsReal.size())};
+    } catch (const Error &) {
+        // e.g. /proc is not mounted
+        return {};
+    }
+#else
+    return {};
+#endif
+}
+
+/**
+ * Resolves the given absolute path within the rootfs, as
+ * appendPathsWithinRootfs(rootfs, "/", path) does, and opens the resolved
+ * file with O_PATH.
+ *
+ * The resolution is performed by the kernel with openat2(2) and
+ * RESOLVE_IN_ROOT, i.e. with a single system call. On older kernels, or if
+ * the path doesn't exist, the resolution falls back to
+ * appendPathsWithinRootfs.
+ */
+PathWithinRootfs openWithinRootfs(const boost::filesystem::path &rootfs,
+                                  const boost::filesystem::path &path) {
+    auto result = openWithinRootfsWithOpenat2(rootfs, path);
+    if (result) {
+        return std::move(*result);
     }
 
-    return current;
+    auto resolvedPath = appendPathsWithinRootfs(rootfs, "/", path);
+    auto fd = open((rootfs / resolvedPath).c_str(),
+                   O_PATH | O_NOFOLLOW | O_CLOEXEC);
+    return PathWithinRootfs{FileDescriptor{fd}, std::move(resolvedPath)};
 }
 
 boost::filesystem::path realpathWithinRootfs(
@@ -356,77 +1157,392 @@ boost::filesystem::path realpathWithinRootfs(
         SARUS_THROW_ERROR(message.str());
     }
 
-    return appendPathsWithinRootfs(rootfs, "/", path);
+    return openWithinRootfs(rootfs, path).path;
+}
+
+namespace {
+
+// Metadata of an entry of a tree, as hashed by fingerprintTree
+struct TreeEntryRecord {
+    std::string relativePath;
+    uint64_t inode = 0;
+    uint64_t size = 0;
+    int64_t mtimeSeconds = 0;
+    int64_t mtimeNanoseconds = 0;
+    uint32_t mode = 0;
+    uint64_t contentHash = 0;
+
+    bool hasSameStat(const TreeEntryRecord &rhs) const {
+        return inode == rhs.inode && size == rhs.size &&
+               mtimeSeconds == rhs.mtimeSeconds &&
+               mtimeNanoseconds == rhs.mtimeNanoseconds && mode == rhs.mode;
+    }
+};
+
+}  // namespace
+
+static const auto treeManifestHeader = std::string{"sarus-tree-manifest 1 "};
+
+// 64-bit FNV-1a hash
+static uint64_t hashBytes(const void *data, size_t size,
+                          uint64_t hash = 0xcbf29ce484222325) {
+    const auto *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3;
+    }
+    return hash;
+}
+
+template <class T> static uint64_t hashValue(const T &value, uint64_t hash) {
+    return hashBytes(&value, sizeof(value), hash);
+}
+
+// Collects the paths (relative to the tree's root) of the entries of the
+// directory 'dirFd' and of its subdirectories, without following symlinks
+static void collectTreeEntries(DirectoryScanner &scanner, int dirFd,
+                               const boost::filesystem::path &relativeDir,
+                               const boost::filesystem::path &root,
+                               std::vector<TreeEntryRecord> &records) {
+    auto subdirs = std::vector<std::string>{};
+    scanner.scan(dirFd, root / relativeDir, [&](const DirectoryEntry &entry) {
+        auto record = TreeEntryRecord{};
+        record.relativePath = (relativeDir / entry.name.data()).string();
+        records.push_back(std::move(record));
+        if (entry.type == DT_DIR) {
+            subdirs.emplace_back(entry.name);
+        }
+    });
+
+    for (const auto &name : subdirs) {
+        auto subdirFd = openAt(dirFd, name,
+                               O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC,
+                               root / relativeDir);
+        collectTreeEntries(scanner, subdirFd.get(), relativeDir / name, root,
+                           records);
+    }
+}
+
+// Hashes the content of a regular file, or the target of a symlink. The file
+// is read with read(2) rather than mapped, as a file truncated after it was
+// stat'ed would raise SIGBUS when accessing the mapping.
+static uint64_t hashTreeEntryContent(int rootFd, const TreeEntryRecord &record,
+                                     const boost::filesystem::path &root) {
+    auto path = root / record.relativePath;
+    if (S_ISLNK(record.mode)) {
+        auto target = getSymlinkTarget(path);
+        return hashBytes(target.c_str(), target.size());
+    }
+    if (!S_ISREG(record.mode)) {
+        return 0;
+    }
+    auto fd = openAt(rootFd, record.relativePath,
+                     O_RDONLY | O_NOFOLLOW | O_CLOEXEC, root);
+
+    // the hash is computed incrementally, which gives the same result as
+    // hashing the whole content at once
+    auto hash = hashBytes(nullptr, 0);
+    auto buffer = std::array<unsigned char, 1 << 16>{};
+    for (size_t remaining = record.size; remaining > 0;) {
+        auto count = read(fd.get(), buffer.data(),
+                          std::min<size_t>(remaining, buffer.size()));
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count < 0) {
+            auto message =
+                boost::format("Failed to read %s: %s") % path % strerror(errno);
+            SARUS_THROW_ERROR(message.str());
+        }
+        if (count == 0) {
+            auto message = boost::format("Failed to hash %s: the file was "
+                                         "truncated while being hashed") %
+                           path;
+            SARUS_THROW_ERROR(message.str());
+        }
+        hash = hashBytes(buffer.data(), count, hash);
+        remaining -= count;
+    }
+    return hash;
+}
+
+// Returns the path of 'file' relative to the tree 'dir', or none if 'file' is
+// not within the tree
+static boost::optional<std::string> getRelativePathWithinTree(
+    const boost::filesystem::path &file, const boost::filesystem::path &dir) {
+    if (file.empty()) {
+        return boost::none;
+    }
+    auto canonicalDir = boost::filesystem::canonical(dir);
+    auto canonicalFile =
+        boost::filesystem::weakly_canonical(file.parent_path()) /
+        file.filename();
+    auto relativePath = canonicalFile.lexically_relative(canonicalDir);
+    if (relativePath.empty() || *relativePath.begin() == "..") {
+        return boost::none;
+    }
+    return relativePath.string();
+}
+
+static std::unordered_map<std::string, TreeEntryRecord> readTreeManifest(
+    const boost::filesystem::path &manifestFile, bool hashContent) {
+    auto records = std::unordered_map<std::string, TreeEntryRecord>{};
+    if (manifestFile.empty() || !boost::filesystem::exists(manifestFile)) {
+        return records;
+    }
+
+    auto manifest = FileView{manifestFile};
+    auto content = manifest.view();
+    auto header = treeManifestHeader + (hashContent ? "content\n" : "stat\n");
+    if (content.substr(0, header.size()) != header) {
+        logMessage(boost::format("Ignoring tree manifest %s: unsupported "
+                                 "format or fingerprint mode") %
+                       manifestFile,
+                   LogLevel::DEBUG);
+        return records;
+    }
+    content.remove_prefix(header.size());
+
+    // each record is "<inode> <size> <mtime s> <mtime ns> <mode> <hash>
+    // <path>", terminated by a NUL character
+    while (!content.empty()) {
+        auto end = content.find('\0');
+        auto line = content.substr(0, end);
+        content.remove_prefix(std::min(end + 1, content.size()));
+
+        auto record = TreeEntryRecord{};
+        auto fields = std::array<uint64_t, 6>{};
+        auto *position = line.data();
+        const auto *lineEnd = line.data() + line.size();
+        auto isValid = true;
+        for (size_t i = 0; i < fields.size() && isValid; ++i) {
+            auto result = std::from_chars(position, lineEnd, fields[i],
+                                          i == fields.size() - 1 ? 16 : 10);
+            isValid = result.ec == std::errc{} && result.ptr != lineEnd &&
+                      *result.ptr == ' ';
+            position = result.ptr + 1;
+        }
+        if (!isValid) {
+            logMessage(boost::format("Ignoring tree manifest %s: malformed "
+                                     "record") %
+                           manifestFile,
+                       LogLevel::DEBUG);
+            return {};
+        }
+        record.inode = fields[0];
+        record.size = fields[1];
+        record.mtimeSeconds = fields[2];
+        record.mtimeNanoseconds = fields[3];
+        record.mode = fields[4];
+        record.contentHash = fields[5];
+        record.relativePath = std::string(position, lineEnd);
+        auto relativePath = record.relativePath;
+        records.emplace(std::move(relativePath), std::move(record));
+    }
+    return records;
+}
+
+static void writeTreeManifest(const boost::filesystem::path &manifestFile,
+                              const std::vector<TreeEntryRecord> &records,
+                              bool hashContent) {
+    auto manifest =
+        treeManifestHeader + (hashContent ? "content\n" : "stat\n");
+    for (const auto &record : records) {
+        char fields[128];
+        auto size = snprintf(
+            fields, sizeof(fields), "%" PRIu64 " %" PRIu64 " %" PRId64
+            " %" PRId64 " %" PRIu32 " %" PRIx64 " ", record.inode, record.size,
+            record.mtimeSeconds, record.mtimeNanoseconds, record.mode,
+            record.contentHash);
+        manifest.append(fields, size);
+        manifest += record.relativePath;
+        manifest += '\0';
+    }
+    writeTextFileAtomically(manifest, manifestFile, false);
+}
+
+/**
+ * Returns a fingerprint of the directory tree 'dir', which changes when an
+ * entry of the tree is added, removed or modified. Symlinks are not followed.
+ *
+ * By default, the fingerprint covers the relative path, inode, size, mtime and
+ * mode of each entry. If 'hashContent' is true, it covers the relative path,
+ * mode and content of each entry, and the size of the entries other than
+ * directories, instead (for symlinks, the content is the target), so that e.g.
+ * a copy of the tree gets the same fingerprint.
+ *
+ * The entries are stat'ed and hashed by up to 'numberOfThreads' threads (0
+ * means one per available CPU). If 'manifestFile' is specified, the
+ * metadata and content hash of each entry are saved there, and the next call
+ * hashes again only the content of the entries whose metadata changed. A
+ * manifest within the tree is left out of the fingerprint.
+ */
+uint64_t fingerprintTree(const boost::filesystem::path &dir, bool hashContent,
+                         const boost::filesystem::path &manifestFile,
+                         unsigned int numberOfThreads) {
+    auto rootFd = openAt(AT_FDCWD, dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC, "");
+    auto records = std::vector<TreeEntryRecord>{};
+    auto scanner = DirectoryScanner{};
+    collectTreeEntries(scanner, rootFd.get(), "", dir, records);
+
+    // a manifest within the tree is not part of the tree: it changes at
+    // every call
+    auto manifestRelativePath = getRelativePathWithinTree(manifestFile, dir);
+    if (manifestRelativePath) {
+        records.erase(
+            std::remove_if(records.begin(), records.end(),
+                           [&](const TreeEntryRecord &record) {
+                               return record.relativePath ==
+                                      *manifestRelativePath;
+                           }),
+            records.end());
+    }
+    std::sort(records.begin(), records.end(),
+              [](const TreeEntryRecord &lhs, const TreeEntryRecord &rhs) {
+                  return lhs.relativePath < rhs.relativePath;
+              });
+
+    const auto previousRecords = readTreeManifest(manifestFile, hashContent);
+    parallel::forEachIndex(
+        records.size(),
+        [&](size_t i) {
+            auto &record = records[i];
+            struct stat st;
+            if (fstatat(rootFd.get(), record.relativePath.c_str(), &st,
+                        AT_SYMLINK_NOFOLLOW) != 0) {
+                auto message = boost::format("Failed to stat %s: %s") %
+                               (dir / record.relativePath) % strerror(errno);
+                SARUS_THROW_ERROR(message.str());
+            }
+            record.inode = st.st_ino;
+            record.size = st.st_size;
+            record.mtimeSeconds = st.st_mtim.tv_sec;
+            record.mtimeNanoseconds = st.st_mtim.tv_nsec;
+            record.mode = st.st_mode;
+
+            if (!hashContent) {
+                return;
+            }
+            auto previous = previousRecords.find(record.relativePath);
+            if (previous != previousRecords.cend() &&
+                previous->second.hasSameStat(record)) {
+                record.contentHash = previous->second.contentHash;
+            } else {
+                record.contentHash =
+                    hashTreeEntryContent(rootFd.get(), record, dir);
+            }
+        },
+        numberOfThreads);
+
+    auto fingerprint = hashBytes(nullptr, 0);
+    for (const auto &record : records) {
+        fingerprint = hashBytes(record.relativePath.c_str(),
+                                record.relativePath.size() + 1, fingerprint);
+        // the size of a directory depends on the filesystem and on the
+        // history of its entries, which a copy doesn't preserve
+        if (!hashContent || !S_ISDIR(record.mode)) {
+            fingerprint = hashValue(record.size, fingerprint);
+        }
+        fingerprint = hashValue(record.mode, fingerprint);
+        if (hashContent) {
+            fingerprint = hashValue(record.contentHash, fingerprint);
+        } else {
+            fingerprint = hashValue(record.inode, fingerprint);
+            fingerprint = hashValue(record.mtimeSeconds, fingerprint);
+            fingerprint = hashValue(record.mtimeNanoseconds, fingerprint);
+        }
+    }
+
+    if (!manifestFile.empty()) {
+        writeTreeManifest(manifestFile, records, hashContent);
+    }
+    return fingerprint;
 }
 
 dev_t getDeviceID(const boost::filesystem::path &path) {
-    struct stat sb;
-    if (stat(path.c_str(), &sb) != 0) {
+    try {
+        return getDeviceID(FileInfo{path, STATX_TYPE});
+    } catch (const Error &e) {
         auto message =
-            boost::format(
-                "Failed to retrieve device ID of file %s. Stat failed: %s") %
-            path % strerror(errno);
-        SARUS_THROW_ERROR(message.str());
+            boost::format("Failed to retrieve device ID of file %s") % path;
+        SARUS_RETHROW_ERROR(e, message.str());
     }
-    logMessage(boost::format("Got device ID for %s: %d") % path % sb.st_rdev,
+}
+
+dev_t getDeviceID(const FileInfo &info) {
+    auto deviceID = info.getDeviceID();
+    logMessage(boost::format("Got device ID for %s: %d") % info.getPath() %
+                   deviceID,
                LogLevel::DEBUG);
-    return sb.st_rdev;
+    return deviceID;
 }
 
 char getDeviceType(const boost::filesystem::path &path) {
+    return getDeviceType(FileInfo{path, STATX_TYPE});
+}
+
+char getDeviceType(const FileInfo &info) {
     char deviceType;
-    if (filesystem::isCharacterDevice(path)) {
+    if (filesystem::isCharacterDevice(info)) {
         deviceType = 'c';
-    } else if (filesystem::isBlockDevice(path)) {
+    } else if (filesystem::isBlockDevice(info)) {
         deviceType = 'b';
     } else {
         auto message =
             boost::format(
                 "Failed to recognize device type of file %s."
                 " File is not a device or has unknown device type.") %
-            path;
+            info.getPath();
         SARUS_THROW_ERROR(message.str());
     }
-    logMessage(
-        boost::format("Got device type for %s: '%c'") % path % deviceType,
-        LogLevel::DEBUG);
+    logMessage(boost::format("Got device type for %s: '%c'") %
+                   info.getPath() % deviceType,
+               LogLevel::DEBUG);
     return deviceType;
 }
 
 bool isDeviceFile(const boost::filesystem::path &path) {
-    struct stat sb;
-    if (stat(path.c_str(), &sb) != 0) {
-        auto message = boost::format(
-                           "Failed to check if file %s is a device file. Stat "
-                           "failed: %s") %
-                       path % strerror(errno);
-        SARUS_THROW_ERROR(message.str());
+    try {
+        return isDeviceFile(FileInfo{path, STATX_TYPE});
+    } catch (const Error &e) {
+        auto message =
+            boost::format("Failed to check if file %s is a device file") %
+            path;
+        SARUS_RETHROW_ERROR(e, message.str());
     }
-    return S_ISBLK(sb.st_mode) || S_ISCHR(sb.st_mode);
+}
+
+bool isDeviceFile(const FileInfo &info) {
+    return isBlockDevice(info) || isCharacterDevice(info);
 }
 
 bool isBlockDevice(const boost::filesystem::path &path) {
-    struct stat sb;
-    if (stat(path.c_str(), &sb) != 0) {
-        auto message = boost::format(
-                           "Failed to check if file %s is a block device. Stat "
-                           "failed: %s") %
-                       path % strerror(errno);
-        SARUS_THROW_ERROR(message.str());
+    try {
+        return isBlockDevice(FileInfo{path, STATX_TYPE});
+    } catch (const Error &e) {
+        auto message =
+            boost::format("Failed to check if file %s is a block device") %
+            path;
+        SARUS_RETHROW_ERROR(e, message.str());
     }
-    return S_ISBLK(sb.st_mode);
+}
+
+bool isBlockDevice(const FileInfo &info) {
+    return S_ISBLK(info.getFileType());
 }
 
 bool isCharacterDevice(const boost::filesystem::path &path) {
-    struct stat sb;
-    if (stat(path.c_str(), &sb) != 0) {
-        auto message = boost::format(
-                           "Failed to check if file %s is a charater "
-                           "device. Stat failed: %s") %
-                       path % strerror(errno);
-        SARUS_THROW_ERROR(message.str());
+    try {
+        return isCharacterDevice(FileInfo{path, STATX_TYPE});
+    } catch (const Error &e) {
+        auto message =
+            boost::format("Failed to check if file %s is a character device") %
+            path;
+        SARUS_RETHROW_ERROR(e, message.str());
     }
-    return S_ISCHR(sb.st_mode);
+}
+
+bool isCharacterDevice(const FileInfo &info) {
+    return S_ISCHR(info.getFileType());
 }
 
 bool isSymlink(const boost::filesystem::path &path) {
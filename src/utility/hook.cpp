@@ -13,6 +13,7 @@
 #include <cstring>
 #include <iostream>
 #include <istream>
+#include <string_view>
 
 #include <fcntl.h>
 #include <grp.h>
@@ -26,6 +27,7 @@
 #include <rapidjson/istreamwrapper.h>
 
 #include "libsarus/Error.hpp"
+#include "libsarus/FileView.hpp"
 #include "libsarus/utility/environment.hpp"
 #include "libsarus/utility/filesystem.hpp"
 #include "libsarus/utility/json.hpp"
@@ -191,12 +193,13 @@ findSubsystemMountPaths(const std::string &subsystemName,
             mountinfoPath % subsystemName,
         libsarus::LogLevel::DEBUG);
 
-    auto mountinfoText = filesystem::readFile(mountinfoPath);
-    auto mountinfoLines = std::vector<std::string>{};
-    boost::split(mountinfoLines, mountinfoText, boost::is_any_of("\n"));
+    // parse the lines in place, without copying them
+    auto mountinfo = FileView{mountinfoPath};
+    auto mountinfoLines = std::vector<std::string_view>{};
+    boost::split(mountinfoLines, mountinfo.view(), boost::is_any_of("\n"));
 
+    auto tokens = std::vector<std::string_view>{};
     for (const auto &line : mountinfoLines) {
-        auto tokens = std::vector<std::string>{};
         boost::split(tokens, line, boost::is_any_of(" "));
 
         if (tokens.size() < 10) {
@@ -235,7 +238,7 @@ findSubsystemMountPaths(const std::string &subsystemName,
                 subsystemName % mountPoint,
             libsarus::LogLevel::DEBUG);
         return std::tuple<boost::filesystem::path, boost::filesystem::path>{
-            mountRoot, mountPoint};
+            std::string{mountRoot}, std::string{mountPoint}};
     }
 
     auto message =
@@ -382,8 +385,11 @@ void whitelistDeviceInCgroup(const boost::filesystem::path &cgroupPath,
         libsarus::LogLevel::DEBUG);
 
     char deviceType;
+    dev_t deviceID;
     try {
-        deviceType = filesystem::getDeviceType(deviceFile);
+        auto deviceInfo = FileInfo{deviceFile, STATX_TYPE};
+        deviceType = filesystem::getDeviceType(deviceInfo);
+        deviceID = filesystem::getDeviceID(deviceInfo);
     } catch (const libsarus::Error &e) {
         auto message =
             boost::format("Failed to whitelist %s: not a valid device file") %
@@ -391,7 +397,6 @@ void whitelistDeviceInCgroup(const boost::filesystem::path &cgroupPath,
         SARUS_RETHROW_ERROR(e, message.str());
     }
 
-    auto deviceID = filesystem::getDeviceID(deviceFile);
     auto entry = boost::format("%c %u:%u rw") % deviceType % major(deviceID) %
                  minor(deviceID);
     hook::logMessage(boost::format("Whitelist entry: %s") % entry.str(),
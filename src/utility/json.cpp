@@ -21,6 +21,7 @@
 #include <rapidjson/writer.h>
 
 #include "libsarus/Error.hpp"
+#include "libsarus/FileView.hpp"
 #include "libsarus/utility/filesystem.hpp"
 #include "libsarus/utility/logging.hpp"
 
@@ -62,8 +63,9 @@ rapidjson::Document parse(const std::string &string) {
 }
 
 rapidjson::Document read(const boost::filesystem::path &filename) {
-    std::ifstream ifs(filename.string());
-    auto json = parseStream(ifs);
+    auto file = FileView{filename};
+    auto json = rapidjson::Document{};
+    json.Parse(file.view().data(), file.view().size());
     if (json.HasParseError()) {
         auto message =
             boost::format(
@@ -182,6 +184,24 @@ void write(const rapidjson::Value &json,
     }
 }
 
+/**
+ * Adds the writing of a JSON file to a batch of atomic writes, which replaces
+ * the file once committed.
+ */
+void write(const rapidjson::Value &json,
+           const boost::filesystem::path &filename, AtomicWriteBatch &batch) {
+    try {
+        rapidjson::StringBuffer buffer;
+        rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+        writer.SetIndent(' ', 3);
+        json.Accept(writer);
+        batch.add(filename, {buffer.GetString(), buffer.GetSize()});
+    } catch (const std::exception &e) {
+        auto message = boost::format("Failed to write JSON to %s") % filename;
+        SARUS_RETHROW_ERROR(e, message.str());
+    }
+}
+
 std::string serialize(const rapidjson::Value &json) {
     namespace rj = rapidjson;
     rj::StringBuffer buffer;
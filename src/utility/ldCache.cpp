@@ -0,0 +1,586 @@
+/*
+ * Sarus
+ *
+ * Copyright (c) 2018-2023, ETH Zurich. All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+#include "libsarus/utility/ldCache.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <boost/endian/conversion.hpp>
+#include <boost/format.hpp>
+
+#include "libsarus/Error.hpp"
+#include "libsarus/MappedFile.hpp"
+#include "libsarus/utility/elf.hpp"
+#include "libsarus/utility/filesystem.hpp"
+#include "libsarus/utility/logging.hpp"
+
+/**
+ * Utility functions for the dynamic linker's cache (ld.so.cache)
+ *
+ * The on-disk layout mirrors the one defined by glibc (sysdeps/generic/
+ * dl-cache.h). A cache file can be in the old format ("ld.so-1.7.0"), in the
+ * new format ("glibc-ld.so.cache1.1") or in the compat format, i.e. an old
+ * format cache immediately followed by a new format one. When available, the
+ * new format is used, as done by the dynamic linker.
+ */
+
+namespace libsarus {
+namespace ldcache {
+
+namespace {
+
+constexpr char oldMagic[] = "ld.so-1.7.0";
+constexpr char newMagic[] = "glibc-ld.so.cache";
+constexpr char newVersion[] = "1.1";
+
+struct OldHeader {
+    char magic[sizeof(oldMagic) - 1];
+    uint32_t nlibs;
+};
+
+struct OldEntry {
+    int32_t flags;
+    uint32_t key;
+    uint32_t value;
+};
+
+struct NewHeader {
+    char magic[sizeof(newMagic) - 1];
+    char version[sizeof(newVersion) - 1];
+    uint32_t nlibs;
+    uint32_t lenStrings;
+    uint8_t flags;
+    uint8_t padding[3];
+    uint32_t extensionOffset;
+    uint32_t unused[3];
+};
+
+struct NewEntry {
+    int32_t flags;
+    uint32_t key;
+    uint32_t value;
+    uint32_t osversion;
+    uint64_t hwcap;
+};
+
+struct ExtensionHeader {
+    uint32_t magic;
+    uint32_t count;
+};
+
+struct ExtensionSection {
+    uint32_t tag;
+    uint32_t flags;
+    uint32_t offset;
+    uint32_t size;
+};
+
+constexpr uint32_t extensionMagic = 0xeaa42174;
+constexpr uint32_t extensionTagGlibcHwcaps = 1;
+
+// Values of the endianness bits (0-1) of the new header's flags
+constexpr uint8_t endianMask = 0x3;
+constexpr uint8_t endianUnset = 0;
+constexpr uint8_t endianLittle = 2;
+constexpr uint8_t endianBig = 3;
+
+static_assert(sizeof(OldHeader) == 16, "unexpected ld.so.cache layout");
+static_assert(sizeof(OldEntry) == 12, "unexpected ld.so.cache layout");
+static_assert(sizeof(NewHeader) == 48, "unexpected ld.so.cache layout");
+static_assert(sizeof(NewEntry) == 24, "unexpected ld.so.cache layout");
+
+// The new format cache is placed after the old format entries, aligned as
+// the new format header (which has the alignment of its entries)
+constexpr size_t newCacheAlignment = alignof(NewEntry);
+
+class CacheReader {
+  public:
+    CacheReader(const MappedFile &file) : file{file} {}
+
+    template <class T>
+    T read(uint64_t offset) const {
+        if (offset > file.size() || sizeof(T) > file.size() - offset) {
+            throwMalformed("offset out of bounds");
+        }
+        T value;
+        std::memcpy(&value, file.data() + offset, sizeof(T));
+        return value;
+    }
+
+    std::string readString(uint64_t offset) const {
+        if (offset >= file.size()) {
+            throwMalformed("string offset out of bounds");
+        }
+        const auto *begin =
+            reinterpret_cast<const char *>(file.data() + offset);
+        const auto *end = static_cast<const char *>(
+            std::memchr(begin, '\0', file.size() - offset));
+        if (end == nullptr) {
+            throwMalformed("unterminated string");
+        }
+        return std::string(begin, end);
+    }
+
+    bool hasMagic(uint64_t offset, const char *magic, size_t size) const {
+        return offset <= file.size() && size <= file.size() - offset &&
+               std::memcmp(file.data() + offset, magic, size) == 0;
+    }
+
+    [[noreturn]] void throwMalformed(const std::string &reason) const {
+        auto message = boost::format("Failed to parse %s: %s") %
+                       file.getPath() % reason;
+        SARUS_THROW_ERROR(message.str());
+    }
+
+  private:
+    const MappedFile &file;
+};
+
+}  // namespace
+
+static std::vector<std::string> readHwcapsSubdirectories(
+    const CacheReader &reader, uint64_t cacheOffset, const NewHeader &header) {
+    auto subdirectories = std::vector<std::string>{};
+
+    if (header.extensionOffset == 0) {
+        return subdirectories;
+    }
+
+    auto extensionOffset = cacheOffset + header.extensionOffset;
+    auto extension = reader.read<ExtensionHeader>(extensionOffset);
+    if (extension.magic != extensionMagic) {
+        return subdirectories;
+    }
+
+    for (uint32_t i = 0; i < extension.count; ++i) {
+        auto section = reader.read<ExtensionSection>(
+            extensionOffset + sizeof(ExtensionHeader) +
+            i * sizeof(ExtensionSection));
+        if (section.tag != extensionTagGlibcHwcaps) {
+            continue;
+        }
+        for (uint32_t j = 0; j < section.size / sizeof(uint32_t); ++j) {
+            auto stringOffset = reader.read<uint32_t>(
+                cacheOffset + section.offset + j * sizeof(uint32_t));
+            subdirectories.push_back(
+                reader.readString(cacheOffset + stringOffset));
+        }
+    }
+
+    return subdirectories;
+}
+
+static std::vector<Entry> readNewFormat(const CacheReader &reader,
+                                        uint64_t cacheOffset) {
+    auto header = reader.read<NewHeader>(cacheOffset);
+
+    auto endianness = header.flags & endianMask;
+    auto hostEndianness =
+        boost::endian::order::native == boost::endian::order::little
+            ? endianLittle
+            : endianBig;
+    if (endianness != endianUnset && endianness != hostEndianness) {
+        reader.throwMalformed("byte order doesn't match the host's");
+    }
+
+    auto hwcapsSubdirectories =
+        readHwcapsSubdirectories(reader, cacheOffset, header);
+
+    auto entries = std::vector<Entry>{};
+    entries.reserve(header.nlibs);
+    for (uint32_t i = 0; i < header.nlibs; ++i) {
+        auto raw = reader.read<NewEntry>(cacheOffset + sizeof(NewHeader) +
+                                         i * sizeof(NewEntry));
+        auto entry = Entry{};
+        entry.soname = reader.readString(cacheOffset + raw.key);
+        entry.path = reader.readString(cacheOffset + raw.value);
+        entry.flags = raw.flags;
+        entry.hwcap = raw.hwcap;
+        if ((raw.hwcap >> 32) == (hwcapExtensionFlag >> 32)) {
+            auto index = static_cast<uint32_t>(raw.hwcap);
+            if (index >= hwcapsSubdirectories.size()) {
+                reader.throwMalformed("invalid glibc-hwcaps index");
+            }
+            entry.hwcapsSubdirectory = hwcapsSubdirectories[index];
+        }
+        entries.push_back(std::move(entry));
+    }
+
+    return entries;
+}
+
+static std::vector<Entry> readOldFormat(const CacheReader &reader,
+                                        const OldHeader &header) {
+    // string offsets are relative to the end of the entries array
+    auto stringsOffset = sizeof(OldHeader) + header.nlibs * sizeof(OldEntry);
+
+    auto entries = std::vector<Entry>{};
+    entries.reserve(header.nlibs);
+    for (uint32_t i = 0; i < header.nlibs; ++i) {
+        auto raw =
+            reader.read<OldEntry>(sizeof(OldHeader) + i * sizeof(OldEntry));
+        auto entry = Entry{};
+        entry.soname = reader.readString(stringsOffset + raw.key);
+        entry.path = reader.readString(stringsOffset + raw.value);
+        entry.flags = raw.flags;
+        entries.push_back(std::move(entry));
+    }
+
+    return entries;
+}
+
+boost::filesystem::path getCachePath(const boost::filesystem::path &rootDir) {
+    return rootDir / "etc/ld.so.cache";
+}
+
+/**
+ * Reads the entries of the given ld.so.cache file, in the same order in which
+ * they are stored (and looked up by the dynamic linker).
+ */
+std::vector<Entry> read(const boost::filesystem::path &cacheFile) {
+    auto file = MappedFile{cacheFile};
+    auto reader = CacheReader{file};
+
+    if (reader.hasMagic(0, newMagic, sizeof(newMagic) - 1)) {
+        if (!reader.hasMagic(sizeof(newMagic) - 1, newVersion,
+                             sizeof(newVersion) - 1)) {
+            reader.throwMalformed("unsupported cache version");
+        }
+        return readNewFormat(reader, 0);
+    }
+
+    if (reader.hasMagic(0, oldMagic, sizeof(oldMagic) - 1)) {
+        auto header = reader.read<OldHeader>(0);
+        auto newCacheOffset =
+            (sizeof(OldHeader) + header.nlibs * sizeof(OldEntry) +
+             newCacheAlignment - 1) &
+            ~(newCacheAlignment - 1);
+        if (reader.hasMagic(newCacheOffset, newMagic, sizeof(newMagic) - 1) &&
+            reader.hasMagic(newCacheOffset + sizeof(newMagic) - 1, newVersion,
+                            sizeof(newVersion) - 1)) {
+            return readNewFormat(reader, newCacheOffset);
+        }
+        return readOldFormat(reader, header);
+    }
+
+    reader.throwMalformed("unrecognized cache format");
+}
+
+// Port of glibc's _dl_cache_libcmp: compares library names, comparing
+// sequences of digits by numeric value (e.g. libfoo.so.10 > libfoo.so.9)
+static int compareLibraryNames(const std::string &lhs, const std::string &rhs) {
+    const auto *p1 = lhs.c_str();
+    const auto *p2 = rhs.c_str();
+    auto isDigit = [](char c) { return c >= '0' && c <= '9'; };
+
+    while (*p1 != '\0') {
+        if (isDigit(*p1)) {
+            if (!isDigit(*p2)) {
+                return 1;
+            }
+            uint64_t value1 = 0, value2 = 0;
+            while (isDigit(*p1)) {
+                value1 = value1 * 10 + (*p1++ - '0');
+            }
+            while (isDigit(*p2)) {
+                value2 = value2 * 10 + (*p2++ - '0');
+            }
+            if (value1 != value2) {
+                return value1 < value2 ? -1 : 1;
+            }
+        } else if (isDigit(*p2)) {
+            return -1;
+        } else if (*p1 != *p2) {
+            return *p1 - *p2;
+        } else {
+            ++p1;
+            ++p2;
+        }
+    }
+    return *p1 - *p2;
+}
+
+// Order of the entries expected by the dynamic linker, which performs a
+// binary search on the library names (see glibc's elf/cache.c): names in
+// reverse order, then flags in reverse order, then glibc-hwcaps entries
+// before regular entries, then most specific hwcap first
+static bool isOrderedBefore(const Entry &lhs, const Entry &rhs) {
+    auto comparison = compareLibraryNames(rhs.soname, lhs.soname);
+    if (comparison != 0) {
+        return comparison < 0;
+    }
+    if (lhs.flags != rhs.flags) {
+        return lhs.flags > rhs.flags;
+    }
+    if (lhs.hwcapsSubdirectory.has_value() !=
+        rhs.hwcapsSubdirectory.has_value()) {
+        return lhs.hwcapsSubdirectory.has_value();
+    }
+    if (lhs.hwcapsSubdirectory) {
+        return *lhs.hwcapsSubdirectory < *rhs.hwcapsSubdirectory;
+    }
+    return lhs.hwcap > rhs.hwcap;
+}
+
+static int32_t getFlags(const elf::Info &info,
+                        const boost::filesystem::path &lib) {
+    // as ldconfig, mark 32-bit libraries as glibc libraries only if they
+    // are linked against it (the dynamic linker accepts both flags)
+    if (info.elfClass == ELFCLASS32) {
+        auto isLinkedToGlibc =
+            std::find(info.needed.cbegin(), info.needed.cend(), "libc.so.6") !=
+            info.needed.cend();
+        return isLinkedToGlibc ? flagElfLibc6 : flagElf;
+    }
+    if (info.machine == EM_X86_64) {
+        return flagElfLibc6 | flagX8664Lib64;
+    }
+    if (info.machine == EM_AARCH64) {
+        return flagElfLibc6 | flagAarch64Lib64;
+    }
+    auto message =
+        boost::format("Failed to create ld.so.cache entry for %s: unsupported "
+                      "ELF machine %d") %
+        lib % info.machine;
+    SARUS_THROW_ERROR(message.str());
+}
+
+/**
+ * Creates the cache entry of the given library (path within the root
+ * directory), from the SONAME and architecture in its ELF metadata.
+ */
+Entry makeEntry(const boost::filesystem::path &lib,
+                const boost::filesystem::path &rootDir) {
+    auto realPath = filesystem::appendPathsWithinRootfs(rootDir, "/", lib);
+    auto info = elf::readInfo(rootDir / realPath);
+
+    auto entry = Entry{};
+    entry.soname = info.soname ? *info.soname : lib.filename().string();
+    entry.path = lib;
+    entry.flags = getFlags(info, lib);
+    return entry;
+}
+
+/**
+ * Creates the cache entries of the shared libraries in the given directories
+ * (paths within the root directory), as ldconfig would, but without creating
+ * or updating any symlink. The libraries of a directory are grouped by SONAME
+ * and each group results in one entry, which points to the file named as the
+ * SONAME if it exists. Files which are not ELF shared libraries for a
+ * supported architecture are skipped.
+ */
+std::vector<Entry> scanDirectories(
+    const std::vector<boost::filesystem::path> &directories,
+    const boost::filesystem::path &rootDir) {
+    auto entries = std::vector<Entry>{};
+
+    for (const auto &directory : directories) {
+        auto realDirectory =
+            filesystem::appendPathsWithinRootfs(rootDir, "/", directory);
+        if (!boost::filesystem::is_directory(rootDir / realDirectory)) {
+            continue;
+        }
+
+        auto filenames = std::vector<std::string>{};
+        for (const auto &file : boost::filesystem::directory_iterator(
+                 rootDir / realDirectory)) {
+            auto filename = file.path().filename().string();
+            if (filesystem::isSharedLib(file.path())) {
+                filenames.push_back(std::move(filename));
+            }
+        }
+        // newest versions first, in case no file is named as the SONAME
+        std::sort(filenames.begin(), filenames.end(),
+                  [](const std::string &lhs, const std::string &rhs) {
+                      return compareLibraryNames(lhs, rhs) > 0;
+                  });
+
+        auto entryIndexBySoname = std::unordered_map<std::string, size_t>{};
+        for (const auto &filename : filenames) {
+            auto entry = Entry{};
+            try {
+                entry = makeEntry(directory / filename, rootDir);
+            } catch (const Error &e) {
+                auto message =
+                    boost::format("Skipping %s while creating ld.so.cache "
+                                  "entries: %s") %
+                    (directory / filename) % e.what();
+                logMessage(message.str(), LogLevel::DEBUG);
+                continue;
+            }
+
+            auto it = entryIndexBySoname.find(entry.soname);
+            if (it == entryIndexBySoname.cend()) {
+                entryIndexBySoname[entry.soname] = entries.size();
+                entries.push_back(std::move(entry));
+            } else if (filename == entry.soname) {
+                entries[it->second] = std::move(entry);
+            }
+        }
+    }
+
+    return entries;
+}
+
+/**
+ * Writes a cache file in the new format with the given entries. The entries
+ * are sorted as expected by the dynamic linker; entries that compare equal
+ * keep their relative order, i.e. earlier entries take precedence. The file is
+ * written to a temporary sibling which then atomically replaces the cache.
+ */
+void write(const boost::filesystem::path &cacheFile,
+           const std::vector<Entry> &entries) {
+    auto sortedEntries = entries;
+    std::stable_sort(sortedEntries.begin(), sortedEntries.end(),
+                     isOrderedBefore);
+
+    auto stringsOffset =
+        sizeof(NewHeader) + sortedEntries.size() * sizeof(NewEntry);
+    auto strings = std::string{};
+    auto stringOffsets = std::unordered_map<std::string, uint32_t>{};
+    auto addString = [&](const std::string &s) {
+        auto it = stringOffsets.find(s);
+        if (it != stringOffsets.cend()) {
+            return it->second;
+        }
+        auto offset = static_cast<uint32_t>(stringsOffset + strings.size());
+        strings.append(s);
+        strings.push_back('\0');
+        stringOffsets.emplace(s, offset);
+        return offset;
+    };
+
+    auto hwcapsSubdirectories = std::vector<std::string>{};
+    auto hwcapsIndices = std::unordered_map<std::string, uint32_t>{};
+    auto rawEntries = std::vector<NewEntry>{};
+    rawEntries.reserve(sortedEntries.size());
+    for (const auto &entry : sortedEntries) {
+        auto raw = NewEntry{};
+        raw.flags = entry.flags;
+        raw.key = addString(entry.soname);
+        raw.value = addString(entry.path.string());
+        raw.osversion = 0;
+        raw.hwcap = entry.hwcap;
+        if (entry.hwcapsSubdirectory) {
+            auto it = hwcapsIndices.find(*entry.hwcapsSubdirectory);
+            if (it == hwcapsIndices.cend()) {
+                it = hwcapsIndices
+                         .emplace(*entry.hwcapsSubdirectory,
+                                  hwcapsSubdirectories.size())
+                         .first;
+                hwcapsSubdirectories.push_back(*entry.hwcapsSubdirectory);
+            }
+            raw.hwcap = hwcapExtensionFlag | it->second;
+        }
+        rawEntries.push_back(raw);
+    }
+
+    auto hwcapsStringOffsets = std::vector<uint32_t>{};
+    for (const auto &subdirectory : hwcapsSubdirectories) {
+        hwcapsStringOffsets.push_back(addString(subdirectory));
+    }
+
+    auto header = NewHeader{};
+    std::memcpy(header.magic, newMagic, sizeof(header.magic));
+    std::memcpy(header.version, newVersion, sizeof(header.version));
+    header.nlibs = rawEntries.size();
+    header.lenStrings = strings.size();
+    header.flags = boost::endian::order::native == boost::endian::order::little
+                       ? endianLittle
+                       : endianBig;
+
+    auto extension = std::string{};
+    if (!hwcapsSubdirectories.empty()) {
+        // the extension directory is 4-byte aligned
+        auto padding = (4 - (stringsOffset + strings.size()) % 4) % 4;
+        header.extensionOffset = stringsOffset + strings.size() + padding;
+        auto extensionHeader = ExtensionHeader{extensionMagic, 1};
+        auto section = ExtensionSection{
+            extensionTagGlibcHwcaps, 0,
+            static_cast<uint32_t>(header.extensionOffset +
+                                  sizeof(ExtensionHeader) +
+                                  sizeof(ExtensionSection)),
+            static_cast<uint32_t>(hwcapsStringOffsets.size() *
+                                  sizeof(uint32_t))};
+        extension.append(padding, '\0');
+        extension.append(reinterpret_cast<const char *>(&extensionHeader),
+                         sizeof(extensionHeader));
+        extension.append(reinterpret_cast<const char *>(&section),
+                         sizeof(section));
+        extension.append(
+            reinterpret_cast<const char *>(hwcapsStringOffsets.data()),
+            hwcapsStringOffsets.size() * sizeof(uint32_t));
+    }
+
+    auto temporaryFile = boost::filesystem::path{};
+    try {
+        filesystem::createFoldersIfNecessary(cacheFile.parent_path());
+        temporaryFile = filesystem::createUniqueFile(cacheFile).path;
+        auto ofs = std::ofstream{temporaryFile.string(), std::ios::binary};
+        ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        ofs.write(reinterpret_cast<const char *>(rawEntries.data()),
+                  rawEntries.size() * sizeof(NewEntry));
+        ofs.write(strings.data(), strings.size());
+        ofs.write(extension.data(), extension.size());
+        ofs.close();
+        if (!ofs) {
+            auto message = boost::format("Failed to write %s") % temporaryFile;
+            SARUS_THROW_ERROR(message.str());
+        }
+        boost::filesystem::permissions(temporaryFile,
+                                       boost::filesystem::owner_read |
+                                           boost::filesystem::owner_write |
+                                           boost::filesystem::group_read |
+                                           boost::filesystem::others_read);
+        boost::filesystem::rename(temporaryFile, cacheFile);
+    } catch (const std::exception &e) {
+        boost::system::error_code ec;
+        boost::filesystem::remove(temporaryFile, ec);
+        auto message = boost::format("Failed to write %s") % cacheFile;
+        SARUS_RETHROW_ERROR(e, message.str());
+    }
+}
+
+/**
+ * Adds entries to an existing cache file (in any format), e.g. the entries of
+ * libraries injected into a container, without crawling the library
+ * directories again. The new entries take precedence over existing entries
+ * with the same SONAME and flags; existing entries identical to a new entry
+ * are dropped. If the cache file doesn't exist, it is created.
+ */
+void append(const boost::filesystem::path &cacheFile,
+            const std::vector<Entry> &entries) {
+    auto makeKey = [](const Entry &entry) {
+        return entry.soname + '\0' + entry.path.string() + '\0' +
+               std::to_string(entry.flags);
+    };
+    auto newEntryKeys = std::unordered_set<std::string>{};
+    for (const auto &entry : entries) {
+        newEntryKeys.insert(makeKey(entry));
+    }
+
+    auto allEntries = entries;
+    if (boost::filesystem::exists(cacheFile)) {
+        for (auto &existingEntry : read(cacheFile)) {
+            if (newEntryKeys.find(makeKey(existingEntry)) ==
+                newEntryKeys.cend()) {
+                allEntries.push_back(std::move(existingEntry));
+            }
+        }
+    }
+    write(cacheFile, allEntries);
+}
+
+}  // namespace ldcache
+}  // namespace libsarus
@@ -14,9 +14,21 @@
 
 #include "libsarus/utility/mount.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <future>
+
+#include <endian.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <linux/loop.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 #include <boost/format.hpp>
+#include <boost/optional.hpp>
 
 #include "libsarus/CLIArguments.hpp"
 #include "libsarus/Error.hpp"
@@ -61,6 +73,20 @@ boost::filesystem::path getValidatedMountSource(
 boost::filesystem::path getValidatedMountDestination(
     const boost::filesystem::path &destination,
     const boost::filesystem::path &rootfsDir) {
+    return getValidatedMountDestination(destination, rootfsDir,
+                                        getAllowedDevices(rootfsDir));
+}
+
+/**
+ * Validates the mount destination as the overload above, against the devices
+ * returned by a previous call to getAllowedDevices. This saves the stats of
+ * the allowed devices when validating multiple destinations in a rootfs whose
+ * mounts don't change meanwhile.
+ */
+boost::filesystem::path getValidatedMountDestination(
+    const boost::filesystem::path &destination,
+    const boost::filesystem::path &rootfsDir,
+    const std::vector<dev_t> &allowedDevices) {
     logMessage(boost::format("Validating mount destination: %s") % destination,
                LogLevel::DEBUG);
 
@@ -71,11 +97,14 @@ boost::filesystem::path getValidatedMountDestination(
     if (rootfsDir.is_relative()) {
         SARUS_THROW_ERROR("Internal error: rootfsDir is not an absolute path");
     }
-    auto destinationReal =
-        rootfsDir / filesystem::realpathWithinRootfs(rootfsDir, destination);
+    auto destinationWithinRootfs =
+        filesystem::openWithinRootfs(rootfsDir, destination);
+    auto destinationReal = rootfsDir / destinationWithinRootfs.path;
 
     /* If the destination does not exist, check its parents */
-    if (!boost::filesystem::exists(destinationReal)) {
+    struct stat destinationStat;
+    if (!destinationWithinRootfs.fd.isValid() ||
+        fstat(destinationWithinRootfs.fd.get(), &destinationStat) != 0) {
         /* Search the first existing parent folder and check that it is on the
            device where we are authorized to create stuff */
         boost::optional<boost::filesystem::path> deepestExistingFolder;
@@ -100,7 +129,7 @@ boost::filesystem::path getValidatedMountDestination(
                        *deepestExistingFolder,
                    LogLevel::DEBUG);
 
-        if (!isPathOnAllowedDevice(*deepestExistingFolder, rootfsDir)) {
+        if (!isPathOnAllowedDevice(*deepestExistingFolder, allowedDevices)) {
             auto message = boost::format(
                                "Mount destination (%s) is not on a device "
                                "allowed for mounts") %
@@ -111,11 +140,11 @@ boost::filesystem::path getValidatedMountDestination(
     /* If destination exists, check it is on an allowed device */
     else {
         bool allowed;
-        if (boost::filesystem::is_directory(destinationReal)) {
-            allowed = isPathOnAllowedDevice(destinationReal, rootfsDir);
+        if (S_ISDIR(destinationStat.st_mode)) {
+            allowed = isPathOnAllowedDevice(destinationReal, allowedDevices);
         } else {
-            allowed =
-                isPathOnAllowedDevice(destinationReal.parent_path(), rootfsDir);
+            allowed = isPathOnAllowedDevice(destinationReal.parent_path(),
+                                            allowedDevices);
         }
         if (!allowed) {
             auto message = boost::format(
@@ -134,11 +163,25 @@ boost::filesystem::path getValidatedMountDestination(
 
 bool isPathOnAllowedDevice(const boost::filesystem::path &path,
                            const boost::filesystem::path &rootfsDir) {
+    return isPathOnAllowedDevice(path, getAllowedDevices(rootfsDir));
+}
+
+bool isPathOnAllowedDevice(const boost::filesystem::path &path,
+                           const std::vector<dev_t> &allowedDevices) {
     auto pathDevice = getDevice(path);
     logMessage(
         boost::format("Target device for path %s is: %d") % path % pathDevice,
         LogLevel::DEBUG);
+    return std::find(allowedDevices.cbegin(), allowedDevices.cend(),
+                     pathDevice) != allowedDevices.cend();
+}
 
+/**
+ * Returns the devices where mount points can be created: the devices of /tmp,
+ * of the rootfs and of its /dev folder, and of the lower layer of the rootfs'
+ * overlay (if any).
+ */
+std::vector<dev_t> getAllowedDevices(const boost::filesystem::path &rootfsDir) {
     auto allowedDevices = std::vector<dev_t>{};
     allowedDevices.reserve(4);
     logMessage("Allowed devices are:", LogLevel::DEBUG);
@@ -170,11 +213,7 @@ bool isPathOnAllowedDevice(const boost::filesystem::path &path,
         logMessage(boost::format("%d: rootfs-lower (%s)") % dev % lowerLayer,
                    LogLevel::DEBUG);
     }
-
-    bool isPathOnAllowedDevice =
-        std::find(allowedDevices.cbegin(), allowedDevices.cend(), pathDevice) !=
-        allowedDevices.cend();
-    return isPathOnAllowedDevice;
+    return allowedDevices;
 }
 
 dev_t getDevice(const boost::filesystem::path &path) {
@@ -253,11 +292,138 @@ void validatedBindMount(const boost::filesystem::path &source,
     }
 }
 
+// Set when the kernel turns out not to support the mount API of
+// open_tree(2), move_mount(2) and mount_setattr(2), i.e. Linux < 5.12
+static std::atomic<bool> isNewMountApiUnsupported{false};
+
+// The flags of the new mount API, which glibc < 2.36 doesn't define (and
+// <linux/mount.h> conflicts with <sys/mount.h> there)
+#ifndef OPEN_TREE_CLONE
+#define OPEN_TREE_CLONE 1
+#endif
+#ifndef OPEN_TREE_CLOEXEC
+#define OPEN_TREE_CLOEXEC O_CLOEXEC
+#endif
+#ifndef AT_RECURSIVE
+#define AT_RECURSIVE 0x8000
+#endif
+#ifndef MOVE_MOUNT_F_EMPTY_PATH
+#define MOVE_MOUNT_F_EMPTY_PATH 0x00000004
+#endif
+#ifndef MOVE_MOUNT_T_SYMLINKS
+#define MOVE_MOUNT_T_SYMLINKS 0x00000010
+#endif
+#ifndef MOVE_MOUNT_T_AUTOMOUNTS
+#define MOVE_MOUNT_T_AUTOMOUNTS 0x00000020
+#endif
+#ifndef MOUNT_ATTR_RDONLY
+#define MOUNT_ATTR_RDONLY 0x00000001
+#endif
+#ifndef MOUNT_ATTR_NOSUID
+#define MOUNT_ATTR_NOSUID 0x00000002
+#endif
+
+namespace {
+
+// The argument of mount_setattr(2), i.e. struct mount_attr of the kernel
+struct MountAttributes {
+    uint64_t attr_set;
+    uint64_t attr_clr;
+    uint64_t propagation;
+    uint64_t userns_fd;
+};
+
+}  // namespace
+
+// Bind mounts with the new mount API. The source tree is cloned with
+// open_tree(2) and made read-only (if requested) and nosuid with one
+// recursive mount_setattr(2) while still detached, so that the attributes
+// apply to all the submounts and the mount is never visible without them.
+// The tree is attached with move_mount(2), then made private: attaching to a
+// shared mount would make the tree shared again. Returns false, without side
+// effects, if the kernel doesn't support the API.
+static bool bindMountWithNewMountApi(const boost::filesystem::path &from,
+                                     const boost::filesystem::path &to,
+                                     unsigned long flags) {
+#if defined(SYS_open_tree) && defined(SYS_move_mount) && \
+    defined(SYS_mount_setattr)
+    if (isNewMountApiUnsupported) {
+        return false;
+    }
+
+    auto tree = FileDescriptor{static_cast<int>(
+        syscall(SYS_open_tree, AT_FDCWD, from.c_str(),
+                OPEN_TREE_CLONE | OPEN_TREE_CLOEXEC | AT_RECURSIVE))};
+    if (!tree.isValid() && errno == ENOSYS) {
+        isNewMountApiUnsupported = true;
+        return false;
+    }
+    if (!tree.isValid()) {
+        auto message =
+            boost::format("Failed to bind mount %s -> %s (error: %s)") % from %
+            to % strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
+
+    auto attributes = MountAttributes{};
+    attributes.attr_set = MOUNT_ATTR_NOSUID;
+    if (flags & MS_RDONLY) {
+        attributes.attr_set |= MOUNT_ATTR_RDONLY;
+    }
+    if (syscall(SYS_mount_setattr, tree.get(), "", AT_EMPTY_PATH | AT_RECURSIVE,
+                &attributes, sizeof(attributes)) != 0) {
+        if (errno == ENOSYS) {
+            isNewMountApiUnsupported = true;
+            return false;
+        }
+        auto message =
+            boost::format("Failed to re-bind mount %s -> %s (error: %s)") %
+            from % to % strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
+
+    // like mount(2), follow the symlinks and automounts of the destination
+    if (syscall(SYS_move_mount, tree.get(), "", AT_FDCWD, to.c_str(),
+                MOVE_MOUNT_F_EMPTY_PATH | MOVE_MOUNT_T_SYMLINKS |
+                    MOVE_MOUNT_T_AUTOMOUNTS) != 0) {
+        auto message =
+            boost::format("Failed to bind mount %s -> %s (error: %s)") % from %
+            to % strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
+
+    attributes = MountAttributes{};
+    attributes.propagation = MS_PRIVATE;
+    if (syscall(SYS_mount_setattr, tree.get(), "", AT_EMPTY_PATH | AT_RECURSIVE,
+                &attributes, sizeof(attributes)) != 0) {
+        auto message =
+            boost::format("Failed to remount %s as non-shared (error: %s)") %
+            to % strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * Recursively bind mounts 'from' on 'to' as private and nosuid, and read-only
+ * if 'flags' contains MS_RDONLY.
+ *
+ * On Linux >= 5.12, the mount attributes also apply to the submounts of
+ * 'from'. Older kernels fall back to mount(2) with MS_REMOUNT, which only
+ * changes the attributes of the topmost mount.
+ */
 void bindMount(const boost::filesystem::path &from,
                const boost::filesystem::path &to, unsigned long flags) {
     logMessage(boost::format{"Bind mounting %s -> %s"} % from % to,
                LogLevel::DEBUG);
 
+    if (bindMountWithNewMountApi(from, to, flags)) {
+        return;
+    }
+
     unsigned long flagsForBindMount = MS_BIND | MS_REC;
     unsigned long flagsForRemount = MS_REMOUNT | MS_BIND | MS_NOSUID | MS_REC;
     unsigned long flagsForPropagationRemount = MS_PRIVATE | MS_REC;
@@ -293,8 +459,130 @@ void bindMount(const boost::filesystem::path &from,
     }
 }
 
+// Set when the kernel turns out not to support the LOOP_CONFIGURE ioctl, i.e.
+// Linux < 5.8, or when there is no loop control device
+static std::atomic<bool> isLoopConfigureUnsupported{false};
+
+namespace {
+
+struct LoopDevice {
+    FileDescriptor fd;
+    boost::filesystem::path path;
+};
+
+}  // namespace
+
+// Attaches 'image' to a free loop device, read-only. The loop device reads
+// the image through its page cache, which is shared by the loop devices of
+// the same image and holds the pages of prefetchSquashfs. The loop device is
+// detached automatically once its descriptor is closed and no mount uses it
+// anymore. Returns boost::none if loop devices cannot be configured with
+// LOOP_CONFIGURE.
+static boost::optional<LoopDevice> attachLoopDevice(
+    const boost::filesystem::path &image) {
+    if (isLoopConfigureUnsupported) {
+        return boost::none;
+    }
+
+    auto controlFd =
+        FileDescriptor{open("/dev/loop-control", O_RDWR | O_CLOEXEC)};
+    if (!controlFd.isValid()) {
+        logMessage(boost::format("Failed to open /dev/loop-control: %s") %
+                       strerror(errno),
+                   LogLevel::DEBUG);
+        isLoopConfigureUnsupported = true;
+        return boost::none;
+    }
+    auto imageFd = FileDescriptor{open(image.c_str(), O_RDONLY | O_CLOEXEC)};
+    if (!imageFd.isValid()) {
+        auto message =
+            boost::format("Failed to open %s: %s") % image % strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
+
+    auto config = loop_config{};
+    config.fd = imageFd.get();
+    config.info.lo_flags = LO_FLAGS_READ_ONLY | LO_FLAGS_AUTOCLEAR;
+    strncpy(reinterpret_cast<char *>(config.info.lo_file_name), image.c_str(),
+            LO_NAME_SIZE - 1);
+
+    // LOOP_CTL_GET_FREE returns the same device to concurrent callers: the
+    // ones which lose the race to configure it get EBUSY and try again
+    const int maxAttempts = 64;
+    for (int attempt = 0; attempt < maxAttempts; ++attempt) {
+        auto number = ioctl(controlFd.get(), LOOP_CTL_GET_FREE);
+        if (number < 0) {
+            auto message =
+                boost::format("Failed to get a free loop device: %s") %
+                strerror(errno);
+            SARUS_THROW_ERROR(message.str());
+        }
+        auto device = LoopDevice{
+            FileDescriptor{}, "/dev/loop" + std::to_string(number)};
+        device.fd.reset(open(device.path.c_str(), O_RDWR | O_CLOEXEC));
+        if (!device.fd.isValid()) {
+            auto message = boost::format("Failed to open %s: %s") %
+                           device.path % strerror(errno);
+            SARUS_THROW_ERROR(message.str());
+        }
+
+        if (ioctl(device.fd.get(), LOOP_CONFIGURE, &config) == 0) {
+            logMessage(boost::format("Attached %s to %s") % image % device.path,
+                       LogLevel::DEBUG);
+            return device;
+        }
+        if (errno == EBUSY || errno == EAGAIN) {
+            continue;
+        }
+        if (errno == EINVAL || errno == ENOTTY) {
+            logMessage("The kernel doesn't support the LOOP_CONFIGURE ioctl",
+                       LogLevel::DEBUG);
+            isLoopConfigureUnsupported = true;
+            return boost::none;
+        }
+        auto message = boost::format("Failed to attach %s to %s: %s") % image %
+                       device.path % strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
+
+    auto message = boost::format("Failed to attach %s to a loop device: all "
+                                 "the free loop devices were taken by other "
+                                 "processes in %d attempts") %
+                   image % maxAttempts;
+    SARUS_THROW_ERROR(message.str());
+}
+
+/**
+ * Mounts the squashfs 'image' on 'mountPoint', read-only, nosuid and nodev.
+ *
+ * The loop device is set up in-process with the LOOP_CONFIGURE ioctl and is
+ * detached automatically when the image is unmounted. Where LOOP_CONFIGURE
+ * is not available (Linux < 5.8), mount(8) sets up the loop device.
+ */
 void loopMountSquashfs(const boost::filesystem::path &image,
                        const boost::filesystem::path &mountPoint) {
+    try {
+        auto device = attachLoopDevice(image);
+        if (device) {
+            logMessage(boost::format{"Mounting %s (%s) on %s"} % device->path %
+                           image % mountPoint,
+                       LogLevel::DEBUG);
+            if (::mount(device->path.c_str(), mountPoint.c_str(), "squashfs",
+                        MS_RDONLY | MS_NOSUID | MS_NODEV, NULL) != 0) {
+                auto message = boost::format("Failed to mount %s: %s") %
+                               device->path % strerror(errno);
+                SARUS_THROW_ERROR(message.str());
+            }
+            // closing the descriptor leaves the mount as the only user of the
+            // loop device, which is detached on unmount
+            return;
+        }
+    } catch (Error &e) {
+        auto message =
+            boost::format("Failed to loop mount %s on %s") % image % mountPoint;
+        SARUS_RETHROW_ERROR(e, message.str());
+    }
+
     auto command = std::string{"mount"};
     command += " -n";
     command += " -o";
@@ -315,6 +603,147 @@ void loopMountSquashfs(const boost::filesystem::path &image,
     }
 }
 
+namespace {
+
+// Superblock of squashfs 4.0, stored little endian at the beginning of the
+// image (see Documentation/filesystems/squashfs.rst in the Linux sources)
+struct SquashfsSuperblock {
+    uint32_t magic;
+    uint32_t inodeCount;
+    uint32_t modificationTime;
+    uint32_t blockSize;
+    uint32_t fragmentCount;
+    uint16_t compressor;
+    uint16_t blockLog;
+    uint16_t flags;
+    uint16_t idCount;
+    uint16_t versionMajor;
+    uint16_t versionMinor;
+    uint64_t rootInode;
+    uint64_t bytesUsed;
+    uint64_t idTableStart;
+    uint64_t xattrIdTableStart;
+    uint64_t inodeTableStart;
+    uint64_t directoryTableStart;
+    uint64_t fragmentTableStart;
+    uint64_t exportTableStart;
+} __attribute__((packed));
+
+}  // namespace
+
+static constexpr uint32_t squashfsMagic = 0x73717368;
+
+// Asks the kernel to read the metadata tables of the squashfs 'image' into
+// the page cache
+static void adviseSquashfsMetadata(const boost::filesystem::path &image) {
+    auto fd = FileDescriptor{open(image.c_str(), O_RDONLY | O_CLOEXEC)};
+    if (!fd.isValid()) {
+        auto message =
+            boost::format("Failed to open %s: %s") % image % strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
+
+    // a short read leaves a zeroed superblock, which fails the validation
+    auto superblock = SquashfsSuperblock{};
+    struct stat sb;
+    if (pread(fd.get(), &superblock, sizeof(superblock), 0) < 0 ||
+        fstat(fd.get(), &sb) != 0) {
+        auto message =
+            boost::format("Failed to read the superblock of %s: %s") % image %
+            strerror(errno);
+        SARUS_THROW_ERROR(message.str());
+    }
+    // mksquashfs writes the metadata tables after the data blocks, up to the
+    // end of the image: prefetch from the start of the first table. The
+    // optional tables (e.g. without extended attributes) start at ~0.
+    auto bytesUsed = le64toh(superblock.bytesUsed);
+    auto tablesStart = bytesUsed;
+    for (uint64_t start :
+         {superblock.idTableStart, superblock.xattrIdTableStart,
+          superblock.inodeTableStart, superblock.directoryTableStart,
+          superblock.fragmentTableStart, superblock.exportTableStart}) {
+        start = le64toh(start);
+        if (start != ~uint64_t{0}) {
+            tablesStart = std::min(tablesStart, start);
+        }
+    }
+    if (le32toh(superblock.magic) != squashfsMagic ||
+        le16toh(superblock.versionMajor) != 4 ||
+        bytesUsed > uint64_t(sb.st_size) || tablesStart >= bytesUsed) {
+        auto message =
+            boost::format("Failed to prefetch %s: not a squashfs 4.0 image") %
+            image;
+        SARUS_THROW_ERROR(message.str());
+    }
+
+    auto length = bytesUsed - tablesStart;
+    logMessage(boost::format("Prefetching %d bytes of metadata tables of %s") %
+                   length % image,
+               LogLevel::DEBUG);
+    auto error =
+        posix_fadvise(fd.get(), tablesStart, length, POSIX_FADV_WILLNEED);
+    if (error != 0) {
+        auto message = boost::format("Failed to prefetch %s: %s") % image %
+                       strerror(error);
+        SARUS_THROW_ERROR(message.str());
+    }
+}
+
+// Asks the kernel to read the content of the files, relative to the root of
+// the mounted image, into the page cache. Missing files are skipped.
+static void adviseFiles(const boost::filesystem::path &mountPoint,
+                        const std::vector<boost::filesystem::path> &files) {
+    for (const auto &file : files) {
+        auto resolved = filesystem::openWithinRootfs(mountPoint, "/" / file);
+        if (!resolved.fd.isValid()) {
+            logMessage(boost::format("Not prefetching %s: no such file") %
+                           (mountPoint / resolved.path),
+                       LogLevel::DEBUG);
+            continue;
+        }
+        // 'resolved.path' is relative to the image: reopen the O_PATH
+        // descriptor to read the file of the image
+        auto procPath = "/proc/self/fd/" + std::to_string(resolved.fd.get());
+        auto fd = FileDescriptor{open(procPath.c_str(), O_RDONLY | O_CLOEXEC)};
+        if (!fd.isValid()) {
+            logMessage(boost::format("Not prefetching %s: %s") %
+                           (mountPoint / resolved.path) % strerror(errno),
+                       LogLevel::DEBUG);
+            continue;
+        }
+        posix_fadvise(fd.get(), 0, 0, POSIX_FADV_WILLNEED);
+    }
+}
+
+/**
+ * Prefetches the metadata tables (inode, directory, fragment, export, id and
+ * xattr tables) of the squashfs 'image' into the page cache, in a background
+ * thread, so that the first lookups in the mounted image don't stall on small
+ * random reads from the filesystem of the image (e.g. a parallel
+ * filesystem). The prefetch is meant to be started before loopMountSquashfs
+ * and to run while the rest of the container is set up; the returned future
+ * reports its outcome and its destructor waits for the prefetch to finish.
+ */
+std::future<void> prefetchSquashfs(const boost::filesystem::path &image) {
+    return std::async(std::launch::async,
+                      [image]() { adviseSquashfsMetadata(image); });
+}
+
+/**
+ * Prefetches the content of 'files' of the image mounted on 'mountPoint' into
+ * the page cache, in a background thread. The paths of the files are resolved
+ * within the mounted image; missing files are skipped. As for
+ * prefetchSquashfs, the destructor of the returned future waits for the
+ * prefetch to finish.
+ */
+std::future<void> prefetchSquashfsFiles(
+    const boost::filesystem::path &mountPoint,
+    const std::vector<boost::filesystem::path> &files) {
+    return std::async(std::launch::async, [mountPoint, files]() {
+        adviseFiles(mountPoint, files);
+    });
+}
+
 void mountOverlayfs(const boost::filesystem::path &lowerDir,
                     const boost::filesystem::path &upperDir,
                     const boost::filesystem::path &workDir,
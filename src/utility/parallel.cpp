@@ -0,0 +1,118 @@
+/*
+ * Sarus
+ *
+ * Copyright (c) 2018-2023, ETH Zurich. All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+#include "libsarus/utility/parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <sched.h>
+
+/**
+ * Utility functions for parallel execution
+ */
+
+namespace libsarus {
+namespace parallel {
+
+/**
+ * Returns the number of CPUs the calling process is allowed to run on, i.e.
+ * the CPU affinity as set by e.g. the workload manager, or 1 if it cannot be
+ * determined.
+ */
+unsigned int getDefaultNumberOfThreads() {
+    auto set = cpu_set_t{};
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &set) == 0) {
+        return std::max(CPU_COUNT(&set), 1);
+    }
+    return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+/**
+ * Returns the maximum number of workers (threads) executing 'count' tasks
+ * with forEachIndex and forEachIndexInWorkers.
+ */
+unsigned int getNumberOfWorkers(size_t count, unsigned int numberOfThreads) {
+    if (numberOfThreads == 0) {
+        numberOfThreads = getDefaultNumberOfThreads();
+    }
+    return static_cast<unsigned int>(std::min<size_t>(numberOfThreads, count));
+}
+
+/**
+ * Calls 'task' for each index in [0, count), distributing the indices among
+ * up to 'numberOfThreads' threads (0 means getDefaultNumberOfThreads()). The
+ * calling thread takes part in the work.
+ *
+ * All the tasks are executed even if some of them fail. Afterwards, the
+ * exception thrown by the failed task with the lowest index (if any) is
+ * rethrown in the calling thread, so that errors are deterministic regardless
+ * of the scheduling.
+ */
+void forEachIndex(size_t count, const std::function<void(size_t)> &task,
+                  unsigned int numberOfThreads) {
+    forEachIndexInWorkers(
+        count, [&task](size_t i, unsigned int) { task(i); }, numberOfThreads);
+}
+
+/**
+ * As forEachIndex, but also passes to 'task' the index of the worker executing
+ * it, in [0, getNumberOfWorkers(count, numberOfThreads)). The tasks of a
+ * worker run sequentially, hence they can share per-worker resources (e.g.
+ * buffers) without synchronization.
+ */
+void forEachIndexInWorkers(
+    size_t count, const std::function<void(size_t, unsigned int)> &task,
+    unsigned int numberOfThreads) {
+    numberOfThreads = getNumberOfWorkers(count, numberOfThreads);
+
+    auto errors = std::vector<std::exception_ptr>(count);
+    auto nextIndex = std::atomic<size_t>{0};
+
+    auto worker = [&](unsigned int workerIndex) {
+        for (auto i = nextIndex++; i < count; i = nextIndex++) {
+            try {
+                task(i, workerIndex);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        }
+    };
+
+    auto threads = std::vector<std::thread>{};
+    if (numberOfThreads > 1) {
+        threads.reserve(numberOfThreads - 1);
+        for (unsigned int i = 0; i < numberOfThreads - 1; ++i) {
+            try {
+                threads.emplace_back(worker, i + 1);
+            } catch (const std::system_error &) {
+                // e.g. thread limit reached: go on with fewer threads
+                break;
+            }
+        }
+    }
+    worker(0);
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    for (const auto &error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+}  // namespace parallel
+}  // namespace libsarus
@@ -10,14 +10,26 @@
 
 #include "libsarus/utility/sharedLibs.hpp"
 
+#include <algorithm>
+#include <cctype>
 #include <sstream>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <boost/algorithm/string.hpp>
+#include <boost/format.hpp>
 #include <boost/regex.hpp>
 
 #include "libsarus/Error.hpp"
+#include "libsarus/MappedFile.hpp"
+#include "libsarus/PathHash.hpp"
+#include "libsarus/RootfsResolver.hpp"
+#include "libsarus/utility/elf.hpp"
 #include "libsarus/utility/filesystem.hpp"
+#include "libsarus/utility/ldCache.hpp"
 #include "libsarus/utility/logging.hpp"
+#include "libsarus/utility/parallel.hpp"
 #include "libsarus/utility/process.hpp"
 
 /**
@@ -46,10 +58,33 @@ boost::filesystem::path getLinkerName(const boost::filesystem::path &path) {
     return filename;
 }
 
+/**
+ * Returns the libraries listed in the dynamic linker's cache of the given root
+ * directory. The cache file is read in-process; ldconfig is only executed as a
+ * fallback, i.e. when the cache file is missing or cannot be parsed.
+ */
 std::vector<boost::filesystem::path> getListFromDynamicLinker(
     const boost::filesystem::path &ldconfigPath,
     const boost::filesystem::path &rootDir) {
     auto libraries = std::vector<boost::filesystem::path>{};
+
+    auto cacheFile = ldcache::getCachePath(rootDir);
+    if (boost::filesystem::exists(cacheFile)) {
+        try {
+            for (auto &entry : ldcache::read(cacheFile)) {
+                libraries.push_back(std::move(entry.path));
+            }
+            return libraries;
+        } catch (const Error &e) {
+            auto message = boost::format(
+                               "Failed to read dynamic linker cache %s (%s). "
+                               "Falling back to %s.") %
+                           cacheFile % e.what() % ldconfigPath;
+            logMessage(message.str(), LogLevel::DEBUG);
+            libraries.clear();
+        }
+    }
+
     auto command =
         boost::format("%s -r %s -p") % ldconfigPath.string() % rootDir.string();
     auto output = process::executeCommand(command.str());
@@ -105,6 +140,16 @@ std::vector<std::string> parseAbi(const boost::filesystem::path &lib) {
 
 std::vector<std::string> resolveAbi(const boost::filesystem::path &lib,
                                     const boost::filesystem::path &rootDir) {
+    auto rootfsResolver = RootfsResolver{rootDir};
+    return resolveAbi(lib, rootfsResolver);
+}
+
+/**
+ * Resolves the ABI version of a library within the rootfs of the given
+ * resolver, sharing the lookups of the symlinks with other resolutions.
+ */
+std::vector<std::string> resolveAbi(const boost::filesystem::path &lib,
+                                    RootfsResolver &rootfsResolver) {
     if (!filesystem::isSharedLib(lib)) {
         auto message =
             boost::format{
@@ -116,8 +161,7 @@ std::vector<std::string> resolveAbi(const boost::filesystem::path &lib,
     auto longestAbiSoFar = std::vector<std::string>{};
 
     auto traversedSymlinks = std::vector<boost::filesystem::path>{};
-    auto libReal = filesystem::appendPathsWithinRootfs(rootDir, "/", lib,
-                                                       &traversedSymlinks);
+    auto libReal = rootfsResolver.resolve(lib, &traversedSymlinks);
     auto pathsToProcess = std::move(traversedSymlinks);
     pathsToProcess.push_back(std::move(libReal));
 
@@ -171,46 +215,574 @@ std::vector<std::string> resolveAbi(const boost::filesystem::path &lib,
     return longestAbiSoFar;
 }
 
-std::string getSoname(const boost::filesystem::path &path,
-                      const boost::filesystem::path &readelfPath) {
-    auto command = boost::format("%s -d %d") % readelfPath % path;
-    auto output = process::executeCommand(command.str());
+/**
+ * Resolves the ABI versions of multiple libraries, as resolveAbi() does for a
+ * single library. The resolution of the libraries is distributed among up to
+ * 'numberOfThreads' threads (0 means one per available CPU) and the symlinks
+ * traversed within the root directory are looked up only once for the whole
+ * batch. The results are returned in the same order as the input libraries.
+ */
+std::vector<std::vector<std::string>> resolveAbiBatch(
+    const std::vector<boost::filesystem::path> &libs,
+    const boost::filesystem::path &rootDir, unsigned int numberOfThreads) {
+    auto abis = std::vector<std::vector<std::string>>(libs.size());
+    auto rootfsResolver = RootfsResolver{rootDir};
+
+    parallel::forEachIndex(
+        libs.size(),
+        [&](size_t i) { abis[i] = resolveAbi(libs[i], rootfsResolver); },
+        numberOfThreads);
+
+    return abis;
+}
 
-    std::stringstream stream{output};
-    std::string line;
-    while (std::getline(stream, line)) {
-        boost::cmatch matches;
-        boost::regex re("^.* \\(SONAME\\) +Library soname: \\[(.*)\\]$");
-        if (boost::regex_match(line.c_str(), matches, re)) {
-            return matches[1];
+/**
+ * Returns whether a host library can replace a container library with the
+ * given ABI versions, i.e. whether the libraries have the same major version.
+ * A library without ABI version is only compatible with another library
+ * without ABI version.
+ */
+bool areAbiCompatible(const std::vector<std::string> &hostAbi,
+                      const std::vector<std::string> &containerAbi) {
+    if (hostAbi.empty() || containerAbi.empty()) {
+        return hostAbi.empty() && containerAbi.empty();
+    }
+    return hostAbi.front() == containerAbi.front();
+}
+
+// Compares ABI versions token by token. Numeric tokens are compared by value,
+// i.e. 1.10 is newer than 1.9.
+static int compareAbi(const std::vector<std::string> &lhs,
+                      const std::vector<std::string> &rhs) {
+    auto isNumber = [](const std::string &token) {
+        return !token.empty() &&
+               std::all_of(token.cbegin(), token.cend(),
+                           [](unsigned char c) { return std::isdigit(c); });
+    };
+    auto stripLeadingZeros = [](const std::string &token) {
+        auto pos = token.find_first_not_of('0');
+        return pos == std::string::npos ? std::string{} : token.substr(pos);
+    };
+
+    for (size_t i = 0; i < std::min(lhs.size(), rhs.size()); ++i) {
+        auto comparison = 0;
+        if (isNumber(lhs[i]) && isNumber(rhs[i])) {
+            auto l = stripLeadingZeros(lhs[i]);
+            auto r = stripLeadingZeros(rhs[i]);
+            comparison = l.size() != r.size() ? (l.size() < r.size() ? -1 : 1)
+                                              : l.compare(r);
+        } else {
+            comparison = lhs[i].compare(rhs[i]);
         }
+        if (comparison != 0) {
+            return comparison < 0 ? -1 : 1;
+        }
+    }
+    if (lhs.size() == rhs.size()) {
+        return 0;
     }
+    return lhs.size() < rhs.size() ? -1 : 1;
+}
 
-    auto message =
-        boost::format(
-            "Failed to parse library soname from readelf output: %s") %
-        output;
+// Ranks an ABI-compatible host library as replacement of a container
+// library: a host ABI which is fully compatible (i.e. one ABI is a prefix of
+// the other, as accepted by resolveAbi) is preferred over a host ABI which is
+// as new as the container one, which in turn is preferred over an older one.
+static int rankReplacement(const std::vector<std::string> &hostAbi,
+                           const std::vector<std::string> &containerAbi) {
+    const auto &shorter =
+        hostAbi.size() < containerAbi.size() ? hostAbi : containerAbi;
+    const auto &longer =
+        hostAbi.size() < containerAbi.size() ? containerAbi : hostAbi;
+    if (std::equal(shorter.cbegin(), shorter.cend(), longer.cbegin())) {
+        return 2;
+    }
+    return compareAbi(hostAbi, containerAbi) >= 0 ? 1 : 0;
+}
+
+/**
+ * Plans the bind mounts to make the host libraries available in the container.
+ *
+ * Both sets of libraries are indexed by linker name, so that the plan is
+ * computed in a single pass over the container libraries. Each container
+ * library with the same linker name as some host libraries is replaced by
+ * the best-ranked ABI-compatible host library (see areAbiCompatible), or
+ * reported as incompatible if there is none. The host libraries whose linker
+ * name doesn't match any container library are injected into 'injectionDir'.
+ *
+ * The ABI versions of the libraries are taken from the input, e.g. as
+ * returned by resolveAbi, resolveAbiBatch or SharedLibIndex.
+ */
+BindMountPlan planBindMounts(const std::vector<Library> &hostLibs,
+                             const std::vector<Library> &containerLibs,
+                             const boost::filesystem::path &injectionDir) {
+    auto plan = BindMountPlan{};
+
+    auto hostLibsByLinkerName =
+        std::unordered_map<std::string, std::vector<const Library *>>{};
+    hostLibsByLinkerName.reserve(hostLibs.size());
+    for (const auto &hostLib : hostLibs) {
+        hostLibsByLinkerName[getLinkerName(hostLib.path).string()].push_back(
+            &hostLib);
+    }
+
+    auto containerLinkerNames = std::unordered_set<std::string>{};
+    containerLinkerNames.reserve(containerLibs.size());
+    for (const auto &containerLib : containerLibs) {
+        auto linkerName = getLinkerName(containerLib.path).string();
+        auto it = hostLibsByLinkerName.find(linkerName);
+        containerLinkerNames.insert(std::move(linkerName));
+        if (it == hostLibsByLinkerName.cend()) {
+            continue;
+        }
+
+        const Library *bestHostLib = nullptr;
+        auto bestRank = -1;
+        for (const auto *hostLib : it->second) {
+            if (!areAbiCompatible(hostLib->abi, containerLib.abi)) {
+                continue;
+            }
+            auto rank = rankReplacement(hostLib->abi, containerLib.abi);
+            if (rank > bestRank ||
+                (rank == bestRank &&
+                 compareAbi(hostLib->abi, bestHostLib->abi) > 0)) {
+                bestHostLib = hostLib;
+                bestRank = rank;
+            }
+        }
+
+        if (bestHostLib) {
+            plan.replacements.push_back(
+                BindMountPlan::Mount{bestHostLib->path, containerLib.path});
+        } else {
+            auto message =
+                boost::format(
+                    "Container library %s has no ABI-compatible host library") %
+                containerLib.path;
+            logMessage(message.str(), LogLevel::DEBUG);
+            plan.incompatibleContainerLibs.push_back(containerLib.path);
+        }
+    }
+
+    for (const auto &hostLib : hostLibs) {
+        auto linkerName = getLinkerName(hostLib.path).string();
+        if (containerLinkerNames.find(linkerName) ==
+            containerLinkerNames.cend()) {
+            plan.injections.push_back(BindMountPlan::Mount{
+                hostLib.path, injectionDir / hostLib.path.filename()});
+        }
+    }
+
+    return plan;
+}
+
+namespace {
+
+// A library loaded while computing a dependency closure
+struct LoadedLibrary {
+    boost::filesystem::path path;      // path where the library was found
+    boost::filesystem::path realPath;  // path with all symlinks resolved
+    elf::Info info;
+    // RPATHs of the libraries that caused this library to be loaded
+    std::vector<boost::filesystem::path> loaderRpath;
+};
+
+// Shared state of a dependency closure computation. Apart from the rootfs
+// resolver (which is thread-safe), it is read-only while the libraries are
+// being processed.
+struct DependencyResolver {
+    boost::filesystem::path rootDir;
+    std::unordered_map<std::string, std::vector<boost::filesystem::path>>
+        dynamicLinkerCache;
+    RootfsResolver rootfsResolver;
+};
+
+}  // namespace
+
+// Expands the dynamic string tokens of a RPATH/RUNPATH entry, as done by the
+// dynamic linker. Entries with unsupported tokens (e.g. $PLATFORM) and
+// relative entries (which would be relative to the process' working
+// directory) are discarded.
+static boost::optional<boost::filesystem::path> expandSearchPathEntry(
+    const std::string &entry, const boost::filesystem::path &origin,
+    const elf::Info &info) {
+    auto expanded = entry;
+    auto lib = std::string{info.elfClass == ELFCLASS64 ? "lib64" : "lib"};
+    boost::replace_all(expanded, "${ORIGIN}", origin.string());
+    boost::replace_all(expanded, "$ORIGIN", origin.string());
+    boost::replace_all(expanded, "${LIB}", lib);
+    boost::replace_all(expanded, "$LIB", lib);
+    if (expanded.find('$') != std::string::npos || expanded.empty() ||
+        expanded.front() != '/') {
+        return {};
+    }
+    return boost::filesystem::path{expanded};
+}
+
+static std::vector<boost::filesystem::path> expandSearchPath(
+    const std::vector<std::string> &entries,
+    const boost::filesystem::path &origin, const elf::Info &info) {
+    auto paths = std::vector<boost::filesystem::path>{};
+    for (const auto &entry : entries) {
+        auto path = expandSearchPathEntry(entry, origin, info);
+        if (path) {
+            paths.push_back(std::move(*path));
+        }
+    }
+    return paths;
+}
+
+static boost::optional<LoadedLibrary> tryLoadLibrary(
+    DependencyResolver &resolver, const boost::filesystem::path &candidate,
+    const elf::Info &requesterInfo) {
+    auto realPath = resolver.rootfsResolver.resolve(candidate);
+    if (!boost::filesystem::is_regular_file(resolver.rootDir / realPath)) {
+        return {};
+    }
+
+    // Skip candidates that are not ELF files (e.g. linker scripts) or that
+    // have a different architecture than the requesting library, as the
+    // dynamic linker does
+    auto library = LoadedLibrary{candidate, realPath, {}, {}};
+    try {
+        library.info = elf::readInfo(resolver.rootDir / realPath);
+    } catch (const Error &) {
+        return {};
+    }
+    if (library.info.elfClass != requesterInfo.elfClass ||
+        library.info.machine != requesterInfo.machine) {
+        return {};
+    }
+    return library;
+}
+
+// Looks up a DT_NEEDED entry following the search order of the dynamic
+// linker: RPATHs (only if the requester has no RUNPATH), RUNPATH,
+// ld.so.cache, default directories.
+static LoadedLibrary findNeededLibrary(
+    DependencyResolver &resolver, const LoadedLibrary &requester,
+    const std::string &needed,
+    const std::vector<boost::filesystem::path> &rpath,
+    const std::vector<boost::filesystem::path> &runpath) {
+    if (needed.find('/') != std::string::npos) {
+        auto library = tryLoadLibrary(resolver, needed, requester.info);
+        if (library) {
+            return std::move(*library);
+        }
+    } else {
+        for (const auto &searchPath : {&rpath, &runpath}) {
+            for (const auto &dir : *searchPath) {
+                auto library =
+                    tryLoadLibrary(resolver, dir / needed, requester.info);
+                if (library) {
+                    return std::move(*library);
+                }
+            }
+        }
+
+        auto it = resolver.dynamicLinkerCache.find(needed);
+        if (it != resolver.dynamicLinkerCache.cend()) {
+            for (const auto &path : it->second) {
+                auto library = tryLoadLibrary(resolver, path, requester.info);
+                if (library) {
+                    return std::move(*library);
+                }
+            }
+        }
+
+        auto defaultDirs =
+            requester.info.elfClass == ELFCLASS64
+                ? std::vector<boost::filesystem::path>{"/lib64", "/usr/lib64",
+                                                       "/lib", "/usr/lib"}
+                : std::vector<boost::filesystem::path>{"/lib", "/usr/lib"};
+        for (const auto &dir : defaultDirs) {
+            auto library =
+                tryLoadLibrary(resolver, dir / needed, requester.info);
+            if (library) {
+                return std::move(*library);
+            }
+        }
+    }
+
+    auto message = boost::format(
+                       "Failed to resolve dependency %s of %s within root "
+                       "directory %s: library not found") %
+                   needed % requester.path % resolver.rootDir;
     SARUS_THROW_ERROR(message.str());
 }
 
-bool is64bitSharedLib(const boost::filesystem::path &path,
-                      const boost::filesystem::path &readelfPath) {
+static std::vector<LoadedLibrary> findNeededLibraries(
+    DependencyResolver &resolver, const LoadedLibrary &library) {
+    auto origin = library.path.parent_path();
+
+    // A RPATH is ignored if the library also has a RUNPATH
+    auto ownRpath = library.info.runpath.empty()
+                        ? expandSearchPath(library.info.rpath, origin,
+                                           library.info)
+                        : std::vector<boost::filesystem::path>{};
+    auto runpath = expandSearchPath(library.info.runpath, origin, library.info);
+
+    auto childrenLoaderRpath = ownRpath;
+    childrenLoaderRpath.insert(childrenLoaderRpath.end(),
+                               library.loaderRpath.cbegin(),
+                               library.loaderRpath.cend());
+
+    // The RPATHs of the loaders are only searched if the library doesn't have
+    // a RUNPATH
+    const auto &rpath = library.info.runpath.empty()
+                            ? childrenLoaderRpath
+                            : std::vector<boost::filesystem::path>{};
+
+    auto neededLibraries = std::vector<LoadedLibrary>{};
+    for (const auto &needed : library.info.needed) {
+        auto neededLibrary =
+            findNeededLibrary(resolver, library, needed, rpath, runpath);
+        neededLibrary.loaderRpath = childrenLoaderRpath;
+        neededLibraries.push_back(std::move(neededLibrary));
+    }
+    return neededLibraries;
+}
+
+/**
+ * Returns the transitive closure of the dependencies (DT_NEEDED entries) of
+ * the given libraries, as the dynamic linker would load them from the root
+ * directory. The dependencies are looked up in the RPATH/RUNPATH (with
+ * $ORIGIN and $LIB expansion), ld.so.cache and default directories of the
+ * root directory, resolving symlinks within the root directory.
+ *
+ * The libraries are processed breadth-first, each level of the dependency
+ * graph by up to 'numberOfThreads' threads (0 means one per available CPU).
+ * A library is processed only once, even if reachable through different
+ * paths. The returned paths are the ones where the dependencies were found,
+ * in breadth-first order, and don't include the input libraries.
+ */
+std::vector<boost::filesystem::path> getDependencyClosure(
+    const std::vector<boost::filesystem::path> &libs,
+    const boost::filesystem::path &rootDir, unsigned int numberOfThreads) {
+    auto resolver = DependencyResolver{rootDir, {}, RootfsResolver{rootDir}};
+
+    auto cacheFile = ldcache::getCachePath(rootDir);
+    if (boost::filesystem::exists(cacheFile)) {
+        for (auto &entry : ldcache::read(cacheFile)) {
+            resolver.dynamicLinkerCache[entry.soname].push_back(
+                std::move(entry.path));
+        }
+    }
+
+    auto visitedLibraries =
+        std::unordered_set<boost::filesystem::path, PathHash>{};
+    auto currentLevel = std::vector<LoadedLibrary>{};
+    for (const auto &lib : libs) {
+        auto library = LoadedLibrary{};
+        library.path = lib;
+        library.realPath = resolver.rootfsResolver.resolve(lib);
+        library.info = elf::readInfo(rootDir / library.realPath);
+        if (visitedLibraries.insert(library.realPath).second) {
+            currentLevel.push_back(std::move(library));
+        }
+    }
+
+    auto dependencies = std::vector<boost::filesystem::path>{};
+    while (!currentLevel.empty()) {
+        auto neededLibraries =
+            std::vector<std::vector<LoadedLibrary>>(currentLevel.size());
+        parallel::forEachIndex(
+            currentLevel.size(),
+            [&](size_t i) {
+                neededLibraries[i] =
+                    findNeededLibraries(resolver, currentLevel[i]);
+            },
+            numberOfThreads);
+
+        auto nextLevel = std::vector<LoadedLibrary>{};
+        for (auto &libraries : neededLibraries) {
+            for (auto &library : libraries) {
+                if (visitedLibraries.insert(library.realPath).second) {
+                    dependencies.push_back(library.path);
+                    nextLevel.push_back(std::move(library));
+                }
+            }
+        }
+        currentLevel = std::move(nextLevel);
+    }
+
+    return dependencies;
+}
+
+// Parses the version of a glibc symbol version name, e.g. GLIBC_2.2.5
+static boost::optional<std::tuple<unsigned int, unsigned int>>
+parseGlibcVersionName(const std::string &name) {
+    boost::smatch matches;
+    static const auto re = boost::regex("^GLIBC_(\\d+)\\.(\\d+)(\\.\\d+)*$");
+    if (!boost::regex_match(name, matches, re)) {
+        return {};
+    }
+    return std::tuple<unsigned int, unsigned int>{std::stoi(matches[1]),
+                                                  std::stoi(matches[2])};
+}
+
+/**
+ * Returns the path (within the root directory) of the C library of the root
+ * directory, looking first at the dynamic linker's cache and then at the
+ * default library directories. 64-bit libraries are preferred.
+ */
+boost::filesystem::path findLibc(const boost::filesystem::path &rootDir) {
+    auto candidates = std::vector<boost::filesystem::path>{};
+
+    auto cacheFile = ldcache::getCachePath(rootDir);
+    if (boost::filesystem::exists(cacheFile)) {
+        for (auto &entry : ldcache::read(cacheFile)) {
+            if (filesystem::isLibc(entry.path)) {
+                candidates.push_back(std::move(entry.path));
+            }
+        }
+    }
+    for (const auto *dir : {"/lib64", "/usr/lib64", "/lib/x86_64-linux-gnu",
+                            "/usr/lib/x86_64-linux-gnu", "/lib", "/usr/lib"}) {
+        candidates.push_back(boost::filesystem::path{dir} / "libc.so.6");
+    }
+
+    auto fallback = boost::optional<boost::filesystem::path>{};
+    for (const auto &candidate : candidates) {
+        auto realPath =
+            filesystem::appendPathsWithinRootfs(rootDir, "/", candidate);
+        if (!boost::filesystem::is_regular_file(rootDir / realPath) ||
+            !elf::isElf(rootDir / realPath)) {
+            continue;
+        }
+        if (elf::readInfo(rootDir / realPath).elfClass == ELFCLASS64) {
+            return candidate;
+        }
+        if (!fallback) {
+            fallback = candidate;
+        }
+    }
+
+    if (!fallback) {
+        auto message =
+            boost::format("Failed to find the C library in root directory %s") %
+            rootDir;
+        SARUS_THROW_ERROR(message.str());
+    }
+    return *fallback;
+}
+
+// Returns the version in the version string embedded in glibc ("... release
+// version x.y."), or none if the library doesn't have one
+static boost::optional<std::tuple<unsigned int, unsigned int>>
+getReleaseVersion(const boost::filesystem::path &libc) {
+    auto file = MappedFile{libc};
+    auto data = std::string_view{reinterpret_cast<const char *>(file.data()),
+                                 file.size()};
+    auto marker = std::string_view{"release version "};
+    auto pos = data.find(marker);
+    if (pos == std::string_view::npos) {
+        return boost::none;
+    }
     boost::cmatch matches;
-    boost::regex re("^ *Machine: +Advanced Micro Devices X86-64 *$");
+    static const auto re = boost::regex("^(\\d+)\\.(\\d+)");
+    const auto *begin = data.data() + pos + marker.size();
+    const auto *end = std::min(begin + 16, data.data() + data.size());
+    if (!boost::regex_search(begin, end, matches, re)) {
+        return boost::none;
+    }
+    return std::tuple<unsigned int, unsigned int>{std::stoi(matches[1]),
+                                                  std::stoi(matches[2])};
+}
 
-    auto command =
-        boost::format("%s -h %s") % readelfPath.string() % path.string();
-    auto output = process::executeCommand(command.str());
+/**
+ * Returns the version of the given glibc library file, i.e. the version in
+ * its embedded version string ("... release version x.y.") or, if the library
+ * doesn't have one, the highest GLIBC_x.y symbol version defined in its
+ * .gnu.version_d section. The release string takes precedence because a
+ * glibc release doesn't necessarily define a new symbol version.
+ * This replaces running "ldd --version" (see
+ * hook::parseLibcVersionFromLddOutput).
+ */
+std::tuple<unsigned int, unsigned int> getLibcVersion(
+    const boost::filesystem::path &libc) {
+    auto version = getReleaseVersion(libc);
+    if (version) {
+        return *version;
+    }
 
-    std::stringstream stream{output};
-    std::string line;
-    while (std::getline(stream, line)) {
-        if (boost::regex_match(line.c_str(), matches, re)) {
-            return true;
+    for (const auto &definition : elf::readInfo(libc).versionDefinitions) {
+        auto definitionVersion = parseGlibcVersionName(definition);
+        if (definitionVersion && (!version || *definitionVersion > *version)) {
+            version = definitionVersion;
+        }
+    }
+    if (version) {
+        return *version;
+    }
+
+    auto message =
+        boost::format("Failed to determine glibc version of %s: no version "
+                      "string nor GLIBC version definitions found") %
+        libc;
+    SARUS_THROW_ERROR(message.str());
+}
+
+/**
+ * Returns the version of the glibc of the root directory, without executing
+ * any program in it.
+ */
+std::tuple<unsigned int, unsigned int> getGlibcVersion(
+    const boost::filesystem::path &rootDir) {
+    auto libc = findLibc(rootDir);
+    return getLibcVersion(
+        rootDir / filesystem::appendPathsWithinRootfs(rootDir, "/", libc));
+}
+
+/**
+ * Returns the highest GLIBC_x.y symbol version required by the given
+ * library (from its .gnu.version_r section), or none if the library doesn't
+ * require any versioned glibc symbol.
+ */
+boost::optional<std::tuple<unsigned int, unsigned int>>
+getMaxRequiredGlibcVersion(const boost::filesystem::path &lib) {
+    auto maxVersion = boost::optional<std::tuple<unsigned int, unsigned int>>{};
+    for (const auto &requirement : elf::readInfo(lib).versionRequirements) {
+        for (const auto &name : requirement.versions) {
+            auto version = parseGlibcVersionName(name);
+            if (version && (!maxVersion || *version > *maxVersion)) {
+                maxVersion = version;
+            }
         }
     }
+    return maxVersion;
+}
+
+/**
+ * Returns the SONAME of the given library, as read from its ELF dynamic
+ * section.
+ *
+ * Note: the 'readelfPath' argument is ignored. It is only kept for backward
+ * compatibility, since the ELF file is now read in-process.
+ */
+std::string getSoname(const boost::filesystem::path &path,
+                      const boost::filesystem::path &readelfPath) {
+    auto info = elf::readInfo(path);
+    if (!info.soname) {
+        auto message =
+            boost::format("Failed to parse library soname of %s: no SONAME "
+                          "entry in ELF dynamic section") %
+            path;
+        SARUS_THROW_ERROR(message.str());
+    }
+    return *info.soname;
+}
 
-    return false;
+/**
+ * Returns whether the given library is an x86-64 ELF file.
+ *
+ * Note: the 'readelfPath' argument is ignored. It is only kept for backward
+ * compatibility, since the ELF file is now read in-process.
+ */
+bool is64bitSharedLib(const boost::filesystem::path &path,
+                      const boost::filesystem::path &readelfPath) {
+    auto info = elf::readInfo(path);
+    return info.elfClass == ELFCLASS64 && info.machine == EM_X86_64;
 }
 
 }  // namespace sharedlibs
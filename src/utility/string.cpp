@@ -11,10 +11,13 @@
 
 #include "libsarus/utility/string.hpp"
 
+#include <cstdint>
 #include <iostream>
 #include <random>
 #include <vector>
 
+#include <unistd.h>
+
 #include <boost/algorithm/string.hpp>
 #include <boost/format.hpp>
 
@@ -73,17 +76,27 @@ std::pair<std::string, std::string> parseKeyValuePair(
     return std::pair<std::string, std::string>{key, value};
 }
 
+/**
+ * Returns a string of 'size' random lowercase letters.
+ *
+ * Each thread seeds its own generator once. The generator is seeded again in
+ * a forked child, which would otherwise generate the same strings as its
+ * parent.
+ */
 std::string generateRandom(size_t size) {
-    auto dist =
-        std::uniform_int_distribution<std::mt19937::result_type>(0, 'z' - 'a');
-    std::mt19937 generator;
-    generator.seed(std::random_device()());
+    thread_local auto generator = std::mt19937_64{};
+    thread_local auto seededByPid = pid_t{0};
+    if (seededByPid != getpid()) {
+        auto seed = std::random_device{};
+        generator.seed((uint64_t(seed()) << 32) ^ seed());
+        seededByPid = getpid();
+    }
 
+    auto dist = std::uniform_int_distribution<int>(0, 'z' - 'a');
     auto string = std::string(size, '.');
 
     for (size_t i = 0; i < string.size(); ++i) {
-        auto randomCharacter = 'a' + dist(generator);
-        string[i] = randomCharacter;
+        string[i] = 'a' + dist(generator);
     }
 
     return string;
@@ -56,6 +56,17 @@ TEST_F(DeviceMountTest, constructor) {
                             rootfsDir, userIdentity};
 
         DeviceMount(std::move(mountObject), devAccess);
+
+        // with a snapshot of the source's metadata
+        auto sourceInfo = libsarus::FileInfo{testDeviceFile};
+        auto otherMountObject =
+            libsarus::Mount{testDeviceFile, testDeviceFile, mount_flags,
+                            rootfsDir, userIdentity};
+        auto devMount =
+            DeviceMount(std::move(otherMountObject), devAccess, sourceInfo);
+        EXPECT_EQ(devMount.getType(), 'c');
+        EXPECT_EQ(devMount.getMajorID(), majorID);
+        EXPECT_EQ(devMount.getMinorID(), minorID);
     }
     // source path is not a device file
     {
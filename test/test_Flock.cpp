@@ -8,6 +8,9 @@
  *
  */
 
+#include <chrono>
+#include <memory>
+#include <thread>
 #include <type_traits>
 
 #include <boost/filesystem.hpp>
@@ -149,6 +152,24 @@ TEST_F(FlockTest, timeout_time_is_respected) {
     }
 }
 
+TEST_F(FlockTest, poll_interval_is_respected) {
+    auto lock = std::make_unique<libsarus::Flock>(
+        fileToLock, libsarus::Flock::Type::writeLock);
+    auto releaser = std::thread{[&lock]() {
+        std::this_thread::sleep_for(20_ms);
+        lock.reset();
+    }};
+
+    // the default poll interval would wait for 100 ms
+    auto start = std::chrono::steady_clock::now();
+    libsarus::Flock{fileToLock, libsarus::Flock::Type::writeLock,
+                    libsarus::Flock::noTimeout, 1000_ms, 1_ms};
+    auto end = std::chrono::steady_clock::now();
+    releaser.join();
+    std::chrono::duration<double, std::milli> elapsed = end - start;
+    EXPECT_LT(elapsed.count(), 100);
+}
+
 static_assert(!std::is_copy_constructible<libsarus::Flock>::value, "");
 static_assert(!std::is_copy_assignable<libsarus::Flock>::value, "");
 static_assert(std::is_move_constructible<libsarus::Flock>::value, "");
@@ -16,6 +16,7 @@
 #include <gtest/gtest.h>
 
 #include "libsarus/Mount.hpp"
+#include "libsarus/MountBatch.hpp"
 #include "libsarus/PathRAII.hpp"
 #include "libsarus/Utility.hpp"
 #include "libsarus/test/aux/filesystem.hpp"
@@ -118,5 +119,80 @@ TEST_F(MountTest, mount_test) {
     }
 }
 
+TEST_F(MountTest, MountBatch) {
+    libsarus::UserIdentity userIdentity;
+
+    auto bundleDirRAII =
+        libsarus::PathRAII{libsarus::filesystem::makeUniquePathWithRandomSuffix(
+            boost::filesystem::absolute("test-bundle-dir"))};
+    const auto &bundleDir = bundleDirRAII.getPath();
+    auto rootfsDir = bundleDir / "rootfs";
+    auto sourceDir = bundleDir / "source-dir";
+    auto otherSourceDir = bundleDir / "other-source-dir";
+    auto sourceFile = bundleDir / "source-file";
+    libsarus::filesystem::createFoldersIfNecessary(rootfsDir);
+    aux::filesystem::createTestDirectoryTree(sourceDir.string());
+    aux::filesystem::createTestDirectoryTree(otherSourceDir.string());
+    libsarus::filesystem::createFileIfNecessary(sourceFile);
+
+    // the mount on "/dir/nested" requires a second wave, as its mount point
+    // is created within the mount on "/dir"
+    auto batch = libsarus::MountBatch{rootfsDir, userIdentity};
+    batch.add(sourceDir, "/dir");
+    batch.add(sourceFile, "/file", MS_RDONLY);
+    batch.add(libsarus::Mount{otherSourceDir, "/dir/nested", 0, rootfsDir,
+                              userIdentity});
+    batch.add(otherSourceDir, "/other-dir");
+    EXPECT_EQ(batch.size(), 4);
+    batch.performMounts();
+
+    EXPECT_TRUE(aux::filesystem::areDirectoriesEqual(
+        otherSourceDir.string(), (rootfsDir / "dir/nested").string(), 1));
+    EXPECT_TRUE(boost::filesystem::exists(sourceDir / "nested"));
+    EXPECT_TRUE(
+        aux::filesystem::isSameBindMountedFile(sourceFile, rootfsDir / "file"));
+    EXPECT_TRUE(aux::filesystem::areDirectoriesEqual(
+        otherSourceDir.string(), (rootfsDir / "other-dir").string(), 1));
+
+    // the mounts before a failed one are performed
+    auto failingBatch = libsarus::MountBatch{rootfsDir, userIdentity};
+    failingBatch.add(sourceDir, "/before-failure");
+    failingBatch.add(bundleDir / "missing", "/failure");
+    failingBatch.add(sourceDir, "/after-failure");
+    EXPECT_THROW(failingBatch.performMounts(), libsarus::Error);
+    EXPECT_TRUE(aux::filesystem::areDirectoriesEqual(
+        sourceDir.string(), (rootfsDir / "before-failure").string(), 1));
+    EXPECT_FALSE(boost::filesystem::exists(rootfsDir / "after-failure"));
+
+    // the mount on "/opt/app/data" requires a second wave, as its path is
+    // resolved through the mount on "/opt/app" instead of the symlink of the
+    // rootfs
+    auto appSourceDir = bundleDir / "app-source-dir";
+    aux::filesystem::createTestDirectoryTree(appSourceDir.string());
+    libsarus::filesystem::createFoldersIfNecessary(rootfsDir / "opt/app");
+    libsarus::filesystem::createFoldersIfNecessary(rootfsDir / "var/data");
+    boost::filesystem::create_symlink("/var/data", rootfsDir / "opt/app/data");
+    auto symlinkBatch = libsarus::MountBatch{rootfsDir, userIdentity};
+    symlinkBatch.add(appSourceDir, "/opt/app");
+    symlinkBatch.add(otherSourceDir, "/opt/app/data");
+    symlinkBatch.performMounts();
+    EXPECT_TRUE(aux::filesystem::areDirectoriesEqual(
+        otherSourceDir.string(), (rootfsDir / "opt/app/data").string(), 1));
+    EXPECT_TRUE(boost::filesystem::is_directory(appSourceDir / "data"));
+    EXPECT_TRUE(boost::filesystem::is_empty(rootfsDir / "var/data"));
+
+    // mounts of other rootfses cannot be added
+    EXPECT_THROW(batch.add(libsarus::Mount{sourceDir, "/dir", 0, bundleDir,
+                                           userIdentity}),
+                 libsarus::Error);
+
+    // cleanup
+    for (const auto *destination :
+         {"before-failure", "other-dir", "dir/nested", "dir", "file",
+          "opt/app/data", "opt/app"}) {
+        EXPECT_EQ(umount((rootfsDir / destination).c_str()), 0);
+    }
+}
+
 }  // namespace test
 }  // namespace libsarus
@@ -8,9 +8,18 @@
  *
  */
 
+#include <cerrno>
+#include <chrono>
 #include <string>
+#include <thread>
 
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/mount.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
 
 #include <gtest/gtest.h>
 
@@ -171,6 +180,42 @@ TEST_F(MountUtilitiesTest, bindMountRecursive) {
     EXPECT_EQ(umount(a.c_str()), 0);
 }
 
+TEST_F(MountUtilitiesTest, bindMountReadOnlyRecursive) {
+    // same conditions as libsarus::mount::bindMount to use the new mount API
+#if defined(SYS_open_tree) && defined(SYS_move_mount) && \
+    defined(SYS_mount_setattr)
+    if (syscall(SYS_mount_setattr, -1, "", 0, nullptr, 0) != 0 &&
+        errno == ENOSYS) {
+        GTEST_SKIP() << "mount_setattr(2) is not supported by the kernel";
+    }
+#else
+    GTEST_SKIP() << "The new mount API is not supported by the system headers";
+#endif
+    auto tempDirRAII =
+        libsarus::PathRAII{libsarus::filesystem::makeUniquePathWithRandomSuffix(
+            "/tmp/sarus-test-common-bindmount")};
+    const auto &tempDir = tempDirRAII.getPath();
+    auto fromDir = tempDir / "from";
+    auto toDir = tempDir / "to";
+    auto subDir = tempDir / "sub";
+
+    libsarus::filesystem::createFoldersIfNecessary(fromDir / "sub");
+    libsarus::filesystem::createFoldersIfNecessary(toDir);
+    libsarus::filesystem::createFoldersIfNecessary(subDir);
+    libsarus::mount::bindMount(subDir, fromDir / "sub");
+
+    libsarus::mount::bindMount(fromDir, toDir, MS_RDONLY);
+
+    // check that the submount is also read-only
+    EXPECT_THROW(libsarus::filesystem::createFileIfNecessary(
+                     toDir / "sub/file-failed-write-attempt"),
+                 libsarus::Error);
+
+    // cleanup
+    EXPECT_EQ(umount2(toDir.c_str(), MNT_DETACH), 0);
+    EXPECT_EQ(umount((fromDir / "sub").c_str()), 0);
+}
+
 TEST_F(MountUtilitiesTest, loopMountSquashfs) {
     auto mountPointRAII =
         libsarus::PathRAII{libsarus::filesystem::makeUniquePathWithRandomSuffix(
@@ -187,5 +232,158 @@ TEST_F(MountUtilitiesTest, loopMountSquashfs) {
     EXPECT_EQ(umount(mountPoint.string().c_str()), 0);
 }
 
+TEST_F(MountUtilitiesTest, loopMountSquashfsDetachesLoopDevice) {
+    auto mountPointRAII =
+        libsarus::PathRAII{libsarus::filesystem::makeUniquePathWithRandomSuffix(
+            "/tmp/sarus-test-common-loopMountSquashfs")};
+    const auto &mountPoint = mountPointRAII.getPath();
+    libsarus::filesystem::createFoldersIfNecessary(mountPoint);
+
+    auto imageSquashfs =
+        boost::filesystem::path{__FILE__}.parent_path() / "test_image.squashfs";
+    libsarus::mount::loopMountSquashfs(imageSquashfs, mountPoint);
+    struct stat st;
+    ASSERT_EQ(stat(mountPoint.c_str(), &st), 0);
+    auto backingFile = boost::filesystem::path{
+        (boost::format("/sys/dev/block/%d:%d/loop/backing_file") %
+         major(st.st_dev) % minor(st.st_dev))
+            .str()};
+    EXPECT_TRUE(boost::filesystem::exists(backingFile));
+
+    // the loop device is detached asynchronously after the unmount
+    EXPECT_EQ(umount(mountPoint.c_str()), 0);
+    for (int i = 0; i < 100 && boost::filesystem::exists(backingFile); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_FALSE(boost::filesystem::exists(backingFile));
+}
+
+// Returns whether the page at 'offset' of the file mapped at 'map' is in the
+// page cache
+static bool isPageResident(void *map, uint64_t offset) {
+    auto pageSize = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    auto *page = static_cast<char *>(map) + offset / pageSize * pageSize;
+    unsigned char vector = 0;
+    EXPECT_EQ(mincore(page, 1, &vector), 0);
+    return (vector & 1) != 0;
+}
+
+TEST_F(MountUtilitiesTest, prefetchSquashfs) {
+    auto testDirRAII =
+        libsarus::PathRAII{libsarus::filesystem::makeUniquePathWithRandomSuffix(
+            "/tmp/sarus-test-common-prefetchSquashfs")};
+    auto image = testDirRAII.getPath() / "image.squashfs";
+
+    // an image of 4 MiB whose metadata tables take its last 2 MiB, the id
+    // table being the first of them
+    const uint64_t size = 4 << 20;
+    const uint64_t tablesStart = 2 << 20;
+    const uint64_t inodeTableStart = 3 << 20;
+    auto content = std::string(size, 'x');
+    auto setField = [&content](size_t offset, uint64_t value, size_t length) {
+        for (size_t i = 0; i < length; ++i) {
+            content[offset + i] = static_cast<char>(value >> (8 * i));
+        }
+    };
+    setField(0, 0x73717368, 4);               // magic
+    setField(28, 4, 2);                       // major version
+    setField(40, size, 8);                    // bytes used
+    setField(48, tablesStart, 8);             // id table
+    setField(56, ~uint64_t{0}, 8);            // xattr id table
+    setField(64, inodeTableStart, 8);         // inode table
+    setField(72, inodeTableStart + 4096, 8);  // directory table
+    setField(80, inodeTableStart + 8192, 8);  // fragment table
+    setField(88, ~uint64_t{0}, 8);            // export table
+    libsarus::filesystem::writeTextFile(content, image);
+
+    // evict the image from the page cache
+    auto fd = libsarus::FileDescriptor{open(image.c_str(), O_RDONLY)};
+    ASSERT_TRUE(fd.isValid());
+    ASSERT_EQ(fdatasync(fd.get()), 0);
+    ASSERT_EQ(posix_fadvise(fd.get(), 0, 0, POSIX_FADV_DONTNEED), 0);
+    auto *map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd.get(), 0);
+    ASSERT_NE(map, MAP_FAILED);
+    auto isResident = [map](uint64_t offset) {
+        return isPageResident(map, offset);
+    };
+    auto pageInIdTable = tablesStart + (64 << 10);
+    if (isResident(pageInIdTable)) {
+        munmap(map, size);
+        GTEST_SKIP() << "the filesystem of " << image
+                     << " doesn't evict pages from the page cache";
+    }
+
+    libsarus::mount::prefetchSquashfs(image).get();
+
+    // the tables are prefetched from the start of the first one, the reads
+    // complete asynchronously
+    auto isPrefetched = [&]() {
+        return isResident(pageInIdTable) && isResident(inodeTableStart) &&
+               isResident(size - 1);
+    };
+    for (int i = 0; i < 500 && !isPrefetched(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    }
+    EXPECT_TRUE(isResident(pageInIdTable));
+    EXPECT_TRUE(isResident(inodeTableStart));
+    EXPECT_TRUE(isResident(size - 1));
+    munmap(map, size);
+
+    // not a squashfs image
+    EXPECT_THROW(libsarus::mount::prefetchSquashfs(__FILE__).get(),
+                 libsarus::Error);
+}
+
+TEST_F(MountUtilitiesTest, prefetchSquashfsFiles) {
+    auto mountPointRAII =
+        libsarus::PathRAII{libsarus::filesystem::makeUniquePathWithRandomSuffix(
+            "/tmp/sarus-test-common-prefetchSquashfsFiles")};
+    const auto &mountPoint = mountPointRAII.getPath();
+    libsarus::filesystem::createFoldersIfNecessary(mountPoint);
+
+    auto imageSquashfs =
+        boost::filesystem::path{__FILE__}.parent_path() / "test_image.squashfs";
+    auto prefetch = libsarus::mount::prefetchSquashfs(imageSquashfs);
+    libsarus::mount::loopMountSquashfs(imageSquashfs, mountPoint);
+    EXPECT_NO_THROW(prefetch.get());
+
+    // missing files are skipped
+    auto files = std::vector<boost::filesystem::path>{"file_in_squashfs_image",
+                                                      "/missing_file"};
+    EXPECT_NO_THROW(
+        libsarus::mount::prefetchSquashfsFiles(mountPoint, files).get());
+
+    EXPECT_EQ(umount(mountPoint.c_str()), 0);
+
+    // the files are read from the mounted image, not from the host: the test
+    // image only has an empty file, hence a directory stands for the image
+    const uint64_t size = 4 << 20;
+    auto file = boost::filesystem::path{"sarus-test-prefetch"} / "data";
+    libsarus::filesystem::writeTextFile(std::string(size, 'x'),
+                                        mountPoint / file);
+    auto fd =
+        libsarus::FileDescriptor{open((mountPoint / file).c_str(), O_RDONLY)};
+    ASSERT_TRUE(fd.isValid());
+    ASSERT_EQ(fdatasync(fd.get()), 0);
+    ASSERT_EQ(posix_fadvise(fd.get(), 0, 0, POSIX_FADV_DONTNEED), 0);
+    auto *map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd.get(), 0);
+    ASSERT_NE(map, MAP_FAILED);
+    if (isPageResident(map, size - 1)) {
+        munmap(map, size);
+        GTEST_SKIP() << "the filesystem of " << mountPoint
+                     << " doesn't evict pages from the page cache";
+    }
+
+    libsarus::mount::prefetchSquashfsFiles(mountPoint, {file}).get();
+
+    // the reads complete asynchronously
+    for (int i = 0; i < 500 && !isPageResident(map, size - 1); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    }
+    EXPECT_TRUE(isPageResident(map, 0));
+    EXPECT_TRUE(isPageResident(map, size - 1));
+    munmap(map, size);
+}
+
 }  // namespace test
 }  // namespace libsarus
@@ -0,0 +1,123 @@
+/*
+ * Sarus
+ *
+ * Copyright (c) 2018-2023, ETH Zurich. All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+#include <sys/mount.h>
+
+#include <boost/filesystem.hpp>
+#include <gtest/gtest.h>
+
+#include "libsarus/PathRAII.hpp"
+#include "libsarus/RootfsResolver.hpp"
+#include "libsarus/Utility.hpp"
+
+namespace libsarus {
+namespace test {
+
+class RootfsResolverTest : public testing::Test {
+  protected:
+    RootfsResolverTest() {
+        // /lib -> usr/lib64
+        // /usr/lib64/libfoo.so -> libfoo.so.1
+        // /usr/lib64/libfoo.so.1 -> /usr/lib64/libfoo.so.1.2
+        // /usr/lib64/libfoo.so.1.2
+        libsarus::filesystem::createFoldersIfNecessary(rootfs / "usr/lib64");
+        libsarus::filesystem::createFileIfNecessary(
+            rootfs / "usr/lib64/libfoo.so.1.2");
+        boost::filesystem::create_symlink("usr/lib64", rootfs / "lib");
+        boost::filesystem::create_symlink("libfoo.so.1",
+                                          rootfs / "usr/lib64/libfoo.so");
+        boost::filesystem::create_symlink("/usr/lib64/libfoo.so.1.2",
+                                          rootfs / "usr/lib64/libfoo.so.1");
+    }
+
+  protected:
+    libsarus::PathRAII testDirRAII =
+        libsarus::PathRAII{libsarus::filesystem::makeUniquePathWithRandomSuffix(
+            "/tmp/sarus-test-rootfsresolver")};
+    boost::filesystem::path rootfs = testDirRAII.getPath();
+};
+
+TEST_F(RootfsResolverTest, resolve) {
+    auto resolver = libsarus::RootfsResolver{rootfs};
+    auto expectedSymlinks = std::vector<boost::filesystem::path>{
+        "/lib", "/usr/lib64/libfoo.so", "/usr/lib64/libfoo.so.1"};
+
+    // the second resolution is served from the cache
+    for (int i = 0; i < 2; ++i) {
+        auto traversedSymlinks = std::vector<boost::filesystem::path>{};
+        EXPECT_EQ(resolver.resolve("/lib/libfoo.so", &traversedSymlinks),
+                  "/usr/lib64/libfoo.so.1.2");
+        EXPECT_EQ(traversedSymlinks, expectedSymlinks);
+    }
+
+    auto traversedSymlinks = std::vector<boost::filesystem::path>{};
+    EXPECT_EQ(resolver.appendPaths("/usr", "../lib/./libfoo.so.1",
+                                   &traversedSymlinks),
+              "/usr/lib64/libfoo.so.1.2");
+    EXPECT_EQ(traversedSymlinks,
+              (std::vector<boost::filesystem::path>{
+                  "/lib", "/usr/lib64/libfoo.so.1"}));
+
+    // non-existing paths are appended as they are
+    EXPECT_EQ(resolver.resolve("/lib/dir/libbar.so"),
+              "/usr/lib64/dir/libbar.so");
+
+    // same results as the free functions
+    for (const auto &path : {"/lib/libfoo.so", "/usr/lib64", "/lib/../lib"}) {
+        EXPECT_EQ(resolver.resolve(path),
+                  libsarus::filesystem::appendPathsWithinRootfs(rootfs, "/",
+                                                                path));
+    }
+}
+
+TEST_F(RootfsResolverTest, invalidate) {
+    auto resolver = libsarus::RootfsResolver{rootfs};
+    EXPECT_EQ(resolver.resolve("/lib/libfoo.so"), "/usr/lib64/libfoo.so.1.2");
+
+    // the cached resolutions are used until invalidated
+    libsarus::filesystem::createFoldersIfNecessary(rootfs / "usr/lib");
+    boost::filesystem::remove(rootfs / "lib");
+    boost::filesystem::create_symlink("usr/lib", rootfs / "lib");
+    EXPECT_EQ(resolver.resolve("/lib/libfoo.so"), "/usr/lib64/libfoo.so.1.2");
+
+    resolver.invalidate("/lib/");
+    EXPECT_EQ(resolver.resolve("/lib/libfoo.so"), "/usr/lib/libfoo.so");
+
+    boost::filesystem::remove(rootfs / "lib");
+    boost::filesystem::create_symlink("usr/lib64", rootfs / "lib");
+    resolver.invalidate();
+    EXPECT_EQ(resolver.resolve("/lib/libfoo.so"), "/usr/lib64/libfoo.so.1.2");
+}
+
+TEST_F(RootfsResolverTest, invalidate_after_mount) {
+    auto resolver = libsarus::RootfsResolver{rootfs};
+    EXPECT_EQ(resolver.resolve("/lib/libfoo.so"), "/usr/lib64/libfoo.so.1.2");
+    EXPECT_EQ(resolver.resolve("/usr/bin"), "/usr/bin");
+
+    // mount a directory with a different libfoo.so.1 over /usr/lib64
+    auto sourceDir = testDirRAII.getPath() / "source";
+    libsarus::filesystem::createFoldersIfNecessary(sourceDir);
+    libsarus::filesystem::createFileIfNecessary(sourceDir / "libfoo.so.1");
+    boost::filesystem::create_symlink("libfoo.so.1", sourceDir / "libfoo.so");
+    libsarus::mount::bindMount(sourceDir, rootfs / "usr/lib64");
+
+    resolver.invalidate("/usr/lib64");
+    auto traversedSymlinks = std::vector<boost::filesystem::path>{};
+    EXPECT_EQ(resolver.resolve("/lib/libfoo.so", &traversedSymlinks),
+              "/usr/lib64/libfoo.so.1");
+    EXPECT_EQ(traversedSymlinks, (std::vector<boost::filesystem::path>{
+                                     "/lib", "/usr/lib64/libfoo.so"}));
+    EXPECT_EQ(resolver.resolve("/usr/bin"), "/usr/bin");
+
+    EXPECT_EQ(umount((rootfs / "usr/lib64").c_str()), 0);
+}
+
+}  // namespace test
+}  // namespace libsarus
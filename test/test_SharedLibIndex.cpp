@@ -0,0 +1,196 @@
+/*
+ * Sarus
+ *
+ * Copyright (c) 2018-2023, ETH Zurich. All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+#include <algorithm>
+
+#include <boost/filesystem.hpp>
+#include <gtest/gtest.h>
+
+#include "libsarus/Error.hpp"
+#include "libsarus/PathRAII.hpp"
+#include "libsarus/SharedLibIndex.hpp"
+#include "libsarus/Utility.hpp"
+
+namespace libsarus {
+namespace test {
+
+class SharedLibIndexTest : public testing::Test {
+  protected:
+    SharedLibIndexTest() {
+        auto dummyLibsDir =
+            boost::filesystem::path{__FILE__}.parent_path() / "dummy_libs";
+
+        // /lib -> /lib64
+        // /lib64/libc.so.6 -> libc-2.31.so (created by ldconfig)
+        libsarus::filesystem::copyFile(dummyLibsDir / "libc.so.6-host",
+                                       rootDir / "lib64/libc-2.31.so");
+        libsarus::filesystem::copyFile(
+            dummyLibsDir / "ld-linux-x86-64.so.2-host",
+            rootDir / "lib64/ld-linux-x86-64.so.2");
+        libsarus::filesystem::copyFile(
+            dummyLibsDir / "libc.so.6-32bit-container",
+            rootDir / "lib32/libc.so.6");
+        boost::filesystem::create_symlink("lib64", rootDir / "lib");
+        libsarus::filesystem::writeTextFile("/lib64\n",
+                                            rootDir / "etc/ld.so.conf");
+        libsarus::process::executeCommand("ldconfig -r " + rootDir.string());
+    }
+
+    static void sortByPath(std::vector<SharedLibIndex::Entry> &entries) {
+        std::sort(entries.begin(), entries.end(),
+                  [](const SharedLibIndex::Entry &lhs,
+                     const SharedLibIndex::Entry &rhs) {
+                      return lhs.path < rhs.path;
+                  });
+    }
+
+    static void expectEqual(const SharedLibIndex::Entry &lhs,
+                            const SharedLibIndex::Entry &rhs) {
+        EXPECT_EQ(lhs.path, rhs.path);
+        EXPECT_EQ(lhs.realPath, rhs.realPath);
+        EXPECT_EQ(lhs.linkerName, rhs.linkerName);
+        EXPECT_TRUE(lhs.soname == rhs.soname);
+        EXPECT_EQ(lhs.abi, rhs.abi);
+        EXPECT_EQ(lhs.elfClass, rhs.elfClass);
+        EXPECT_EQ(lhs.machine, rhs.machine);
+        EXPECT_TRUE(lhs.stamp == rhs.stamp);
+    }
+
+  protected:
+    libsarus::PathRAII testDirRAII =
+        libsarus::PathRAII{libsarus::filesystem::makeUniquePathWithRandomSuffix(
+            "/tmp/sarus-test-sharedlibindex")};
+    boost::filesystem::path rootDir = testDirRAII.getPath() / "rootfs";
+    boost::filesystem::path indexFile =
+        testDirRAII.getPath() / "cache/sharedlibs.idx";
+};
+
+TEST_F(SharedLibIndexTest, entries_from_dynamic_linker) {
+    auto index = libsarus::SharedLibIndex{indexFile, rootDir};
+    auto entries = index.getEntriesFromDynamicLinker("ldconfig");
+    EXPECT_TRUE(index.isModified());
+    sortByPath(entries);
+
+    ASSERT_EQ(entries.size(), 2);
+    EXPECT_EQ(entries[0].path, "/lib64/ld-linux-x86-64.so.2");
+    EXPECT_EQ(entries[0].realPath, "/lib64/ld-linux-x86-64.so.2");
+    EXPECT_EQ(entries[0].linkerName, "ld-linux-x86-64.so");
+    ASSERT_TRUE(entries[0].soname);
+    EXPECT_EQ(*entries[0].soname, "ld-linux-x86-64.so.2");
+    EXPECT_EQ(entries[0].abi, std::vector<std::string>{"2"});
+
+    EXPECT_EQ(entries[1].path, "/lib64/libc.so.6");
+    EXPECT_EQ(entries[1].realPath, "/lib64/libc-2.31.so");
+    EXPECT_EQ(entries[1].linkerName, "libc.so");
+    ASSERT_TRUE(entries[1].soname);
+    EXPECT_EQ(*entries[1].soname, "libc.so.6");
+    EXPECT_EQ(entries[1].abi, std::vector<std::string>{"6"});
+
+    for (const auto &entry : entries) {
+        EXPECT_EQ(entry.elfClass, ELFCLASS64);
+        EXPECT_EQ(entry.machine, EM_X86_64);
+        EXPECT_EQ(entry.abi, libsarus::sharedlibs::resolveAbi(entry.path,
+                                                              rootDir));
+        EXPECT_EQ(*entry.soname,
+                  libsarus::sharedlibs::getSoname(rootDir / entry.path));
+    }
+
+    index.save();
+    EXPECT_FALSE(index.isModified());
+    EXPECT_TRUE(boost::filesystem::exists(indexFile));
+}
+
+TEST_F(SharedLibIndexTest, entries_are_reused_from_index_file) {
+    auto expectedEntries = std::vector<SharedLibIndex::Entry>{};
+    {
+        auto index = libsarus::SharedLibIndex{indexFile, rootDir};
+        expectedEntries = index.getEntriesFromDynamicLinker("ldconfig");
+        expectedEntries.push_back(index.getEntry("/lib/libc.so.6"));
+        index.save();
+    }
+
+    auto index = libsarus::SharedLibIndex{indexFile, rootDir};
+    auto entries = index.getEntriesFromDynamicLinker("ldconfig");
+    entries.push_back(index.getEntry("/lib/libc.so.6"));
+    EXPECT_FALSE(index.isModified());
+    ASSERT_EQ(entries.size(), expectedEntries.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        expectEqual(entries[i], expectedEntries[i]);
+    }
+    EXPECT_EQ(entries.back().realPath, "/lib64/libc-2.31.so");
+}
+
+TEST_F(SharedLibIndexTest, changed_library_is_reindexed) {
+    {
+        auto index = libsarus::SharedLibIndex{indexFile, rootDir};
+        index.getEntriesFromDynamicLinker("ldconfig");
+        index.save();
+    }
+
+    // replace libc with a 32-bit library
+    auto lib = rootDir / "lib64/libc-2.31.so";
+    libsarus::filesystem::copyFile(rootDir / "lib32/libc.so.6", lib);
+    boost::filesystem::last_write_time(lib, 0);
+
+    auto index = libsarus::SharedLibIndex{indexFile, rootDir};
+    auto entry = index.getEntry("/lib64/libc.so.6");
+    EXPECT_TRUE(index.isModified());
+    EXPECT_EQ(entry.elfClass, ELFCLASS32);
+    EXPECT_EQ(entry.machine, EM_386);
+
+    // the other entries are still valid
+    index.getEntry("/lib64/ld-linux-x86-64.so.2");
+    index.save();
+    {
+        auto index = libsarus::SharedLibIndex{indexFile, rootDir};
+        auto entries = index.getEntriesFromDynamicLinker("ldconfig");
+        EXPECT_FALSE(index.isModified());
+        sortByPath(entries);
+        ASSERT_EQ(entries.size(), 2);
+        EXPECT_EQ(entries[1].elfClass, ELFCLASS32);
+    }
+}
+
+TEST_F(SharedLibIndexTest, changed_links_are_reresolved) {
+    {
+        auto index = libsarus::SharedLibIndex{indexFile, rootDir};
+        index.getEntriesFromDynamicLinker("ldconfig");
+        index.save();
+    }
+
+    // new libc version, ldconfig updates the link and the cache
+    boost::filesystem::rename(rootDir / "lib64/libc-2.31.so",
+                              rootDir / "lib64/libc-2.32.so");
+    libsarus::process::executeCommand("ldconfig -r " + rootDir.string());
+
+    auto index = libsarus::SharedLibIndex{indexFile, rootDir};
+    auto entries = index.getEntriesFromDynamicLinker("ldconfig");
+    sortByPath(entries);
+    ASSERT_EQ(entries.size(), 2);
+    EXPECT_EQ(entries[1].realPath, "/lib64/libc-2.32.so");
+}
+
+TEST_F(SharedLibIndexTest, invalid_index_file_is_ignored) {
+    libsarus::filesystem::writeTextFile("invalid index", indexFile);
+
+    auto index = libsarus::SharedLibIndex{indexFile, rootDir};
+    auto entries = index.getEntriesFromDynamicLinker("ldconfig");
+    EXPECT_EQ(entries.size(), 2);
+    index.save();
+
+    // index built for a different root directory
+    auto otherIndex =
+        libsarus::SharedLibIndex{indexFile, testDirRAII.getPath()};
+    EXPECT_THROW(otherIndex.getEntry("/lib64/libc.so.6"), libsarus::Error);
+    EXPECT_FALSE(otherIndex.isModified());
+}
+
+}  // namespace test
+}  // namespace libsarus
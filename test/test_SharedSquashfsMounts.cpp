@@ -0,0 +1,195 @@
+/*
+ * Sarus
+ *
+ * Copyright (c) 2018-2023, ETH Zurich. All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ */
+
+#include <sched.h>
+#include <sys/mount.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <boost/filesystem.hpp>
+#include <gtest/gtest.h>
+
+#include "libsarus/Error.hpp"
+#include "libsarus/PathRAII.hpp"
+#include "libsarus/SharedSquashfsMounts.hpp"
+#include "libsarus/Utility.hpp"
+#include "libsarus/test/aux/misc.hpp"
+
+namespace libsarus {
+namespace test {
+
+class SharedSquashfsMountsTest : public testing::Test {
+  protected:
+    libsarus::PathRAII tempDirRAII{
+        libsarus::filesystem::makeUniquePathWithRandomSuffix(
+            "/tmp/sarus-test-SharedSquashfsMounts")};
+    boost::filesystem::path cacheDir = tempDirRAII.getPath() / "cache";
+    boost::filesystem::path image =
+        boost::filesystem::path{__FILE__}.parent_path() / "test_image.squashfs";
+};
+
+TEST_F(SharedSquashfsMountsTest, acquire_and_release) {
+    auto mounts = libsarus::SharedSquashfsMounts{cacheDir};
+
+    auto mountPoint = mounts.acquire(image);
+    EXPECT_EQ(mountPoint, mounts.getMountPoint(image));
+    EXPECT_TRUE(
+        boost::filesystem::exists(mountPoint / "file_in_squashfs_image"));
+    EXPECT_EQ(mounts.getNumberOfReferences(mountPoint), 1);
+
+    // the image is mounted once
+    EXPECT_EQ(mounts.acquire(image), mountPoint);
+    EXPECT_EQ(mounts.getNumberOfReferences(mountPoint), 2);
+
+    mounts.release(mountPoint);
+    EXPECT_EQ(mounts.getNumberOfReferences(mountPoint), 1);
+    EXPECT_TRUE(
+        boost::filesystem::exists(mountPoint / "file_in_squashfs_image"));
+
+    // the last release unmounts the image
+    mounts.release(mountPoint);
+    EXPECT_EQ(mounts.getNumberOfReferences(mountPoint), 0);
+    EXPECT_FALSE(boost::filesystem::exists(mountPoint));
+
+    EXPECT_THROW(mounts.release(mountPoint), libsarus::Error);
+}
+
+TEST_F(SharedSquashfsMountsTest, bindMount) {
+    auto mounts = libsarus::SharedSquashfsMounts{cacheDir};
+    auto destination1 = tempDirRAII.getPath() / "container1";
+    auto destination2 = tempDirRAII.getPath() / "container2";
+    libsarus::filesystem::createFoldersIfNecessary(destination1);
+    libsarus::filesystem::createFoldersIfNecessary(destination2);
+
+    auto mountPoint = mounts.bindMount(image, destination1);
+    EXPECT_EQ(mounts.bindMount(image, destination2), mountPoint);
+    EXPECT_EQ(mounts.getNumberOfReferences(mountPoint), 2);
+    EXPECT_TRUE(
+        boost::filesystem::exists(destination1 / "file_in_squashfs_image"));
+    EXPECT_TRUE(
+        boost::filesystem::exists(destination2 / "file_in_squashfs_image"));
+
+    // the bind mounts outlive the lazy unmount of the shared mount
+    mounts.release(mountPoint);
+    mounts.release(mountPoint);
+    EXPECT_TRUE(
+        boost::filesystem::exists(destination1 / "file_in_squashfs_image"));
+
+    EXPECT_EQ(umount(destination1.c_str()), 0);
+    EXPECT_EQ(umount(destination2.c_str()), 0);
+}
+
+TEST_F(SharedSquashfsMountsTest, references_of_terminated_owners_are_dropped) {
+    auto mounts = libsarus::SharedSquashfsMounts{cacheDir};
+
+    // the child terminates without releasing its reference
+    auto pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+        try {
+            libsarus::SharedSquashfsMounts{cacheDir}.acquire(image);
+        } catch (...) {
+            _exit(1);
+        }
+        _exit(0);
+    }
+    int status;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    auto mountPoint = mounts.getMountPoint(image);
+    EXPECT_EQ(mounts.getNumberOfReferences(mountPoint), 1);
+
+    EXPECT_EQ(mounts.acquire(image), mountPoint);
+    EXPECT_EQ(mounts.getNumberOfReferences(mountPoint), 1);
+
+    mounts.release(mountPoint);
+    EXPECT_FALSE(boost::filesystem::exists(mountPoint));
+}
+
+TEST_F(SharedSquashfsMountsTest, other_mount_namespaces_keep_their_references) {
+    int toParent[2], toChild[2];
+    ASSERT_EQ(pipe(toParent), 0);
+    ASSERT_EQ(pipe(toChild), 0);
+
+    // the child acquires the image in a new mount namespace, where the mount
+    // isn't visible to the parent
+    auto pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+        char c = 0;
+        try {
+            if (unshare(CLONE_NEWNS) != 0 ||
+                ::mount(nullptr, "/", nullptr, MS_REC | MS_PRIVATE, nullptr) !=
+                    0) {
+                _exit(1);
+            }
+            auto mounts = libsarus::SharedSquashfsMounts{cacheDir};
+            auto mountPoint = mounts.acquire(image);
+            if (write(toParent[1], &c, 1) != 1 ||
+                read(toChild[0], &c, 1) != 1) {
+                _exit(1);
+            }
+            // the parent neither dropped the reference nor removed the mount
+            if (!boost::filesystem::exists(mountPoint /
+                                           "file_in_squashfs_image")) {
+                _exit(2);
+            }
+            mounts.release(mountPoint);
+        } catch (...) {
+            _exit(3);
+        }
+        _exit(0);
+    }
+
+    char c = 0;
+    ASSERT_EQ(read(toParent[0], &c, 1), 1);
+    auto mounts = libsarus::SharedSquashfsMounts{cacheDir};
+    auto mountPoint = mounts.acquire(image);
+    EXPECT_EQ(mounts.getNumberOfReferences(mountPoint), 1);
+    mounts.release(mountPoint);
+    EXPECT_EQ(mounts.getNumberOfReferences(mountPoint), 0);
+    ASSERT_EQ(write(toChild[1], &c, 1), 1);
+
+    int status;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    EXPECT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+    EXPECT_FALSE(boost::filesystem::exists(mountPoint));
+    for (auto fd : {toParent[0], toParent[1], toChild[0], toChild[1]}) {
+        close(fd);
+    }
+}
+
+TEST_F(SharedSquashfsMountsTest, unsafe_cache_directory_is_refused) {
+    // created with mode 0700
+    libsarus::SharedSquashfsMounts{cacheDir};
+    EXPECT_EQ(boost::filesystem::status(cacheDir).permissions(),
+              boost::filesystem::owner_all);
+
+    boost::filesystem::permissions(cacheDir, boost::filesystem::perms(0777));
+    EXPECT_THROW(libsarus::SharedSquashfsMounts{cacheDir}, libsarus::Error);
+    boost::filesystem::permissions(cacheDir, boost::filesystem::perms(0755));
+    EXPECT_NO_THROW(libsarus::SharedSquashfsMounts{cacheDir});
+
+    uid_t uid;
+    gid_t gid;
+    std::tie(uid, gid) = aux::misc::getNonRootUserIds();
+    ASSERT_EQ(chown(cacheDir.c_str(), uid, gid), 0);
+    EXPECT_THROW(libsarus::SharedSquashfsMounts{cacheDir}, libsarus::Error);
+
+    auto link = tempDirRAII.getPath() / "link";
+    ASSERT_EQ(chown(cacheDir.c_str(), 0, 0), 0);
+    boost::filesystem::create_directory_symlink(cacheDir, link);
+    EXPECT_THROW(libsarus::SharedSquashfsMounts{link}, libsarus::Error);
+}
+
+}  // namespace test
+}  // namespace libsarus
@@ -9,9 +9,15 @@
  */
 
 #include <array>
+#include <atomic>
+#include <map>
+#include <numeric>
 
+#include <dirent.h>
+#include <gnu/libc-version.h>
 #include <sys/fsuid.h>
 #include <sys/stat.h>
+#include <sys/sysmacros.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -20,7 +26,11 @@
 #include <boost/regex.hpp>
 #include <gtest/gtest.h>
 
+#include "libsarus/AtomicWriteBatch.hpp"
+#include "libsarus/DirectoryScanner.hpp"
+#include "libsarus/FileView.hpp"
 #include "libsarus/PathRAII.hpp"
+#include "libsarus/SyscallBatch.hpp"
 #include "libsarus/Utility.hpp"
 #include "libsarus/test/aux/misc.hpp"
 
@@ -210,6 +220,38 @@ TEST_F(UtilityTest, makeUniquePathWithRandomSuffix) {
                                    expectedRegex));
 }
 
+TEST_F(UtilityTest, createUniquePaths) {
+    auto testDirRAII =
+        libsarus::PathRAII{libsarus::filesystem::makeUniquePathWithRandomSuffix(
+            "/tmp/sarus-test-uniquepaths")};
+    const auto &testDir = testDirRAII.getPath();
+    libsarus::filesystem::createFoldersIfNecessary(testDir);
+
+    auto expectedRegex =
+        boost::regex("^" + (testDir / "path").string() + "-[a-z]{16}$");
+
+    auto file0 = libsarus::filesystem::createUniqueFile(testDir / "path");
+    auto file1 = libsarus::filesystem::createUniqueFile(testDir / "path");
+    EXPECT_TRUE(file0.fd.isValid());
+    EXPECT_TRUE(boost::regex_match(file0.path.string(), expectedRegex));
+    EXPECT_TRUE(boost::filesystem::is_regular_file(file0.path));
+    EXPECT_NE(file0.path, file1.path);
+
+    auto dir = libsarus::filesystem::createUniqueDirectory(testDir / "path");
+    EXPECT_TRUE(dir.fd.isValid());
+    EXPECT_TRUE(boost::regex_match(dir.path.string(), expectedRegex));
+    EXPECT_TRUE(boost::filesystem::is_directory(dir.path));
+
+    // the anonymous file doesn't show up in the directory
+    auto anonymousFile = libsarus::filesystem::createAnonymousFile(dir.path);
+    EXPECT_TRUE(anonymousFile.isValid());
+    EXPECT_EQ(libsarus::filesystem::countFilesInDirectory(dir.path), 0);
+
+    EXPECT_THROW(
+        libsarus::filesystem::createUniqueFile(testDir / "missing/path"),
+        libsarus::Error);
+}
+
 TEST_F(UtilityTest, createFoldersIfNecessary) {
     if (boost::filesystem::exists("/tmp/grandparent"))
         boost::filesystem::remove_all("/tmp/grandparent");
@@ -229,6 +271,32 @@ TEST_F(UtilityTest, createFoldersIfNecessary) {
     EXPECT_EQ(libsarus::filesystem::getOwner("/tmp/grandparent/parent/child"),
               (std::tuple<uid_t, gid_t>{1000, 1000}));
     boost::filesystem::remove_all("/tmp/grandparent");
+
+    // batch of folders with common ancestors
+    libsarus::filesystem::createFoldersIfNecessary(
+        std::vector<boost::filesystem::path>{"/tmp/grandparent/parent/child0",
+                                             "/tmp/grandparent/parent/child1",
+                                             "/tmp/grandparent/uncle"},
+        1000, 1000);
+    EXPECT_EQ(libsarus::filesystem::getOwner("/tmp/grandparent"),
+              (std::tuple<uid_t, gid_t>{1000, 1000}));
+    EXPECT_EQ(libsarus::filesystem::getOwner("/tmp/grandparent/parent/child1"),
+              (std::tuple<uid_t, gid_t>{1000, 1000}));
+    EXPECT_TRUE(boost::filesystem::is_directory("/tmp/grandparent/uncle"));
+
+    // batch of folders probed through io_uring
+    libsarus::filesystem::createFoldersIfNecessary(
+        std::vector<boost::filesystem::path>{"/tmp/grandparent/parent/child1",
+                                             "/tmp/grandparent/aunt"},
+        -1, -1, true);
+    EXPECT_TRUE(boost::filesystem::is_directory("/tmp/grandparent/aunt"));
+
+    // existing non-directory
+    libsarus::filesystem::createFileIfNecessary("/tmp/grandparent/file");
+    EXPECT_THROW(libsarus::filesystem::createFoldersIfNecessary(
+                     "/tmp/grandparent/file/child"),
+                 libsarus::Error);
+    boost::filesystem::remove_all("/tmp/grandparent");
 }
 
 TEST_F(UtilityTest, createFileIfNecessary) {
@@ -299,9 +367,152 @@ TEST_F(UtilityTest, copyFolder) {
     EXPECT_EQ(libsarus::filesystem::getOwner("/tmp/dst-folder/subfolder/file1"),
               (std::tuple<uid_t, gid_t>{1000, 1000}));
     boost::filesystem::remove_all("/tmp/dst-folder");
+
+    // contents, permissions and symlinks
+    auto content = std::string(1 << 20, 'x');
+    libsarus::filesystem::writeTextFile(content,
+                                        "/tmp/src-folder/subfolder/file2");
+    boost::filesystem::permissions("/tmp/src-folder/subfolder/file2",
+                                   boost::filesystem::perms(0750));
+    boost::filesystem::create_symlink("subfolder/file2",
+                                      "/tmp/src-folder/link-to-file");
+    boost::filesystem::create_symlink("subfolder",
+                                      "/tmp/src-folder/link-to-folder");
+    libsarus::filesystem::copyFolder("/tmp/src-folder", "/tmp/dst-folder", -1,
+                                     -1, 2);
+    for (const auto *file :
+         {"subfolder/file2", "link-to-file", "link-to-folder/file2"}) {
+        auto path = boost::filesystem::path{"/tmp/dst-folder"} / file;
+        EXPECT_FALSE(boost::filesystem::is_symlink(path));
+        EXPECT_EQ(libsarus::filesystem::readFile(path), content);
+        EXPECT_EQ(boost::filesystem::status(path).permissions(),
+                  boost::filesystem::perms(0750));
+    }
+    EXPECT_TRUE(boost::filesystem::is_regular_file(
+        "/tmp/dst-folder/link-to-folder/file1"));
+    boost::filesystem::remove_all("/tmp/dst-folder");
+
+    // folders walked through io_uring
+    libsarus::filesystem::copyFolder("/tmp/src-folder", "/tmp/dst-folder", -1,
+                                     -1, 2, true);
+    EXPECT_EQ(libsarus::filesystem::readFile("/tmp/dst-folder/link-to-file"),
+              content);
+    EXPECT_TRUE(boost::filesystem::is_regular_file(
+        "/tmp/dst-folder/link-to-folder/file1"));
+    boost::filesystem::remove_all("/tmp/dst-folder");
+
+    // the set-user-ID and set-group-ID bits are dropped by a change of owner
+    boost::filesystem::permissions("/tmp/src-folder/subfolder/file2",
+                                   boost::filesystem::perms(06755));
+    libsarus::filesystem::copyFolder("/tmp/src-folder", "/tmp/dst-folder");
+    EXPECT_EQ(
+        boost::filesystem::status("/tmp/dst-folder/subfolder/file2")
+            .permissions(),
+        boost::filesystem::perms(06755));
+    boost::filesystem::remove_all("/tmp/dst-folder");
+    libsarus::filesystem::copyFolder("/tmp/src-folder", "/tmp/dst-folder", 1000,
+                                     1000);
+    EXPECT_EQ(
+        boost::filesystem::status("/tmp/dst-folder/subfolder/file2")
+            .permissions(),
+        boost::filesystem::perms(0755));
+    boost::filesystem::remove_all("/tmp/dst-folder");
+
+    // the destination must not exist
+    EXPECT_THROW(libsarus::filesystem::copyFolder("/tmp/src-folder",
+                                                  "/tmp/src-folder/subfolder"),
+                 libsarus::Error);
     boost::filesystem::remove_all("/tmp/src-folder");
 }
 
+TEST_F(UtilityTest, removeTree) {
+    auto testDirRAII =
+        libsarus::PathRAII{libsarus::filesystem::makeUniquePathWithRandomSuffix(
+            "/tmp/sarus-test-removetree")};
+    const auto &testDir = testDirRAII.getPath();
+
+    auto makeTree = [](const boost::filesystem::path &root) {
+        for (const auto &dir : {"a/b/c", "a/d", "e"}) {
+            libsarus::filesystem::createFoldersIfNecessary(root / dir);
+            libsarus::filesystem::createFileIfNecessary(root / dir / "file");
+        }
+        boost::filesystem::create_symlink("/etc", root / "a/link");
+        // directory without owner write and search permissions
+        boost::filesystem::permissions(root / "a/d",
+                                       boost::filesystem::owner_read);
+    };
+
+    // foreground
+    makeTree(testDir / "tree");
+    libsarus::filesystem::removeTree(testDir / "tree", 2);
+    EXPECT_FALSE(boost::filesystem::exists(testDir / "tree"));
+    EXPECT_TRUE(boost::filesystem::exists("/etc"));
+
+    // tree with a single subdirectory, which is split among the threads
+    makeTree(testDir / "bundle/rootfs");
+    libsarus::filesystem::removeTree(testDir / "bundle", 4);
+    EXPECT_FALSE(boost::filesystem::exists(testDir / "bundle"));
+
+    // foreground through io_uring
+    makeTree(testDir / "tree");
+    libsarus::filesystem::removeTree(testDir / "tree", 2, true);
+    EXPECT_FALSE(boost::filesystem::exists(testDir / "tree"));
+
+    // non-existing path and file
+    libsarus::filesystem::removeTree(testDir / "missing");
+    libsarus::filesystem::createFileIfNecessary(testDir / "file");
+    libsarus::filesystem::removeTree(testDir / "file");
+    EXPECT_FALSE(boost::filesystem::exists(testDir / "file"));
+
+    // unprivileged owner, the parent of the tree is left untouched
+    {
+        uid_t unprivilegedUid;
+        gid_t unprivilegedGid;
+        std::tie(unprivilegedUid, unprivilegedGid) =
+            aux::misc::getNonRootUserIds();
+        auto parent = testDir / "parent";
+        libsarus::filesystem::createFoldersIfNecessary(
+            parent / "tree/dir", unprivilegedUid, unprivilegedGid);
+        libsarus::filesystem::createFileIfNecessary(
+            parent / "tree/dir/file", unprivilegedUid, unprivilegedGid);
+        boost::filesystem::permissions(testDir, boost::filesystem::perms(0755));
+        boost::filesystem::permissions(parent, boost::filesystem::perms(0755));
+        boost::filesystem::permissions(parent / "tree",
+                                       boost::filesystem::no_perms);
+
+        libsarus::process::switchIdentity(
+            libsarus::UserIdentity{unprivilegedUid, unprivilegedGid, {}});
+        EXPECT_NO_THROW(libsarus::filesystem::removeTree(parent / "tree"));
+        libsarus::process::switchIdentity(libsarus::UserIdentity{});
+
+        EXPECT_FALSE(boost::filesystem::exists(parent / "tree"));
+        EXPECT_EQ(boost::filesystem::status(parent).permissions(),
+                  boost::filesystem::perms(0755));
+    }
+
+    // background
+    makeTree(testDir / "tree");
+    auto removal = libsarus::filesystem::removeTreeInBackground(
+        testDir / "tree", testDir / "trash");
+    EXPECT_FALSE(boost::filesystem::exists(testDir / "tree"));
+    removal.get();
+    EXPECT_EQ(libsarus::filesystem::countFilesInDirectory(testDir / "trash"),
+              0);
+
+    // PathRAII with a trash directory
+    makeTree(testDir / "tree");
+    { libsarus::PathRAII{testDir / "tree", testDir / "trash"}; }
+    EXPECT_FALSE(boost::filesystem::exists(testDir / "tree"));
+
+    // PathRAII removing through io_uring
+    makeTree(testDir / "tree");
+    {
+        auto treeRAII = libsarus::PathRAII{testDir / "tree"};
+        treeRAII.setUseIoUring(true);
+    }
+    EXPECT_FALSE(boost::filesystem::exists(testDir / "tree"));
+}
+
 TEST_F(UtilityTest, countFilesInDirectory) {
     // nominal usage
     {
@@ -335,6 +546,292 @@ TEST_F(UtilityTest, countFilesInDirectory) {
     }
 }
 
+TEST_F(UtilityTest, fingerprintTree) {
+    auto testDirRAII =
+        libsarus::PathRAII{libsarus::filesystem::makeUniquePathWithRandomSuffix(
+            "/tmp/sarus-test-fingerprinttree")};
+    const auto &testDir = testDirRAII.getPath();
+    auto tree = testDir / "tree";
+    auto manifest = testDir / "manifest";
+    libsarus::filesystem::writeTextFile("content", tree / "dir/file");
+    boost::filesystem::create_symlink("dir/file", tree / "link");
+
+    // stat-based fingerprint
+    auto fingerprint = libsarus::filesystem::fingerprintTree(tree);
+    EXPECT_EQ(libsarus::filesystem::fingerprintTree(tree), fingerprint);
+    libsarus::filesystem::writeTextFile("modified", tree / "dir/file");
+    EXPECT_NE(libsarus::filesystem::fingerprintTree(tree), fingerprint);
+
+    // content-based fingerprint, with a manifest
+    fingerprint = libsarus::filesystem::fingerprintTree(tree, true, manifest);
+    EXPECT_TRUE(boost::filesystem::exists(manifest));
+    EXPECT_EQ(libsarus::filesystem::fingerprintTree(tree, true, manifest),
+              fingerprint);
+    libsarus::filesystem::copyFolder(tree / "dir", testDir / "copy/dir");
+    boost::filesystem::create_symlink("dir/file", testDir / "copy/link");
+    EXPECT_EQ(libsarus::filesystem::fingerprintTree(testDir / "copy", true),
+              fingerprint);
+
+    libsarus::filesystem::writeTextFile("modified again", tree / "dir/file");
+    EXPECT_NE(libsarus::filesystem::fingerprintTree(tree, true, manifest),
+              fingerprint);
+    boost::filesystem::remove(tree / "link");
+    boost::filesystem::create_symlink("dir", tree / "link");
+    auto previousFingerprint =
+        libsarus::filesystem::fingerprintTree(tree, true, manifest);
+    libsarus::filesystem::createFoldersIfNecessary(tree / "dir/subdir");
+    EXPECT_NE(libsarus::filesystem::fingerprintTree(tree, true, manifest),
+              previousFingerprint);
+
+    // the manifest prevents re-reading the files whose metadata didn't change:
+    // modify the content of a file without changing its size and mtime
+    fingerprint = libsarus::filesystem::fingerprintTree(tree, true, manifest);
+    struct stat fileStat;
+    ASSERT_EQ(stat((tree / "dir/file").c_str(), &fileStat), 0);
+    libsarus::filesystem::writeTextFile("MODIFIED AGAIN", tree / "dir/file");
+    struct timespec times[] = {fileStat.st_atim, fileStat.st_mtim};
+    ASSERT_EQ(utimensat(AT_FDCWD, (tree / "dir/file").c_str(), times, 0), 0);
+    EXPECT_EQ(libsarus::filesystem::fingerprintTree(tree, true, manifest),
+              fingerprint);
+    EXPECT_NE(libsarus::filesystem::fingerprintTree(tree, true), fingerprint);
+
+    // directories of different sizes with the same content
+    libsarus::filesystem::createFoldersIfNecessary(testDir / "large/dir");
+    libsarus::filesystem::createFoldersIfNecessary(testDir / "small/dir");
+    for (int i = 0; i < 1000; ++i) {
+        libsarus::filesystem::createFileIfNecessary(
+            testDir / "large/dir" / ("file" + std::to_string(i)));
+    }
+    for (int i = 0; i < 1000; ++i) {
+        boost::filesystem::remove(testDir / "large/dir" /
+                                  ("file" + std::to_string(i)));
+    }
+    EXPECT_EQ(libsarus::filesystem::fingerprintTree(testDir / "large", true),
+              libsarus::filesystem::fingerprintTree(testDir / "small", true));
+
+    // files read in multiple chunks: the last byte is hashed too
+    auto content = std::string(200000, 'x');
+    libsarus::filesystem::writeTextFile(content, testDir / "chunks/file");
+    fingerprint =
+        libsarus::filesystem::fingerprintTree(testDir / "chunks", true);
+    content.back() = 'y';
+    libsarus::filesystem::writeTextFile(content, testDir / "chunks/file");
+    EXPECT_NE(libsarus::filesystem::fingerprintTree(testDir / "chunks", true),
+              fingerprint);
+
+    // a manifest within the tree is left out of the fingerprint
+    fingerprint = libsarus::filesystem::fingerprintTree(tree, true);
+    EXPECT_EQ(libsarus::filesystem::fingerprintTree(tree, true,
+                                                    tree / "manifest"),
+              fingerprint);
+    EXPECT_EQ(libsarus::filesystem::fingerprintTree(tree, true,
+                                                    tree / "manifest"),
+              fingerprint);
+}
+
+TEST_F(UtilityTest, DirectoryScanner) {
+    auto testDirRAII =
+        libsarus::PathRAII{libsarus::filesystem::makeUniquePathWithRandomSuffix(
+            "/tmp/sarus-test-directoryscanner")};
+    const auto &testDir = testDirRAII.getPath();
+    libsarus::filesystem::createFoldersIfNecessary(testDir / "dir");
+    libsarus::filesystem::createFileIfNecessary(testDir / "file");
+    boost::filesystem::create_symlink("file", testDir / "link");
+
+    // a small buffer requires multiple getdents64(2) calls
+    auto scanner = libsarus::DirectoryScanner{64};
+    for (int i = 0; i < 2; ++i) {
+        auto entries = std::map<std::string, unsigned char>{};
+        scanner.scan(testDir,
+                     [&entries](const libsarus::DirectoryEntry &entry) {
+                         entries[std::string{entry.name}] = entry.type;
+                     });
+        auto expectedEntries = std::map<std::string, unsigned char>{
+            {"dir", DT_DIR}, {"file", DT_REG}, {"link", DT_LNK}};
+        EXPECT_EQ(entries, expectedEntries);
+    }
+
+    EXPECT_THROW(
+        scanner.scan(testDir / "file", [](const libsarus::DirectoryEntry &) {}),
+        libsarus::Error);
+}
+
+TEST_F(UtilityTest, SyscallBatch) {
+    auto testDirRAII =
+        libsarus::PathRAII{libsarus::filesystem::makeUniquePathWithRandomSuffix(
+            "/tmp/sarus-test-syscallbatch")};
+    const auto &testDir = testDirRAII.getPath();
+    libsarus::filesystem::createFoldersIfNecessary(testDir);
+    auto dirFd = libsarus::FileDescriptor{
+        open(testDir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)};
+
+    // the same calls on io_uring (if available) and synchronously; the batches
+    // exceed the queue depth and the minimum size of io_uring batches
+    for (auto useIoUring : {true, false}) {
+        auto batch = libsarus::SyscallBatch{8, useIoUring};
+        auto count = 2 * libsarus::SyscallBatch::minimumRingBatchSize;
+        for (size_t i = 0; i < count; ++i) {
+            batch.mkdirat(dirFd.get(), "dir" + std::to_string(i), 0700);
+        }
+        batch.mkdirat(dirFd.get(), "missing/dir", 0700);
+        batch.submit();
+        for (size_t i = 0; i < count; ++i) {
+            EXPECT_EQ(batch.getResult(i), 0);
+        }
+        EXPECT_EQ(batch.getResult(count), -ENOENT);
+
+        batch.clear();
+        auto buffers = std::vector<struct statx>(count);
+        for (size_t i = 0; i < count; ++i) {
+            batch.statx(dirFd.get(), "dir" + std::to_string(i), 0, STATX_TYPE,
+                        &buffers[i]);
+        }
+        auto openIndex = batch.openat(dirFd.get(), "dir0",
+                                      O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        auto chownIndex =
+            batch.fchownat(dirFd.get(), "dir1", getuid(), getgid(), 0);
+        batch.submit();
+        for (size_t i = 0; i < count; ++i) {
+            EXPECT_EQ(batch.getResult(i), 0);
+            EXPECT_TRUE(S_ISDIR(buffers[i].stx_mode));
+        }
+        EXPECT_GE(batch.getResult(openIndex), 0);
+        EXPECT_EQ(batch.getResult(chownIndex), 0);
+
+        auto fd = batch.getResult(openIndex);
+        batch.clear();
+        batch.close(fd);
+        for (size_t i = 0; i < count; ++i) {
+            batch.unlinkat(dirFd.get(), "dir" + std::to_string(i),
+                           AT_REMOVEDIR);
+        }
+        batch.submit();
+        for (size_t i = 0; i < batch.size(); ++i) {
+            EXPECT_EQ(batch.getResult(i), 0);
+        }
+        EXPECT_EQ(libsarus::filesystem::countFilesInDirectory(testDir), 0);
+        if (!useIoUring) {
+            EXPECT_FALSE(batch.isUsingIoUring());
+        }
+    }
+}
+
+TEST_F(UtilityTest, readFile) {
+    auto testDirRAII =
+        libsarus::PathRAII{libsarus::filesystem::makeUniquePathWithRandomSuffix(
+            "/tmp/sarus-test-readfile")};
+    const auto &testDir = testDirRAII.getPath();
+
+    // empty, small (read) and large (memory-mapped) files
+    for (auto size : {0, 10, 1 << 20}) {
+        auto content = std::string(size, 'x');
+        auto file = testDir / ("file" + std::to_string(size));
+        libsarus::filesystem::writeTextFile(content, file);
+        auto fileView = libsarus::FileView{file};
+        EXPECT_EQ(fileView.getPath(), file);
+        EXPECT_EQ(fileView.view(), content);
+        EXPECT_EQ(libsarus::filesystem::readFile(file), content);
+    }
+
+    // files of pseudo-filesystems report a zero size
+    auto mountinfo = libsarus::FileView{"/proc/self/mountinfo"};
+    EXPECT_FALSE(mountinfo.view().empty());
+    EXPECT_EQ(mountinfo.view().back(), '\n');
+
+    // the view survives a move
+    auto movedMountinfo = std::move(mountinfo);
+    EXPECT_NE(movedMountinfo.view().find(" / "), std::string_view::npos);
+
+    // unlike FileView, readFile returns an empty string for a missing file
+    EXPECT_THROW(libsarus::FileView{testDir / "missing"}, libsarus::Error);
+    EXPECT_EQ(libsarus::filesystem::readFile(testDir / "missing"), "");
+}
+
+TEST_F(UtilityTest, writeTextFileAtomically) {
+    auto testDirRAII =
+        libsarus::PathRAII{libsarus::filesystem::makeUniquePathWithRandomSuffix(
+            "/tmp/sarus-test-atomicwrite")};
+    const auto &testDir = testDirRAII.getPath();
+
+    // new file in a new folder
+    auto file = testDir / "subdir/file.txt";
+    libsarus::filesystem::writeTextFileAtomically("content", file);
+    EXPECT_EQ(libsarus::filesystem::readFile(file), "content");
+
+    // replaced file keeps its permissions
+    boost::filesystem::permissions(file, boost::filesystem::owner_read |
+                                             boost::filesystem::owner_write);
+    libsarus::filesystem::writeTextFileAtomically("new content", file, false);
+    EXPECT_EQ(libsarus::filesystem::readFile(file), "new content");
+    EXPECT_EQ(boost::filesystem::status(file).permissions(),
+              boost::filesystem::owner_read | boost::filesystem::owner_write);
+
+    // batch: nothing is replaced before the commit
+    auto json = libsarus::json::parse(R"({"key": "value"})");
+    {
+        auto batch = libsarus::AtomicWriteBatch{};
+        libsarus::filesystem::writeTextFile("batch content", file, batch);
+        libsarus::json::write(json, testDir / "config.json", batch);
+        EXPECT_EQ(batch.size(), 2);
+        EXPECT_EQ(libsarus::filesystem::readFile(file), "new content");
+        EXPECT_FALSE(boost::filesystem::exists(testDir / "config.json"));
+
+        batch.commit();
+        EXPECT_EQ(batch.size(), 0);
+        EXPECT_EQ(libsarus::filesystem::readFile(file), "batch content");
+        EXPECT_EQ(libsarus::json::read(testDir / "config.json"), json);
+    }
+
+    // discarded batch leaves no temporary files behind
+    {
+        auto batch = libsarus::AtomicWriteBatch{};
+        batch.add(file, "discarded content");
+    }
+    EXPECT_EQ(libsarus::filesystem::readFile(file), "batch content");
+    EXPECT_EQ(libsarus::filesystem::countFilesInDirectory(testDir / "subdir"),
+              1);
+}
+
+TEST_F(UtilityTest, fileInfo) {
+    auto testDirRAII =
+        libsarus::PathRAII{libsarus::filesystem::makeUniquePathWithRandomSuffix(
+            "/tmp/sarus-test-fileinfo")};
+    auto file = testDirRAII.getPath() / "file";
+    libsarus::filesystem::writeTextFile("content", file);
+    boost::filesystem::permissions(file, boost::filesystem::perms(0640));
+
+    auto fileInfo = libsarus::FileInfo{file};
+    EXPECT_EQ(fileInfo.getPath(), file);
+    EXPECT_EQ(fileInfo.getFileType(), S_IFREG);
+    EXPECT_EQ(fileInfo.getMode(), S_IFREG | 0640);
+    EXPECT_EQ(fileInfo.getOwner(), libsarus::filesystem::getOwner(file));
+    EXPECT_EQ(fileInfo.getSize(), 7);
+    EXPECT_FALSE(libsarus::filesystem::isDeviceFile(fileInfo));
+    EXPECT_THROW(libsarus::filesystem::getDeviceType(fileInfo),
+                 libsarus::Error);
+
+    // symlinks are followed
+    boost::filesystem::create_symlink("/dev/null",
+                                      testDirRAII.getPath() / "null");
+    auto deviceInfo =
+        libsarus::FileInfo{testDirRAII.getPath() / "null", STATX_TYPE};
+    EXPECT_TRUE(libsarus::filesystem::isDeviceFile(deviceInfo));
+    EXPECT_TRUE(libsarus::filesystem::isCharacterDevice(deviceInfo));
+    EXPECT_FALSE(libsarus::filesystem::isBlockDevice(deviceInfo));
+    EXPECT_EQ(libsarus::filesystem::getDeviceType(deviceInfo), 'c');
+    EXPECT_EQ(libsarus::filesystem::getDeviceID(deviceInfo), makedev(1, 3));
+    EXPECT_EQ(libsarus::filesystem::getDeviceID(deviceInfo),
+              libsarus::filesystem::getDeviceID("/dev/null"));
+    // the size was not requested
+    EXPECT_THROW(deviceInfo.getSize(), libsarus::Error);
+
+    EXPECT_THROW(libsarus::FileInfo{testDirRAII.getPath() / "missing"},
+                 libsarus::Error);
+    EXPECT_THROW(
+        libsarus::filesystem::isDeviceFile(testDirRAII.getPath() / "missing"),
+        libsarus::Error);
+}
+
 TEST_F(UtilityTest, parseMap) {
     // empty list
     {
@@ -515,6 +1012,50 @@ TEST_F(UtilityTest, realpathWithinRootfs) {
               "/dir0/dir1");
 }
 
+TEST_F(UtilityTest, openWithinRootfs) {
+    auto path =
+        libsarus::PathRAII{libsarus::filesystem::makeUniquePathWithRandomSuffix(
+            "/tmp/sarus-rootfs")};
+    const auto &rootfs = path.getPath();
+
+    libsarus::filesystem::createFoldersIfNecessary(rootfs / "dir0/dir1");
+    libsarus::filesystem::createFileIfNecessary(rootfs / "dir0/dir1/file");
+    boost::filesystem::create_symlink("../../dir0/dir1",
+                                      rootfs / "dir0/dir1/link_relative");
+    boost::filesystem::create_symlink("/../../dir0",
+                                      rootfs / "link_absolute_that_spills");
+
+    auto checkPath = [&rootfs](const boost::filesystem::path &path,
+                               const boost::filesystem::path &expected,
+                               bool exists) {
+        auto result = libsarus::filesystem::openWithinRootfs(rootfs, path);
+        EXPECT_EQ(result.path, expected);
+        EXPECT_EQ(result.path,
+                  libsarus::filesystem::appendPathsWithinRootfs(rootfs, "/",
+                                                                path));
+        EXPECT_EQ(result.fd.isValid(), exists);
+        if (exists) {
+            struct stat expectedStat, actualStat;
+            ASSERT_EQ(stat((rootfs / expected).c_str(), &expectedStat), 0);
+            ASSERT_EQ(fstat(result.fd.get(), &actualStat), 0);
+            EXPECT_EQ(actualStat.st_dev, expectedStat.st_dev);
+            EXPECT_EQ(actualStat.st_ino, expectedStat.st_ino);
+        }
+    };
+
+    checkPath("/", "/", true);
+    checkPath("/dir0/dir1/file", "/dir0/dir1/file", true);
+    checkPath("/dir0/dir1/link_relative/file", "/dir0/dir1/file", true);
+    checkPath("/link_absolute_that_spills/dir1/link_relative",
+              "/dir0/dir1", true);
+    checkPath("/dir0/../../dir0/dir1", "/dir0/dir1", true);
+
+    // non-existing paths
+    checkPath("/dir0/dir1/link_relative/dir2/dir3", "/dir0/dir1/dir2/dir3",
+              false);
+    checkPath("/link_absolute_that_spills/missing", "/dir0/missing", false);
+}
+
 TEST_F(UtilityTest, getSharedLibLinkerName) {
     EXPECT_EQ(libsarus::sharedlibs::getLinkerName("file.so"), "file.so");
     EXPECT_EQ(libsarus::sharedlibs::getLinkerName("file.so.1"), "file.so");
@@ -646,6 +1187,221 @@ TEST_F(UtilityTest, resolveSharedLibAbi) {
         (std::vector<std::string>{"234"}));
 }
 
+TEST_F(UtilityTest, resolveSharedLibAbiBatch) {
+    auto testDirRaii =
+        libsarus::PathRAII{libsarus::filesystem::makeUniquePathWithRandomSuffix(
+            "/tmp/sarus-test-utility-resolveSharedLibAbiBatch")};
+    const auto &rootDir = testDirRaii.getPath();
+
+    // /lib -> /lib64
+    libsarus::filesystem::createFoldersIfNecessary(rootDir / "lib64");
+    boost::filesystem::create_symlink("/lib64", rootDir / "lib");
+
+    auto libs = std::vector<boost::filesystem::path>{};
+    auto expectedAbis = std::vector<std::vector<std::string>>{};
+    for (int i = 0; i < 32; ++i) {
+        auto name = "libtest" + std::to_string(i) + ".so";
+        libsarus::filesystem::createFileIfNecessary(rootDir / "lib64" /
+                                                    (name + ".1.2"));
+        boost::filesystem::create_symlink(name + ".1.2",
+                                          rootDir / "lib64" / (name + ".1"));
+        libs.push_back("/lib" / boost::filesystem::path(name + ".1"));
+        expectedAbis.push_back({"1", "2"});
+    }
+    libs.push_back("/lib/libtest0.so.1.2");
+    expectedAbis.push_back({"1", "2"});
+
+    for (auto numberOfThreads : {1u, 4u, 0u}) {
+        auto abis = libsarus::sharedlibs::resolveAbiBatch(libs, rootDir,
+                                                          numberOfThreads);
+        EXPECT_EQ(abis, expectedAbis);
+    }
+    for (size_t i = 0; i < libs.size(); ++i) {
+        EXPECT_EQ(libsarus::sharedlibs::resolveAbi(libs[i], rootDir),
+                  expectedAbis[i]);
+    }
+
+    // invalid library filename
+    libs.push_back("/lib/invalid");
+    EXPECT_THROW(libsarus::sharedlibs::resolveAbiBatch(libs, rootDir),
+                 libsarus::Error);
+
+    // empty batch
+    EXPECT_TRUE(libsarus::sharedlibs::resolveAbiBatch({}, rootDir).empty());
+}
+
+TEST_F(UtilityTest, planSharedLibBindMounts) {
+    using Library = libsarus::sharedlibs::Library;
+    EXPECT_TRUE(libsarus::sharedlibs::areAbiCompatible({"12", "1"}, {"12"}));
+    EXPECT_TRUE(libsarus::sharedlibs::areAbiCompatible({"12"}, {"12", "5"}));
+    EXPECT_TRUE(libsarus::sharedlibs::areAbiCompatible({}, {}));
+    EXPECT_FALSE(libsarus::sharedlibs::areAbiCompatible({"12"}, {"40"}));
+    EXPECT_FALSE(libsarus::sharedlibs::areAbiCompatible({}, {"1"}));
+
+    auto hostLibs = std::vector<Library>{
+        {"/host/libmpi.so.12.0.5", {"12", "0", "5"}},
+        {"/host/libmpi.so.12.10", {"12", "10"}},
+        {"/host/libmpi.so.12.9", {"12", "9"}},
+        {"/host/libfabric.so.1", {"1"}},
+        {"/host/libpmi.so", {}},
+    };
+    auto containerLibs = std::vector<Library>{
+        {"/usr/lib/libmpi.so.12", {"12"}},
+        {"/usr/lib/libmpi.so.12.0.5", {"12", "0", "5"}},
+        {"/usr/lib/libmpi.so.12.11", {"12", "11"}},
+        {"/usr/lib/libmpi.so.40", {"40"}},
+        {"/usr/lib/libc.so.6", {"6"}},
+    };
+
+    auto plan = libsarus::sharedlibs::planBindMounts(hostLibs, containerLibs,
+                                                     "/usr/lib/host");
+
+    ASSERT_EQ(plan.replacements.size(), 3);
+    // newest host library with fully compatible ABI
+    EXPECT_EQ(plan.replacements[0].source, "/host/libmpi.so.12.10");
+    EXPECT_EQ(plan.replacements[0].destination, "/usr/lib/libmpi.so.12");
+    // exact match
+    EXPECT_EQ(plan.replacements[1].source, "/host/libmpi.so.12.0.5");
+    EXPECT_EQ(plan.replacements[1].destination, "/usr/lib/libmpi.so.12.0.5");
+    // same major version, all host libraries are older
+    EXPECT_EQ(plan.replacements[2].source, "/host/libmpi.so.12.10");
+    EXPECT_EQ(plan.replacements[2].destination, "/usr/lib/libmpi.so.12.11");
+
+    ASSERT_EQ(plan.injections.size(), 2);
+    EXPECT_EQ(plan.injections[0].source, "/host/libfabric.so.1");
+    EXPECT_EQ(plan.injections[0].destination, "/usr/lib/host/libfabric.so.1");
+    EXPECT_EQ(plan.injections[1].source, "/host/libpmi.so");
+    EXPECT_EQ(plan.injections[1].destination, "/usr/lib/host/libpmi.so");
+
+    EXPECT_EQ(plan.incompatibleContainerLibs,
+              std::vector<boost::filesystem::path>{"/usr/lib/libmpi.so.40"});
+
+    // large container image
+    containerLibs.clear();
+    for (int i = 0; i < 50000; ++i) {
+        auto name = "libconda" + std::to_string(i) + ".so.1";
+        containerLibs.push_back(
+            Library{boost::filesystem::path{"/opt/conda/lib"} / name, {"1"}});
+    }
+    containerLibs.push_back(Library{"/opt/conda/lib/libfabric.so.1", {"1"}});
+    plan = libsarus::sharedlibs::planBindMounts(hostLibs, containerLibs,
+                                                "/usr/lib/host");
+    ASSERT_EQ(plan.replacements.size(), 1);
+    EXPECT_EQ(plan.replacements[0].destination,
+              "/opt/conda/lib/libfabric.so.1");
+    EXPECT_EQ(plan.injections.size(), 4);
+    EXPECT_TRUE(plan.incompatibleContainerLibs.empty());
+}
+
+TEST_F(UtilityTest, getSharedLibDependencyClosure) {
+    auto rootDirRAII =
+        libsarus::PathRAII{libsarus::filesystem::makeUniquePathWithRandomSuffix(
+            "/tmp/sarus-test-utility-getSharedLibDependencyClosure")};
+    const auto &rootDir = rootDirRAII.getPath();
+    auto dummyLibsDir =
+        boost::filesystem::path{__FILE__}.parent_path() / "dummy_libs";
+
+    // lib_dummy_0.so depends on libc.so.6
+    libsarus::filesystem::copyFile(dummyLibsDir / "lib_dummy_0.so",
+                                   rootDir / "opt/lib/lib_dummy_0.so");
+    libsarus::filesystem::copyFile(dummyLibsDir / "lib_dummy_1.so",
+                                   rootDir / "opt/lib/lib_dummy_1.so");
+
+    // libc in default directory, skipping the incompatible 32-bit one
+    libsarus::filesystem::copyFile(dummyLibsDir / "libc.so.6-32bit-container",
+                                   rootDir / "lib64/libc.so.6");
+    libsarus::filesystem::copyFile(dummyLibsDir / "libc.so.6-host",
+                                   rootDir / "usr/lib64/libc-2.31.so");
+    boost::filesystem::create_symlink("libc-2.31.so",
+                                      rootDir / "usr/lib64/libc.so.6");
+    auto dependencies = libsarus::sharedlibs::getDependencyClosure(
+        {"/opt/lib/lib_dummy_0.so", "/opt/lib/lib_dummy_1.so"}, rootDir);
+    EXPECT_EQ(dependencies,
+              std::vector<boost::filesystem::path>{"/usr/lib64/libc.so.6"});
+
+    // libc in ld.so.cache takes precedence over default directories
+    libsarus::filesystem::copyFile(dummyLibsDir / "libc.so.6-host",
+                                   rootDir / "custom/libc.so.6");
+    libsarus::filesystem::writeTextFile("/custom\n",
+                                        rootDir / "etc/ld.so.conf");
+    libsarus::process::executeCommand("ldconfig -r " + rootDir.string());
+    dependencies = libsarus::sharedlibs::getDependencyClosure(
+        {"/opt/lib/lib_dummy_0.so"}, rootDir, 2);
+    EXPECT_EQ(dependencies,
+              std::vector<boost::filesystem::path>{"/custom/libc.so.6"});
+
+    // library without dependencies
+    EXPECT_TRUE(libsarus::sharedlibs::getDependencyClosure(
+                    {"/opt/lib/lib_dummy_1.so"}, rootDir)
+                    .empty());
+
+    // missing dependency
+    boost::filesystem::remove(rootDir / "custom/libc.so.6");
+    boost::filesystem::remove(rootDir / "usr/lib64/libc-2.31.so");
+    EXPECT_THROW(libsarus::sharedlibs::getDependencyClosure(
+                     {"/opt/lib/lib_dummy_0.so"}, rootDir),
+                 libsarus::Error);
+}
+
+TEST_F(UtilityTest, getGlibcVersion) {
+    auto rootDirRAII =
+        libsarus::PathRAII{libsarus::filesystem::makeUniquePathWithRandomSuffix(
+            "/tmp/sarus-test-utility-getGlibcVersion")};
+    const auto &rootDir = rootDirRAII.getPath();
+    auto dummyLibsDir =
+        boost::filesystem::path{__FILE__}.parent_path() / "dummy_libs";
+
+    // host glibc, compared with the version of the running C library
+    auto expectedVersion = std::tuple<unsigned int, unsigned int>{};
+    EXPECT_EQ(sscanf(gnu_get_libc_version(), "%u.%u",
+                     &std::get<0>(expectedVersion),
+                     &std::get<1>(expectedVersion)),
+              2);
+    EXPECT_EQ(libsarus::sharedlibs::getGlibcVersion("/"), expectedVersion);
+    EXPECT_EQ(libsarus::sharedlibs::getLibcVersion(
+                  libsarus::sharedlibs::findLibc("/")),
+              expectedVersion);
+
+    // the version string takes precedence over the symbol versions, as a
+    // glibc release doesn't necessarily define a new one
+    auto libcContent =
+        libsarus::filesystem::readFile(libsarus::sharedlibs::findLibc("/"));
+    auto marker = std::string{"release version "};
+    auto markerPosition = libcContent.find(marker);
+    ASSERT_NE(markerPosition, std::string::npos);
+    libcContent[markerPosition + marker.size()] = '9';
+    libsarus::filesystem::writeTextFile(libcContent, rootDir / "libc.so.6");
+    EXPECT_EQ(libsarus::sharedlibs::getLibcVersion(rootDir / "libc.so.6"),
+              (std::tuple<unsigned int, unsigned int>{
+                  9, std::get<1>(expectedVersion)}));
+
+    // 64-bit libc is preferred
+    libsarus::filesystem::copyFile(dummyLibsDir / "libc.so.6-32bit-container",
+                                   rootDir / "lib/libc.so.6");
+    EXPECT_EQ(libsarus::sharedlibs::findLibc(rootDir), "/lib/libc.so.6");
+    libsarus::filesystem::copyFile(dummyLibsDir / "libc.so.6-container",
+                                   rootDir / "usr/lib64/libc.so.6");
+    EXPECT_EQ(libsarus::sharedlibs::findLibc(rootDir), "/usr/lib64/libc.so.6");
+
+    // dummy libc without version information
+    EXPECT_THROW(libsarus::sharedlibs::getGlibcVersion(rootDir),
+                 libsarus::Error);
+
+    // no libc
+    boost::filesystem::remove_all(rootDir / "lib");
+    boost::filesystem::remove_all(rootDir / "usr");
+    EXPECT_THROW(libsarus::sharedlibs::findLibc(rootDir), libsarus::Error);
+
+    // required versions
+    auto requiredVersion = libsarus::sharedlibs::getMaxRequiredGlibcVersion(
+        dummyLibsDir / "lib_dummy_0.so");
+    ASSERT_TRUE(requiredVersion);
+    EXPECT_EQ(*requiredVersion,
+              (std::tuple<unsigned int, unsigned int>{2, 2}));
+    EXPECT_FALSE(libsarus::sharedlibs::getMaxRequiredGlibcVersion(
+        dummyLibsDir / "lib_dummy_1.so"));
+}
+
 TEST_F(UtilityTest, getSharedLibSoname) {
     auto dummyLibsDir =
         boost::filesystem::path{__FILE__}.parent_path() / "dummy_libs";
@@ -688,6 +1444,164 @@ TEST_F(UtilityTest, is64bitSharedLib) {
         dummyLibsDir / "libc.so.6-32bit-container", "readelf"));
 }
 
+TEST_F(UtilityTest, readElfInfo) {
+    auto dummyLibsDir =
+        boost::filesystem::path{__FILE__}.parent_path() / "dummy_libs";
+
+    auto info = libsarus::elf::readInfo(dummyLibsDir / "libc.so.6-host");
+    EXPECT_EQ(info.elfClass, ELFCLASS64);
+    EXPECT_EQ(info.machine, EM_X86_64);
+    EXPECT_EQ(info.type, ET_DYN);
+    ASSERT_TRUE(info.soname);
+    EXPECT_EQ(*info.soname, std::string("libc.so.6"));
+    EXPECT_TRUE(info.needed.empty());
+
+    info = libsarus::elf::readInfo(dummyLibsDir / "libc.so.6-32bit-container");
+    EXPECT_EQ(info.elfClass, ELFCLASS32);
+    EXPECT_EQ(info.machine, EM_386);
+    ASSERT_TRUE(info.soname);
+    EXPECT_EQ(*info.soname, std::string("libc.so.6"));
+
+    info = libsarus::elf::readInfo(dummyLibsDir / "lib_dummy_0.so");
+    EXPECT_FALSE(info.soname);
+    EXPECT_EQ(info.needed, std::vector<std::string>{"libc.so.6"});
+    EXPECT_TRUE(info.rpath.empty());
+    EXPECT_TRUE(info.runpath.empty());
+    ASSERT_EQ(info.versionRequirements.size(), 1);
+    EXPECT_EQ(info.versionRequirements[0].file, "libc.so.6");
+    EXPECT_EQ(info.versionRequirements[0].versions,
+              std::vector<std::string>{"GLIBC_2.2.5"});
+
+    // not an ELF file
+    EXPECT_FALSE(libsarus::elf::isElf(boost::filesystem::path{__FILE__}));
+    EXPECT_TRUE(libsarus::elf::isElf(dummyLibsDir / "lib_dummy_0.so"));
+    EXPECT_THROW(libsarus::elf::readInfo(boost::filesystem::path{__FILE__}),
+                 libsarus::Error);
+}
+
+TEST_F(UtilityTest, readDynamicLinkerCache) {
+    auto rootDirRAII =
+        libsarus::PathRAII{libsarus::filesystem::makeUniquePathWithRandomSuffix(
+            "/tmp/sarus-test-utility-readDynamicLinkerCache")};
+    const auto &rootDir = rootDirRAII.getPath();
+    auto dummyLibsDir =
+        boost::filesystem::path{__FILE__}.parent_path() / "dummy_libs";
+
+    libsarus::filesystem::copyFile(dummyLibsDir / "libc.so.6-host",
+                                   rootDir / "lib64/libc.so.6");
+    libsarus::filesystem::copyFile(dummyLibsDir / "ld-linux-x86-64.so.2-host",
+                                   rootDir / "lib64/ld-linux-x86-64.so.2");
+    libsarus::filesystem::writeTextFile("/lib64\n",
+                                        rootDir / "etc/ld.so.conf");
+    libsarus::process::executeCommand("ldconfig -r " + rootDir.string());
+
+    auto entries = libsarus::ldcache::read(
+        libsarus::ldcache::getCachePath(rootDir));
+    ASSERT_EQ(entries.size(), 2);
+    std::sort(entries.begin(), entries.end(),
+              [](const libsarus::ldcache::Entry &lhs,
+                 const libsarus::ldcache::Entry &rhs) {
+                  return lhs.soname < rhs.soname;
+              });
+    EXPECT_EQ(entries[0].soname, "ld-linux-x86-64.so.2");
+    EXPECT_EQ(entries[0].path, "/lib64/ld-linux-x86-64.so.2");
+    EXPECT_EQ(entries[1].soname, "libc.so.6");
+    EXPECT_EQ(entries[1].path, "/lib64/libc.so.6");
+    for (const auto &entry : entries) {
+        EXPECT_EQ(entry.flags & libsarus::ldcache::flagTypeMask,
+                  libsarus::ldcache::flagElfLibc6);
+        EXPECT_EQ(entry.flags & libsarus::ldcache::flagArchMask,
+                  libsarus::ldcache::flagX8664Lib64);
+        EXPECT_FALSE(entry.hwcapsSubdirectory);
+    }
+
+    auto libraries =
+        libsarus::sharedlibs::getListFromDynamicLinker("ldconfig", rootDir);
+    std::sort(libraries.begin(), libraries.end());
+    EXPECT_EQ(libraries, (std::vector<boost::filesystem::path>{
+                             "/lib64/ld-linux-x86-64.so.2",
+                             "/lib64/libc.so.6"}));
+
+    // invalid cache file
+    libsarus::filesystem::writeTextFile("invalid", rootDir / "invalid.cache");
+    EXPECT_THROW(libsarus::ldcache::read(rootDir / "invalid.cache"),
+                 libsarus::Error);
+}
+
+TEST_F(UtilityTest, writeDynamicLinkerCache) {
+    auto rootDirRAII =
+        libsarus::PathRAII{libsarus::filesystem::makeUniquePathWithRandomSuffix(
+            "/tmp/sarus-test-utility-writeDynamicLinkerCache")};
+    const auto &rootDir = rootDirRAII.getPath();
+    auto dummyLibsDir =
+        boost::filesystem::path{__FILE__}.parent_path() / "dummy_libs";
+
+    libsarus::filesystem::copyFile(dummyLibsDir / "libc.so.6-host",
+                                   rootDir / "lib64/libc.so.6");
+    libsarus::filesystem::copyFile(dummyLibsDir / "ld-linux-x86-64.so.2-host",
+                                   rootDir / "lib64/ld-linux-x86-64.so.2");
+    libsarus::filesystem::copyFile(dummyLibsDir / "lib_dummy_0.so",
+                                   rootDir / "lib64/lib_dummy_0.so");
+    libsarus::filesystem::copyFile(dummyLibsDir / "libc.so.6-32bit-container",
+                                   rootDir / "lib/libc.so.6");
+    libsarus::filesystem::writeTextFile("invalid", rootDir / "lib64/libx.so");
+    libsarus::filesystem::writeTextFile("/lib64\n/lib\n",
+                                        rootDir / "etc/ld.so.conf");
+
+    // same entries as the cache generated by ldconfig
+    auto cacheFile = libsarus::ldcache::getCachePath(rootDir);
+    libsarus::process::executeCommand("ldconfig -X -r " + rootDir.string());
+    auto expectedEntries = libsarus::ldcache::read(cacheFile);
+    boost::filesystem::remove(cacheFile);
+
+    libsarus::ldcache::write(
+        cacheFile,
+        libsarus::ldcache::scanDirectories({"/lib64", "/lib"}, rootDir));
+    auto entries = libsarus::ldcache::read(cacheFile);
+    ASSERT_EQ(entries.size(), expectedEntries.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        EXPECT_EQ(entries[i].soname, expectedEntries[i].soname);
+        EXPECT_EQ(entries[i].path, expectedEntries[i].path);
+        EXPECT_EQ(entries[i].flags, expectedEntries[i].flags);
+    }
+
+    // the cache is valid for ldconfig too
+    auto output = libsarus::process::executeCommand("ldconfig -p -C " +
+                                                    cacheFile.string());
+    EXPECT_NE(output.find("4 libs found in cache"), std::string::npos);
+    EXPECT_NE(output.find("libc.so.6 (libc6,x86-64) => /lib64/libc.so.6"),
+              std::string::npos);
+
+    // incremental append
+    libsarus::filesystem::copyFile(dummyLibsDir / "lib_dummy_1.so",
+                                   rootDir / "opt/host/libdummy.so.1");
+    libsarus::ldcache::append(
+        cacheFile, {libsarus::ldcache::makeEntry("/opt/host/libdummy.so.1",
+                                                 rootDir),
+                    libsarus::ldcache::makeEntry("/lib64/libc.so.6",
+                                                 rootDir)});
+    entries = libsarus::ldcache::read(cacheFile);
+    ASSERT_EQ(entries.size(), 5);
+    EXPECT_EQ(entries[0].soname, "libdummy.so.1");
+    EXPECT_EQ(entries[0].path, "/opt/host/libdummy.so.1");
+    EXPECT_EQ(entries[0].flags, libsarus::ldcache::flagElfLibc6 |
+                                    libsarus::ldcache::flagX8664Lib64);
+
+    // glibc-hwcaps entries
+    auto entry = libsarus::ldcache::Entry{};
+    entry.soname = "libhwcaps.so.1";
+    entry.path = "/lib64/glibc-hwcaps/x86-64-v3/libhwcaps.so.1";
+    entry.flags =
+        libsarus::ldcache::flagElfLibc6 | libsarus::ldcache::flagX8664Lib64;
+    entry.hwcapsSubdirectory = "x86-64-v3";
+    libsarus::ldcache::append(cacheFile, {entry});
+    entries = libsarus::ldcache::read(cacheFile);
+    ASSERT_EQ(entries.size(), 6);
+    ASSERT_TRUE(entries[0].hwcapsSubdirectory);
+    EXPECT_EQ(*entries[0].hwcapsSubdirectory, "x86-64-v3");
+    EXPECT_EQ(entries[0].path, entry.path);
+}
+
 TEST_F(UtilityTest, serializeJSON) {
     namespace rj = rapidjson;
     auto json = rj::Document{rj::kObjectType};
@@ -707,6 +1621,52 @@ TEST_F(UtilityTest, serializeJSON) {
     EXPECT_EQ(libsarus::string::removeWhitespaces(actual), expected);
 }
 
+TEST_F(UtilityTest, parallelForEachIndex) {
+    auto results = std::vector<size_t>(1000);
+    libsarus::parallel::forEachIndex(
+        results.size(), [&](size_t i) { results[i] = i * i; }, 4);
+    for (size_t i = 0; i < results.size(); ++i) {
+        EXPECT_EQ(results[i], i * i);
+    }
+
+    // the error of the task with the lowest index is propagated
+    auto executedTasks = std::atomic<size_t>{0};
+    try {
+        libsarus::parallel::forEachIndex(
+            100,
+            [&](size_t i) {
+                ++executedTasks;
+                if (i % 10 == 3) {
+                    SARUS_THROW_ERROR("task " + std::to_string(i));
+                }
+            },
+            4);
+        FAIL() << "Expected exception to be thrown";
+    } catch (const libsarus::Error &e) {
+        EXPECT_EQ(std::string{e.what()}, "task 3");
+    }
+    EXPECT_EQ(executedTasks, 100);
+
+    // the tasks of each worker run sequentially
+    auto numberOfWorkers = libsarus::parallel::getNumberOfWorkers(1000, 4);
+    EXPECT_EQ(numberOfWorkers, 4);
+    EXPECT_EQ(libsarus::parallel::getNumberOfWorkers(2, 4), 2);
+    auto tasksPerWorker = std::vector<size_t>(numberOfWorkers);
+    libsarus::parallel::forEachIndexInWorkers(
+        1000,
+        [&](size_t i, unsigned int worker) {
+            results[i] = i;
+            ++tasksPerWorker.at(worker);
+        },
+        4);
+    for (size_t i = 0; i < results.size(); ++i) {
+        EXPECT_EQ(results[i], i);
+    }
+    EXPECT_EQ(std::accumulate(tasksPerWorker.cbegin(), tasksPerWorker.cend(),
+                              size_t{0}),
+              1000);
+}
+
 TEST_F(UtilityTest, setCpuAffinity_invalid_argument) {
     EXPECT_THROW(libsarus::process::setCpuAffinity({}),
                  libsarus::Error);  // no CPUs